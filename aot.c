@@ -0,0 +1,699 @@
+/**
+ * @file aot.c
+ * @brief Implementation of the Pith ahead-of-time compiler.
+ *
+ * The C functions follow the JIT's rules for which functions they cover and how they compute:
+ * each variable of the function is a C `int` named after its slot (`s0`, `s1`...), bools are
+ * 0 or 1, and a call of the function to itself in tail position jumps back to its start.
+ * Callees are bound when the program is translated, so a call may only go to the function
+ * itself or to a translated top-level function defined before it, which is always defined by
+ * the time the caller runs.
+ */
+
+#include "aot.h"
+#include "interpreter.h"
+#include "constants.h"
+#include "resolver.h"
+#include "checker.h"
+#include "common.h"
+#include "gc.h"
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#define NAME(constant) [constant] = #constant
+
+static const char *const node_type_names[] = {
+    NAME(AST_PROGRAM), NAME(AST_INT_LITERAL), NAME(AST_FLOAT_LITERAL), NAME(AST_STRING_LITERAL),
+    NAME(AST_BOOL_LITERAL), NAME(AST_VAR_DECL), NAME(AST_ASSIGNMENT), NAME(AST_VAR_REF),
+    NAME(AST_BINARY_OP), NAME(AST_UNARY_OP), NAME(AST_LOGICAL_OP), NAME(AST_IF), NAME(AST_WHILE),
+    NAME(AST_BLOCK), NAME(AST_FUNC_DEF), NAME(AST_FUNC_CALL), NAME(AST_RETURN), NAME(AST_PRINT),
+    NAME(AST_FOR), NAME(AST_FOREACH), NAME(AST_DO_WHILE), NAME(AST_SWITCH), NAME(AST_CASE),
+    NAME(AST_DEFAULT), NAME(AST_BREAK), NAME(AST_CONTINUE), NAME(AST_IMPORT), NAME(AST_CLASS_DEF),
+    NAME(AST_NEW_EXPR), NAME(AST_FIELD_ACCESS), NAME(AST_FIELD_DECL), NAME(AST_LIST_LITERAL),
+    NAME(AST_INDEX_ACCESS), NAME(AST_ARRAY_SPECIFIER), NAME(AST_HASHMAP_LITERAL)
+};
+
+static const char *const operator_names[] = {
+    NAME(OPER_ADD), NAME(OPER_SUBTRACT), NAME(OPER_MULTIPLY), NAME(OPER_DIVIDE), NAME(OPER_MODULO),
+    NAME(OPER_POWER), NAME(OPER_LESS), NAME(OPER_GREATER), NAME(OPER_LESS_EQUAL),
+    NAME(OPER_GREATER_EQUAL), NAME(OPER_EQUAL), NAME(OPER_NOT_EQUAL), NAME(OPER_AND), NAME(OPER_OR),
+    NAME(OPER_NEGATE), NAME(OPER_NOT), NAME(OPER_NONE)
+};
+
+#undef NAME
+
+// --- Text ---
+
+/**
+ * @brief C code being generated for one function, dropped if the function cannot be translated.
+ */
+typedef struct
+{
+    char *chars;
+    int length;
+    int capacity;
+} Text;
+
+static void append(Text *text, const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    int needed = vsnprintf(NULL, 0, format, args);
+    va_end(args);
+
+    if (text->length + needed + 1 > text->capacity)
+    {
+        while (text->length + needed + 1 > text->capacity)
+            text->capacity = text->capacity < 256 ? 256 : text->capacity * 2;
+        text->chars = realloc(text->chars, text->capacity);
+        if (!text->chars)
+        {
+            fprintf(stderr, "Fatal: Memory allocation failed for generated C code.\n");
+            exit(1);
+        }
+    }
+    va_start(args, format);
+    vsnprintf(text->chars + text->length, needed + 1, format, args);
+    va_end(args);
+    text->length += needed;
+}
+
+static void append_indent(Text *text, int indent)
+{
+    append(text, "%*s", indent * 4, "");
+}
+
+/**
+ * @brief Writes a string as a C string literal, or NULL.
+ */
+static void write_c_string(FILE *out, const char *string)
+{
+    if (!string)
+    {
+        fputs("NULL", out);
+        return;
+    }
+    fputc('"', out);
+    for (const unsigned char *c = (const unsigned char *) string; *c; c++)
+    {
+        if (*c == '"' || *c == '\\')
+            fprintf(out, "\\%c", *c);
+        else if (*c == '?')
+            fputs("\\?", out); // No trigraphs
+        else if (*c < 32 || *c >= 127)
+            fprintf(out, "\\%03o", *c);
+        else
+            fputc(*c, out);
+    }
+    fputc('"', out);
+}
+
+// --- Translating Functions ---
+
+/**
+ * @brief A top-level function definition of the program.
+ */
+typedef struct
+{
+    ASTNode *def;
+    int node; // Index in the tree table
+    int translated; // Whether it was written out as `pith_fn_<number>`
+    int return_type;
+} FunctionEntry;
+
+typedef struct
+{
+    FunctionEntry *functions; // Top-level definitions in program order
+    int function_count;
+    FunctionEntry *current; // The function being translated
+    Text body;
+    int loop_depth;
+    int return_type; // Type of the values returned so far, or TYPE_UNPROVEN before the first return
+    int jumps_to_entry; // Whether a tail call to itself restarts the function
+} Translator;
+
+static int is_machine_type(int type)
+{
+    return type == VAL_INT || type == VAL_BOOL;
+}
+
+static const char *comparison_operator(Operator op)
+{
+    switch (op)
+    {
+        case OPER_LESS:
+            return "<";
+        case OPER_GREATER:
+            return ">";
+        case OPER_LESS_EQUAL:
+            return "<=";
+        case OPER_GREATER_EQUAL:
+            return ">=";
+        case OPER_EQUAL:
+            return "==";
+        case OPER_NOT_EQUAL:
+            return "!=";
+        default:
+            return NULL;
+    }
+}
+
+static int function_number(Translator *t, FunctionEntry *function)
+{
+    return (int) (function - t->functions);
+}
+
+/**
+ * @brief Finds the translated function a call binds to: the function itself, or an earlier one.
+ */
+static FunctionEntry *bind_callee(Translator *t, ASTNode *call)
+{
+    ASTNode *callee = call->children[0];
+    if (!callee || callee->type != AST_VAR_REF || callee->depth != SCOPE_GLOBAL)
+        return NULL;
+    for (FunctionEntry *function = t->functions; function <= t->current; function++)
+    {
+        ASTNode *def = function->def;
+        if (def->depth != SCOPE_GLOBAL || def->slot != callee->slot)
+            continue;
+        if (def->arg_count != call->children_count - 1 || (function != t->current && !function->translated))
+            return NULL;
+        return function;
+    }
+    return NULL;
+}
+
+static int translate_expression(Translator *t, ASTNode *node);
+
+static int translate_arguments(Translator *t, ASTNode *call)
+{
+    for (int i = 1; i < call->children_count; i++)
+    {
+        if (i > 1)
+            append(&t->body, ", ");
+        if (!translate_expression(t, call->children[i]))
+            return 0;
+    }
+    for (int i = call->children_count - 1; i < JIT_MAX_PARAMS; i++)
+        append(&t->body, i > 0 ? ", 0" : "0");
+    return 1;
+}
+
+static int translate_expression(Translator *t, ASTNode *node)
+{
+    if (!node || !is_machine_type(node->static_type))
+        return 0;
+
+    switch (node->type)
+    {
+        case AST_INT_LITERAL:
+        case AST_BOOL_LITERAL:
+        {
+            int value = LITERAL_VALUE(node).int_val;
+            if (value == INT_MIN)
+                append(&t->body, "(-%d - 1)", INT_MAX);
+            else
+                append(&t->body, value < 0 ? "(%d)" : "%d", value);
+            return 1;
+        }
+        case AST_VAR_REF:
+            if (node->depth != 0 || node->slot >= t->current->def->slot_count)
+                return 0;
+            append(&t->body, "s%d", node->slot);
+            return 1;
+        case AST_BINARY_OP:
+        {
+            if (node->children_count != 2 || node->children[0]->static_type != VAL_INT ||
+                node->children[1]->static_type != VAL_INT)
+                return 0;
+            const char *comparison = comparison_operator(node->op);
+            if (comparison)
+                append(&t->body, "(");
+            else if (node->op == OPER_ADD)
+                append(&t->body, "PITH_ADD(");
+            else if (node->op == OPER_SUBTRACT)
+                append(&t->body, "PITH_SUBTRACT(");
+            else if (node->op == OPER_MULTIPLY)
+                append(&t->body, "PITH_MULTIPLY(");
+            else
+                return 0; // `/`, `%` and `^` can fail or leave ints
+            if (!translate_expression(t, node->children[0]))
+                return 0;
+            append(&t->body, comparison ? " %s " : ", ", comparison);
+            if (!translate_expression(t, node->children[1]))
+                return 0;
+            append(&t->body, ")");
+            return 1;
+        }
+        case AST_LOGICAL_OP:
+            if (node->children_count != 2 || node->children[0]->static_type != VAL_BOOL ||
+                node->children[1]->static_type != VAL_BOOL)
+                return 0;
+            append(&t->body, "(");
+            if (!translate_expression(t, node->children[0]))
+                return 0;
+            append(&t->body, node->op == OPER_AND ? " && " : " || ");
+            if (!translate_expression(t, node->children[1]))
+                return 0;
+            append(&t->body, ")");
+            return 1;
+        case AST_UNARY_OP:
+        {
+            if (node->children_count != 1)
+                return 0;
+            int expected = node->op == OPER_NEGATE ? VAL_INT : VAL_BOOL;
+            if (node->children[0]->static_type != expected)
+                return 0;
+            append(&t->body, node->op == OPER_NEGATE ? "PITH_NEGATE(" : "(!");
+            if (!translate_expression(t, node->children[0]))
+                return 0;
+            append(&t->body, ")");
+            return 1;
+        }
+        case AST_FUNC_CALL:
+        {
+            FunctionEntry *callee = node->children_count > 0 ? bind_callee(t, node) : NULL;
+            if (!callee)
+                return 0;
+            append(&t->body, "pith_fn_%d(", function_number(t, callee));
+            if (!translate_arguments(t, node))
+                return 0;
+            append(&t->body, ")");
+            return 1;
+        }
+        default:
+            return 0;
+    }
+}
+
+/**
+ * @brief Translates a statement that can also be a `for` increment (without its `;`).
+ */
+static int translate_simple_statement(Translator *t, ASTNode *node)
+{
+    ASTNode *target = node;
+    ASTNode *value = NULL;
+    if (node->type == AST_VAR_DECL)
+    {
+        if (node->children_count != 1 || node->children[0]->type == AST_ARRAY_SPECIFIER ||
+            strncmp(node->type_name, "map<", 4) == 0)
+            return 0;
+        value = node->children[0];
+    }
+    else if (node->type == AST_ASSIGNMENT)
+    {
+        if (node->children_count != 2 || node->children[0]->type != AST_VAR_REF)
+            return 0;
+        target = node->children[0];
+        value = node->children[1];
+    }
+    else
+    {
+        // An expression statement: its value is dropped.
+        append(&t->body, "(void) ");
+        return translate_expression(t, node);
+    }
+
+    if (target->depth != 0 || target->slot >= t->current->def->slot_count)
+        return 0;
+    append(&t->body, "s%d = ", target->slot);
+    return translate_expression(t, value);
+}
+
+static int translate_statement(Translator *t, ASTNode *node, int indent);
+
+static int translate_loop_body(Translator *t, ASTNode *body, int indent)
+{
+    t->loop_depth++;
+    int ok = translate_statement(t, body, indent);
+    t->loop_depth--;
+    return ok;
+}
+
+static int translate_return(Translator *t, ASTNode *node, int indent)
+{
+    ASTNode *value = node->children_count > 0 ? node->children[0] : NULL;
+    if (!value || !is_machine_type(value->static_type))
+        return 0;
+    if (t->return_type == TYPE_UNPROVEN)
+        t->return_type = value->static_type;
+    else if (t->return_type != value->static_type)
+        return 0;
+
+    if (node->tail_call && value->type == AST_FUNC_CALL && value->children_count > 0 &&
+        bind_callee(t, value) == t->current)
+    {
+        // Evaluate every argument before any parameter changes.
+        append_indent(&t->body, indent);
+        append(&t->body, "{\n");
+        for (int i = 1; i < value->children_count; i++)
+        {
+            append_indent(&t->body, indent + 1);
+            append(&t->body, "int a%d = ", i - 1);
+            if (!translate_expression(t, value->children[i]))
+                return 0;
+            append(&t->body, ";\n");
+        }
+        for (int i = 1; i < value->children_count; i++)
+        {
+            append_indent(&t->body, indent + 1);
+            append(&t->body, "s%d = a%d;\n", i - 1, i - 1);
+        }
+        append_indent(&t->body, indent + 1);
+        append(&t->body, "goto entry;\n");
+        append_indent(&t->body, indent);
+        append(&t->body, "}\n");
+        t->jumps_to_entry = 1;
+        return 1;
+    }
+
+    append_indent(&t->body, indent);
+    append(&t->body, "return ");
+    if (!translate_expression(t, value))
+        return 0;
+    append(&t->body, ";\n");
+    return 1;
+}
+
+/**
+ * @brief Translates a statement of a function body, on lines of its own.
+ */
+static int translate_statement(Translator *t, ASTNode *node, int indent)
+{
+    if (!node)
+        return 1;
+
+    switch (node->type)
+    {
+        case AST_BLOCK:
+            append_indent(&t->body, indent);
+            append(&t->body, "{\n");
+            for (int i = 0; i < node->children_count; i++)
+            {
+                if (!translate_statement(t, node->children[i], indent + 1))
+                    return 0;
+            }
+            append_indent(&t->body, indent);
+            append(&t->body, "}\n");
+            return 1;
+        case AST_IF:
+            append_indent(&t->body, indent);
+            append(&t->body, "if (");
+            if (!translate_expression(t, node->children[0]))
+                return 0;
+            append(&t->body, ")\n");
+            if (!translate_statement(t, node->children[1], indent))
+                return 0;
+            if (node->children_count > 2)
+            {
+                append_indent(&t->body, indent);
+                append(&t->body, "else\n");
+                if (!translate_statement(t, node->children[2], indent))
+                    return 0;
+            }
+            return 1;
+        case AST_WHILE:
+            append_indent(&t->body, indent);
+            append(&t->body, "while (");
+            if (!translate_expression(t, node->children[0]))
+                return 0;
+            append(&t->body, ")\n");
+            return translate_loop_body(t, node->children[1], indent);
+        case AST_DO_WHILE:
+            append_indent(&t->body, indent);
+            append(&t->body, "do\n");
+            if (!translate_loop_body(t, node->children[0], indent))
+                return 0;
+            append_indent(&t->body, indent);
+            append(&t->body, "while (");
+            if (!translate_expression(t, node->children[1]))
+                return 0;
+            append(&t->body, ");\n");
+            return 1;
+        case AST_FOR:
+            // `continue` runs the increment in both languages.
+            if (!translate_statement(t, node->children[0], indent))
+                return 0;
+            append_indent(&t->body, indent);
+            append(&t->body, "for (; ");
+            if (!translate_expression(t, node->children[1]))
+                return 0;
+            append(&t->body, "; ");
+            if (node->children[2] && !translate_simple_statement(t, node->children[2]))
+                return 0;
+            append(&t->body, ")\n");
+            return translate_loop_body(t, node->children[3], indent);
+        case AST_BREAK:
+        case AST_CONTINUE:
+            // Outside of a loop, the signal would end the function without a value.
+            if (t->loop_depth == 0)
+                return 0;
+            append_indent(&t->body, indent);
+            append(&t->body, node->type == AST_BREAK ? "break;\n" : "continue;\n");
+            return 1;
+        case AST_RETURN:
+            return translate_return(t, node, indent);
+        default:
+            append_indent(&t->body, indent);
+            if (!translate_simple_statement(t, node))
+                return 0;
+            append(&t->body, ";\n");
+            return 1;
+    }
+}
+
+/**
+ * @brief Translates a function, or leaves it to the tree-walker.
+ * @return Whether the function was translated (and written to `out`).
+ */
+static int translate_function(Translator *t, FunctionEntry *function, FILE *out)
+{
+    ASTNode *def = function->def;
+    if (def->frame_captured || def->arg_count > JIT_MAX_PARAMS || def->children_count == 0 ||
+        !always_returns(def->children[0]))
+        return 0;
+
+    t->current = function;
+    t->body.length = 0;
+    t->loop_depth = 0;
+    t->return_type = TYPE_UNPROVEN;
+    t->jumps_to_entry = 0;
+    ASTNode *body = def->children[0];
+    for (int i = 0; i < body->children_count; i++)
+    {
+        if (!translate_statement(t, body->children[i], 1))
+            return 0;
+    }
+
+    fprintf(out, "/* %s, line %d */\nstatic int pith_fn_%d(", def->value, def->line_num, function_number(t, function));
+    for (int i = 0; i < JIT_MAX_PARAMS; i++)
+        fprintf(out, i < def->arg_count ? "%sint s%d" : "%sint unused%d", i > 0 ? ", " : "", i);
+    fprintf(out, ")\n{\n");
+    for (int slot = def->arg_count; slot < def->slot_count; slot++)
+        fprintf(out, "    int s%d = 0;\n", slot);
+    if (t->jumps_to_entry)
+        fprintf(out, "entry:\n");
+    fwrite(t->body.chars, 1, t->body.length, out);
+    fprintf(out, "}\n\n");
+
+    function->translated = 1;
+    function->return_type = t->return_type;
+    return 1;
+}
+
+// --- Writing the Program ---
+
+static int count_nodes(ASTNode *node)
+{
+    int count = 1;
+    for (int i = 0; i < node->children_count; i++)
+        count += count_nodes(node->children[i]);
+    return count;
+}
+
+/**
+ * @brief Writes the tree table entries of a node and its descendants.
+ * @return The index of the next entry.
+ */
+static int write_node(FILE *out, ASTNode *node, int index, ASTNode *root, FunctionEntry *functions)
+{
+    fprintf(out, "    {%s, %d, %s, ", node_type_names[node->type], node->line_num, operator_names[node->op]);
+    write_c_string(out, node->value);
+    fputs(", ", out);
+    write_c_string(out, node->type_name);
+    fputs(", ", out);
+    write_c_string(out, node->parent_class_name);
+    fprintf(out, ", %d, %d},\n", node->children_count, node->type == AST_FUNC_DEF ? node->arg_count : 0);
+
+    int next = index + 1;
+    for (int i = 0; i < node->children_count; i++)
+    {
+        if (node == root && node->children[i]->type == AST_FUNC_DEF)
+        {
+            functions->def = node->children[i];
+            functions->node = next;
+            functions++;
+        }
+        next = write_node(out, node->children[i], next, root, functions);
+    }
+    return next;
+}
+
+static int write_args(FILE *out, ASTNode *node)
+{
+    int count = 0;
+    if (node->type == AST_FUNC_DEF)
+    {
+        for (int i = 0; i < node->arg_count; i++)
+        {
+            fputs("    ", out);
+            write_c_string(out, node->arg_types ? node->arg_types[i] : NULL);
+            fputs(", ", out);
+            write_c_string(out, node->args[i]);
+            fputs(",\n", out);
+            count++;
+        }
+    }
+    for (int i = 0; i < node->children_count; i++)
+        count += write_args(out, node->children[i]);
+    return count;
+}
+
+void emit_c_program(ASTNode *root, const char *source, const char *filename, FILE *out)
+{
+    Translator t;
+    memset(&t, 0, sizeof(Translator));
+    for (int i = 0; i < root->children_count; i++)
+    {
+        if (root->children[i]->type == AST_FUNC_DEF)
+            t.function_count++;
+    }
+    t.functions = calloc(t.function_count > 0 ? t.function_count : 1, sizeof(FunctionEntry));
+    if (!t.functions)
+    {
+        fprintf(stderr, "Fatal: Memory allocation failed for translated functions.\n");
+        exit(1);
+    }
+
+    fputs("/* Generated by pith --emit-c from ", out);
+    write_c_string(out, filename);
+    fputs(". Link with the pith_runtime library. */\n\n#include \"aot.h\"\n\n", out);
+
+    fprintf(out, "static const CompiledNode pith_nodes[%d] = {\n", count_nodes(root));
+    write_node(out, root, 0, root, t.functions);
+    fputs("};\n\nstatic const char *const pith_args[] = {\n", out);
+    if (write_args(out, root) == 0)
+        fputs("    NULL\n", out);
+    fputs("};\n\n", out);
+
+    int translated = 0;
+    for (int i = 0; i < t.function_count; i++)
+        translated += translate_function(&t, &t.functions[i], out);
+
+    fprintf(out, "static const CompiledFunction pith_functions[] = {\n");
+    for (int i = 0; i < t.function_count; i++)
+    {
+        if (t.functions[i].translated)
+            fprintf(out, "    {%d, pith_fn_%d, %s},\n", t.functions[i].node, i,
+                    t.functions[i].return_type == VAL_BOOL ? "VAL_BOOL" : "VAL_INT");
+    }
+    if (translated == 0)
+        fputs("    {0, NULL, VAL_VOID}\n", out);
+    fputs("};\n\n", out);
+
+    // The source is kept as bytes: string literals have length limits on some compilers.
+    fputs("static const char pith_source[] = {", out);
+    int length = (int) strlen(source);
+    for (int i = 0; i <= length; i++)
+        fprintf(out, "%s%d,", i % 20 == 0 ? "\n    " : " ", (unsigned char) source[i]);
+    fputs("\n};\n\n", out);
+
+    fputs("int main(void)\n{\n", out);
+    fprintf(out, "    return run_compiled_program(pith_nodes, %d, pith_args, pith_functions, %d, pith_source, ",
+            count_nodes(root), translated);
+    write_c_string(out, filename);
+    fputs(");\n}\n", out);
+
+    free(t.functions);
+    free(t.body.chars);
+}
+
+// --- Running a Compiled Program ---
+
+/**
+ * @brief Rebuilds a node of the tree table and its descendants, as the parser built them.
+ */
+static ASTNode *rebuild_node(const CompiledNode *nodes, int *next, const char *const *args, int *next_arg,
+                             ASTNode **built)
+{
+    const CompiledNode *entry = &nodes[*next];
+    ASTNode *node = create_node(entry->type, entry->value, entry->line_num);
+    built[(*next)++] = node;
+    node->op = entry->op;
+    if (entry->type_name)
+        node->type_name = strdup(entry->type_name);
+    if (entry->parent_class_name)
+        node->parent_class_name = strdup(entry->parent_class_name);
+
+    switch (entry->type)
+    {
+        case AST_INT_LITERAL:
+        case AST_FLOAT_LITERAL:
+        case AST_STRING_LITERAL:
+        case AST_BOOL_LITERAL:
+            node->constant = make_literal_constant(entry->type, entry->value);
+            break;
+        case AST_FIELD_ACCESS:
+            node->constant = make_literal_constant(AST_STRING_LITERAL, entry->value); // See MEMBER_NAME
+            node->cache = calloc(1, sizeof(FieldCache));
+            if (!node->cache)
+            {
+                fprintf(stderr, "Fatal: Memory allocation failed for field cache.\n");
+                exit(1);
+            }
+            break;
+        default:
+            break;
+    }
+
+    for (int i = 0; i < entry->arg_count; i++)
+    {
+        add_arg(node, args[*next_arg], args[*next_arg + 1]);
+        *next_arg += 2;
+    }
+    for (int i = 0; i < entry->children_count; i++)
+        add_child(node, rebuild_node(nodes, next, args, next_arg, built));
+    return node;
+}
+
+int run_compiled_program(const CompiledNode *nodes, int node_count, const char *const *args,
+                         const CompiledFunction *functions, int function_count, const char *source,
+                         const char *filename)
+{
+    ASTNode **built = malloc(node_count * sizeof(ASTNode *));
+    if (!built)
+    {
+        fprintf(stderr, "Fatal: Memory allocation failed for program tree.\n");
+        exit(1);
+    }
+    int next = 0;
+    int next_arg = 0;
+    ASTNode *root = rebuild_node(nodes, &next, args, &next_arg, built);
+
+    set_error_context(source, filename);
+    resolve_program(root);
+    check_program(root, 1, 0);
+
+    for (int i = 0; i < function_count; i++)
+        jit_install(built[functions[i].node], functions[i].entry, functions[i].return_type);
+    jit_enabled = 1;
+    free(built);
+
+    interpret(root);
+
+    free_ast(root);
+    free_all_objects();
+    return 0;
+}
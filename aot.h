@@ -0,0 +1,86 @@
+/**
+ * @file aot.h
+ * @brief Header file for the Pith ahead-of-time compiler (`pith --emit-c`).
+ *
+ * `emit_c_program` translates a checked program into a C translation unit that is compiled with
+ * the system C compiler and linked against the `pith_runtime` library. The unit holds:
+ *
+ * - the program's tree as a table of nodes, which `run_compiled_program` rebuilds at startup
+ *   instead of tokenizing and parsing the source;
+ * - a C function for every top-level function the checker proves to compute on ints and bools
+ *   alone (the functions the JIT compiles, see jit.h), calling earlier such functions directly.
+ *
+ * Those functions run as native code from their first call. The rest of the program runs on the
+ * tree-walker, exactly as `pith` would run it.
+ */
+
+#ifndef PITH_AOT_H
+#define PITH_AOT_H
+
+#include <stdio.h>
+#include "value.h"
+#include "parser.h"
+#include "jit.h"
+
+/**
+ * @brief A node of the tree table, in preorder: each node is followed by its children.
+ */
+typedef struct
+{
+    ASTNodeType type;
+    int line_num;
+    Operator op;
+    const char *value;
+    const char *type_name;
+    const char *parent_class_name;
+    int children_count;
+    int arg_count; // Function definitions: (type, name) pairs taken in order from the argument table
+} CompiledNode;
+
+/**
+ * @brief A function translated to C.
+ */
+typedef struct
+{
+    int node; // Index of the function definition in the tree table
+    JitEntry entry; // The translated function
+    ValueType return_type; // VAL_INT or VAL_BOOL
+} CompiledFunction;
+
+// Int arithmetic of translated functions. It wraps around like the engines' instead of being
+// undefined behaviour the C compiler may optimise on.
+#define PITH_ADD(a, b) ((int) ((unsigned) (a) + (unsigned) (b)))
+#define PITH_SUBTRACT(a, b) ((int) ((unsigned) (a) - (unsigned) (b)))
+#define PITH_MULTIPLY(a, b) ((int) ((unsigned) (a) * (unsigned) (b)))
+#define PITH_NEGATE(a) ((int) (0u - (unsigned) (a)))
+
+/**
+ * @brief Writes a program as a C translation unit.
+ *
+ * @param root The AST_PROGRAM node, already resolved and checked with `owns_globals` set.
+ * @param source The program's source, kept for error messages.
+ * @param filename The script's file name, kept for error messages.
+ * @param out Where to write the C code.
+ */
+void emit_c_program(ASTNode *root, const char *source, const char *filename, FILE *out);
+
+/**
+ * @brief Runs a program compiled by `pith --emit-c` (called by the generated `main`).
+ *
+ * The translated functions are installed as the native code of their definitions, so the JIT
+ * is enabled, and where it is supported it also compiles any other function that gets hot.
+ *
+ * @param nodes The tree table.
+ * @param node_count Number of entries in the tree table.
+ * @param args The argument table: a declared type (or NULL) and a name per argument.
+ * @param functions The functions translated to C.
+ * @param function_count Number of translated functions.
+ * @param source The program's source.
+ * @param filename The script's file name.
+ * @return The process exit code.
+ */
+int run_compiled_program(const CompiledNode *nodes, int node_count, const char *const *args,
+                         const CompiledFunction *functions, int function_count, const char *source,
+                         const char *filename);
+
+#endif //PITH_AOT_H
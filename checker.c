@@ -0,0 +1,863 @@
+/**
+ * @file checker.c
+ * @brief Implementation of the Pith static type checker.
+ *
+ * The checker infers types optimistically. Every variable, parameter and function result starts
+ * out assumed to have its declared type. Each pass over the program computes the type of every
+ * expression under the current assumptions, and an assumption is dropped as soon as a value of
+ * another type is written to the variable (or returned by the function). Assumptions are only
+ * ever dropped, so the passes stop changing anything after a few rounds; whatever is still
+ * assumed then holds on every run, by induction over the writes the program makes.
+ *
+ * Parameters are only proven for functions whose every call is visible: a function bound to a
+ * variable that is only ever called directly (never read as a value, reassigned or redeclared).
+ * A final pass reports the type errors under the proven types.
+ */
+
+#include "checker.h"
+#include "interpreter.h"
+#include "common.h"
+#include "debug.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct FunctionInfo FunctionInfo;
+
+/**
+ * @brief What the checker knows about one variable: a frame slot or a global.
+ */
+typedef struct
+{
+    int declared; // Type named by its declarations, checked against every write, or TYPE_UNPROVEN
+    int type; // Type of every value it ever holds, or TYPE_UNPROVEN
+    int is_declared; // A declaration has been seen (globals can be declared more than once)
+    FunctionInfo *function; // The function it always holds, or NULL
+} Variable;
+
+/**
+ * @brief What the checker knows about one function definition.
+ */
+struct FunctionInfo
+{
+    ASTNode *def;
+    int declared_return; // Declared return type, or TYPE_UNPROVEN
+    int returns; // Type of the value every call returns, or TYPE_UNPROVEN
+    int callers_known; // Every call is a direct call seen by the checker, which binds the parameters
+    int first_param; // Slot of the first parameter: 1 for methods, whose slot 0 holds `this`
+    Variable *slots; // The function's frame
+};
+
+/**
+ * @brief The variables of one frame being checked.
+ */
+typedef struct
+{
+    Variable *slots;
+    int count;
+    FunctionInfo *function; // NULL for the program's own frame
+    int loops; // Loops open in this frame (targets of `continue`)
+    int breakables; // Loops and switches open in this frame (targets of `break`)
+} CheckerFrame;
+
+typedef struct
+{
+    int declaring; // Pass 0: records declarations and creates the function infos
+    int report; // Final pass: reports type errors
+    int changed; // An assumption was dropped during this pass
+    int error_count;
+    int prove_globals;
+
+    FunctionInfo **functions; // One per function definition, in the order the passes meet them
+    int function_count;
+    int function_capacity;
+    int next_function;
+
+    Variable **iterations; // Frame of each loop that runs its iterations in frames of their own
+    int iteration_count;
+    int iteration_capacity;
+    int next_iteration;
+
+    CheckerFrame *frames;
+    int frame_count;
+    int frame_capacity;
+
+    Variable *globals;
+    int global_capacity;
+    Variable unknown; // Stands in for variables the checker cannot place
+} Checker;
+
+static int check_node(Checker *checker, ASTNode *node);
+
+// --- Errors ---
+
+static void type_error(Checker *checker, int line, const char *format, ...)
+{
+    if (!checker->report)
+        return;
+    checker->error_count++;
+    fprintf(stderr, "[line %d] Type error: ", line);
+    va_list args;
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+    fprintf(stderr, "\n");
+    print_error_context(line);
+}
+
+static const char *type_name_of(int type)
+{
+    return get_value_type_name((ValueType) type);
+}
+
+// --- Types ---
+
+/**
+ * @brief Maps a declared type name to the type of the values it holds.
+ * @return The type, or TYPE_UNPROVEN for names the checker does not track (classes, `func`...).
+ */
+static int type_from_name(const char *name)
+{
+    if (!name)
+        return TYPE_UNPROVEN;
+    if (strcmp(name, "int") == 0)
+        return VAL_INT;
+    if (strcmp(name, "float") == 0)
+        return VAL_FLOAT;
+    if (strcmp(name, "string") == 0)
+        return VAL_STRING;
+    if (strcmp(name, "bool") == 0)
+        return VAL_BOOL;
+    if (strcmp(name, "void") == 0)
+        return VAL_VOID;
+    if (strncmp(name, "list", 4) == 0)
+        return VAL_LIST;
+    if (strncmp(name, "map", 3) == 0)
+        return VAL_HASHMAP;
+    return TYPE_UNPROVEN;
+}
+
+/**
+ * @brief Returns whether a value of type `actual` may be stored where `declared` is expected.
+ *
+ * Unproven types are not checked, and an int may stand for a float.
+ */
+static int is_compatible(int declared, int actual)
+{
+    return declared == TYPE_UNPROVEN || actual == TYPE_UNPROVEN || declared == actual ||
+           (declared == VAL_FLOAT && actual == VAL_INT);
+}
+
+static int is_number(int type)
+{
+    return type == VAL_INT || type == VAL_FLOAT;
+}
+
+/**
+ * @brief The type of a binary operation on operands of the given types, following the
+ * interpreter's operator table (`eval_binary_op`): void for combinations without a meaning.
+ */
+static int binary_result(Operator op, int left, int right)
+{
+    if (left == TYPE_UNPROVEN || right == TYPE_UNPROVEN)
+        return TYPE_UNPROVEN;
+    int is_comparison = op >= OPER_LESS && op <= OPER_NOT_EQUAL;
+    if (is_number(left) && is_number(right))
+    {
+        if (is_comparison)
+            return VAL_BOOL;
+        if (op == OPER_AND || op == OPER_OR)
+            return VAL_VOID;
+        if (left == VAL_INT && right == VAL_INT)
+            return VAL_INT;
+        return op == OPER_MODULO ? VAL_VOID : VAL_FLOAT;
+    }
+    if (left == VAL_STRING && right == VAL_STRING)
+    {
+        if (op == OPER_ADD)
+            return VAL_STRING;
+        return op == OPER_EQUAL || op == OPER_NOT_EQUAL ? VAL_BOOL : VAL_VOID;
+    }
+    if (left == VAL_BOOL && right == VAL_BOOL)
+        return op == OPER_AND || op == OPER_OR ? VAL_BOOL : VAL_VOID;
+    return VAL_VOID;
+}
+
+// --- Variables ---
+
+static void init_variables(Variable *variables, int count)
+{
+    for (int i = 0; i < count; i++)
+        variables[i] = (Variable){TYPE_UNPROVEN, TYPE_UNPROVEN, 0, NULL};
+}
+
+static Variable *new_variables(int count)
+{
+    Variable *variables = malloc((count > 0 ? count : 1) * sizeof(Variable));
+    if (!variables)
+    {
+        fprintf(stderr, "Fatal: Memory allocation failed for checker variables.\n");
+        exit(1);
+    }
+    init_variables(variables, count);
+    return variables;
+}
+
+static Variable *global_variable(Checker *checker, int slot)
+{
+    if (slot >= checker->global_capacity)
+    {
+        int capacity = checker->global_capacity == 0 ? 64 : checker->global_capacity;
+        while (capacity <= slot)
+            capacity *= 2;
+        checker->globals = realloc(checker->globals, capacity * sizeof(Variable));
+        if (!checker->globals)
+        {
+            fprintf(stderr, "Fatal: Memory allocation failed for checker globals.\n");
+            exit(1);
+        }
+        init_variables(checker->globals + checker->global_capacity, capacity - checker->global_capacity);
+        checker->global_capacity = capacity;
+    }
+    return &checker->globals[slot];
+}
+
+/**
+ * @brief Finds the variable a resolved node (reference, assignment target or declaration) names.
+ */
+static Variable *variable_of(Checker *checker, ASTNode *node)
+{
+    if (node->slot < 0)
+        return &checker->unknown;
+    if (node->depth == SCOPE_GLOBAL)
+        return global_variable(checker, node->slot);
+    int frame = checker->frame_count - 1 - node->depth;
+    if (frame < 0 || node->slot >= checker->frames[frame].count)
+        return &checker->unknown;
+    return &checker->frames[frame].slots[node->slot];
+}
+
+/**
+ * @brief Drops an assumed type. Pass 0 only records declarations, so it drops nothing.
+ */
+static void drop_assumption(Checker *checker, int *type)
+{
+    if (!checker->declaring && *type != TYPE_UNPROVEN)
+    {
+        *type = TYPE_UNPROVEN;
+        checker->changed = 1;
+    }
+}
+
+/**
+ * @brief Records that a value of type `type` is stored in a variable.
+ */
+static void write_variable(Checker *checker, Variable *variable, int type)
+{
+    if (variable->type != type)
+        drop_assumption(checker, &variable->type);
+}
+
+/**
+ * @brief Records that a function may be called in ways the checker does not see, so its
+ * parameters can hold anything.
+ */
+static void lose_callers(Checker *checker, FunctionInfo *function)
+{
+    if (!checker->declaring && function->callers_known)
+    {
+        function->callers_known = 0;
+        checker->changed = 1;
+    }
+}
+
+/**
+ * @brief Records a declaration of a variable with the given declared type (pass 0).
+ */
+static void declare_variable(Checker *checker, ASTNode *node, int declared)
+{
+    Variable *variable = variable_of(checker, node);
+    if (variable == &checker->unknown)
+        return;
+    if (!variable->is_declared)
+    {
+        variable->is_declared = 1;
+        variable->declared = declared;
+        variable->type = declared;
+        return;
+    }
+    // Redeclared (a global declared twice): only a type both declarations agree on is kept.
+    if (variable->declared != declared)
+        variable->declared = variable->type = TYPE_UNPROVEN;
+    if (variable->function)
+    {
+        variable->function->callers_known = 0;
+        variable->function = NULL;
+    }
+}
+
+// --- Frames ---
+
+static void enter_frame(Checker *checker, Variable *slots, int count, FunctionInfo *function)
+{
+    if (checker->frame_count >= checker->frame_capacity)
+    {
+        checker->frame_capacity = checker->frame_capacity == 0 ? 8 : checker->frame_capacity * 2;
+        checker->frames = realloc(checker->frames, checker->frame_capacity * sizeof(CheckerFrame));
+        if (!checker->frames)
+        {
+            fprintf(stderr, "Fatal: Memory allocation failed for checker frames.\n");
+            exit(1);
+        }
+    }
+    checker->frames[checker->frame_count++] = (CheckerFrame){slots, count, function, 0, 0};
+}
+
+static CheckerFrame *current_frame(Checker *checker)
+{
+    return &checker->frames[checker->frame_count - 1];
+}
+
+// --- Functions ---
+
+/**
+ * @brief Returns the info of a function definition: created in pass 0, then met again in the
+ * same order by every later pass.
+ */
+static FunctionInfo *function_info(Checker *checker, ASTNode *def, int is_method)
+{
+    if (!checker->declaring)
+        return checker->functions[checker->next_function++];
+
+    FunctionInfo *function = malloc(sizeof(FunctionInfo));
+    if (!function)
+    {
+        fprintf(stderr, "Fatal: Memory allocation failed for checker function.\n");
+        exit(1);
+    }
+    function->def = def;
+    function->declared_return = type_from_name(def->type_name);
+    // A void result is not worth proving: only the types of values are used.
+    function->returns = function->declared_return == VAL_VOID ? TYPE_UNPROVEN : function->declared_return;
+    function->callers_known = !is_method;
+    function->first_param = is_method ? 1 : 0;
+    function->slots = new_variables(def->slot_count);
+    for (int i = 0; i < def->arg_count && function->first_param + i < def->slot_count; i++)
+    {
+        Variable *param = &function->slots[function->first_param + i];
+        param->is_declared = 1;
+        param->declared = param->type = type_from_name(def->arg_types ? def->arg_types[i] : NULL);
+    }
+
+    if (checker->function_count >= checker->function_capacity)
+    {
+        checker->function_capacity = checker->function_capacity == 0 ? 16 : checker->function_capacity * 2;
+        checker->functions = realloc(checker->functions, checker->function_capacity * sizeof(FunctionInfo *));
+        if (!checker->functions)
+        {
+            fprintf(stderr, "Fatal: Memory allocation failed for checker functions.\n");
+            exit(1);
+        }
+    }
+    checker->functions[checker->function_count++] = function;
+    return function;
+}
+
+int always_returns(ASTNode *node)
+{
+    if (!node)
+        return 0;
+    switch (node->type)
+    {
+        case AST_RETURN:
+            return 1;
+        case AST_BLOCK:
+            for (int i = 0; i < node->children_count; i++)
+            {
+                if (always_returns(node->children[i]))
+                    return 1;
+            }
+            return 0;
+        case AST_IF:
+            return node->children_count > 2 && always_returns(node->children[1]) &&
+                   always_returns(node->children[2]);
+        default:
+            return 0;
+    }
+}
+
+/**
+ * @brief Checks a function definition.
+ * @return The function's info.
+ */
+static FunctionInfo *check_function(Checker *checker, ASTNode *def, int is_method)
+{
+    FunctionInfo *function = function_info(checker, def, is_method);
+    if (!function->callers_known)
+    {
+        for (int i = 0; i < def->arg_count && function->first_param + i < def->slot_count; i++)
+            drop_assumption(checker, &function->slots[function->first_param + i].type);
+    }
+
+    enter_frame(checker, function->slots, def->slot_count, function);
+    if (def->children_count > 0)
+    {
+        check_node(checker, def->children[0]);
+        // Falling off the end of the body returns void.
+        if (!always_returns(def->children[0]))
+            drop_assumption(checker, &function->returns);
+    }
+    checker->frame_count--;
+    return function;
+}
+
+/**
+ * @brief Checks a call, and binds the arguments of a direct call to the callee's parameters.
+ * @return The type of the call's result.
+ */
+static int check_call(Checker *checker, ASTNode *call)
+{
+    ASTNode *callee = call->children[0];
+    FunctionInfo *function = NULL;
+    if (callee && callee->type == AST_VAR_REF)
+        function = variable_of(checker, callee)->function;
+    else if (callee && callee->type == AST_FIELD_ACCESS && callee->children_count > 0)
+        check_node(checker, callee->children[0]); // A method: the receiver is read, the member is not
+    else
+        check_node(checker, callee);
+
+    if (!function)
+    {
+        // Any function read here may be called with anything.
+        if (callee && callee->type == AST_VAR_REF)
+            check_node(checker, callee);
+        for (int i = 1; i < call->children_count; i++)
+            check_node(checker, call->children[i]);
+        return TYPE_UNPROVEN;
+    }
+
+    ASTNode *def = function->def;
+    int arg_count = call->children_count - 1;
+    if (arg_count != def->arg_count)
+        type_error(checker, call->line_num, "'%s' takes %d argument(s) but is given %d.", def->value,
+                   def->arg_count, arg_count);
+    for (int i = 0; i < def->arg_count && function->first_param + i < def->slot_count; i++)
+    {
+        Variable *param = &function->slots[function->first_param + i];
+        // A missing argument leaves the parameter void.
+        int type = i < arg_count ? check_node(checker, call->children[i + 1]) : VAL_VOID;
+        if (i < arg_count && !is_compatible(param->declared, type))
+            type_error(checker, call->line_num, "Argument %d of '%s' should be '%s' but is '%s'.", i + 1,
+                       def->value, type_name_of(param->declared), type_name_of(type));
+        write_variable(checker, param, type);
+    }
+    for (int i = def->arg_count; i < arg_count; i++)
+        check_node(checker, call->children[i + 1]);
+    return function->returns;
+}
+
+// --- Nodes ---
+
+static void check_children(Checker *checker, ASTNode *node, int first)
+{
+    for (int i = first; i < node->children_count; i++)
+        check_node(checker, node->children[i]);
+}
+
+/**
+ * @brief Returns the variables of a loop's iteration frame: created in pass 0, then met again in
+ * the same order by every later pass, like function infos.
+ */
+static Variable *iteration_slots(Checker *checker, ASTNode *loop)
+{
+    if (!checker->declaring)
+        return checker->iterations[checker->next_iteration++];
+
+    if (checker->iteration_count >= checker->iteration_capacity)
+    {
+        checker->iteration_capacity = checker->iteration_capacity == 0 ? 16 : checker->iteration_capacity * 2;
+        checker->iterations = realloc(checker->iterations, checker->iteration_capacity * sizeof(Variable *));
+        if (!checker->iterations)
+        {
+            fprintf(stderr, "Fatal: Memory allocation failed for checker loops.\n");
+            exit(1);
+        }
+    }
+    Variable *slots = new_variables(loop->slot_count);
+    checker->iterations[checker->iteration_count++] = slots;
+    return slots;
+}
+
+/**
+ * @brief Opens a loop body, in a frame of its own if the resolver gave its iterations one.
+ */
+static void enter_loop(Checker *checker, ASTNode *loop)
+{
+    if (loop->frame_captured)
+        enter_frame(checker, iteration_slots(checker, loop), loop->slot_count, current_frame(checker)->function);
+    CheckerFrame *frame = current_frame(checker);
+    frame->breakables++;
+    frame->loops++;
+}
+
+static void leave_loop(Checker *checker, ASTNode *loop)
+{
+    CheckerFrame *frame = current_frame(checker);
+    frame->breakables--;
+    frame->loops--;
+    if (loop->frame_captured)
+        checker->frame_count--;
+}
+
+/**
+ * @brief Checks the body of a switch clause, which `break` can leave.
+ */
+static void check_clause(Checker *checker, ASTNode *body)
+{
+    CheckerFrame *frame = current_frame(checker);
+    frame->breakables++;
+    check_node(checker, body);
+    frame = current_frame(checker);
+    frame->breakables--;
+}
+
+static void check_var_decl(Checker *checker, ASTNode *node)
+{
+    int declared = type_from_name(node->type_name);
+    int type;
+    if (node->children_count > 0 && node->children[0] && node->children[0]->type == AST_ARRAY_SPECIFIER)
+    {
+        check_children(checker, node->children[0], 0);
+        declared = type = VAL_LIST;
+    }
+    else if (node->type_name && strncmp(node->type_name, "map<", 4) == 0)
+    {
+        // Map declarations always create a map, filled from the literal's keys and values.
+        if (node->children_count > 0 && node->children[0])
+            check_children(checker, node->children[0], 0);
+        type = VAL_HASHMAP;
+    }
+    else if (node->children_count > 0 && node->children[0])
+    {
+        type = check_node(checker, node->children[0]);
+        if (!is_compatible(declared, type))
+            type_error(checker, node->line_num, "'%s' is declared '%s' but initialized with '%s'.", node->value,
+                       type_name_of(declared), type_name_of(type));
+    }
+    else
+    {
+        type = VAL_VOID;
+    }
+
+    if (checker->declaring)
+        declare_variable(checker, node, declared);
+    write_variable(checker, variable_of(checker, node), type);
+}
+
+static void check_assignment(Checker *checker, ASTNode *node)
+{
+    ASTNode *target = node->children[0];
+    int type = check_node(checker, node->children[1]);
+    if (target->type != AST_VAR_REF)
+    {
+        // Fields and elements: the object and the index are read.
+        check_children(checker, target, 0);
+        return;
+    }
+
+    Variable *variable = variable_of(checker, target);
+    if (!is_compatible(variable->declared, type))
+        type_error(checker, node->line_num, "Cannot assign '%s' to '%s', declared '%s'.", type_name_of(type),
+                   target->value, type_name_of(variable->declared));
+    write_variable(checker, variable, type);
+    if (variable->function && !checker->declaring)
+    {
+        // The variable no longer always holds the function, so calls through it are not bound.
+        lose_callers(checker, variable->function);
+        variable->function = NULL;
+        checker->changed = 1;
+    }
+}
+
+static void check_return(Checker *checker, ASTNode *node)
+{
+    int type = VAL_VOID;
+    if (node->children_count > 0 && node->children[0])
+        type = check_node(checker, node->children[0]);
+
+    FunctionInfo *function = current_frame(checker)->function;
+    if (!function)
+        return;
+    if (function->declared_return != TYPE_UNPROVEN && !is_compatible(function->declared_return, type))
+        type_error(checker, node->line_num, "'%s' should return '%s' but returns '%s'.", function->def->value,
+                   type_name_of(function->declared_return), type_name_of(type));
+    if (function->returns != type)
+        drop_assumption(checker, &function->returns);
+}
+
+static int check_binary(Checker *checker, ASTNode *node)
+{
+    int left = check_node(checker, node->children[0]);
+    int right = check_node(checker, node->children[1]);
+    int result = binary_result(node->op, left, right);
+    if (result == VAL_VOID)
+    {
+        type_error(checker, node->line_num, "Operator '%s' cannot be applied to '%s' and '%s'.", node->value,
+                   type_name_of(left), type_name_of(right));
+        return TYPE_UNPROVEN;
+    }
+    return result;
+}
+
+static int check_unary(Checker *checker, ASTNode *node)
+{
+    int operand = check_node(checker, node->children[0]);
+    if (operand == TYPE_UNPROVEN)
+        return TYPE_UNPROVEN;
+    if (node->op == OPER_NEGATE && is_number(operand))
+        return operand;
+    if (node->op == OPER_NOT && operand == VAL_BOOL)
+        return VAL_BOOL;
+    type_error(checker, node->line_num, "Operator '%s' cannot be applied to '%s'.", node->value,
+               type_name_of(operand));
+    return TYPE_UNPROVEN;
+}
+
+/**
+ * @brief Checks a node of any kind.
+ * @return The type of an expression, or TYPE_UNPROVEN (also for statements).
+ */
+static int check_node(Checker *checker, ASTNode *node)
+{
+    if (!node)
+        return TYPE_UNPROVEN;
+
+    int type = TYPE_UNPROVEN;
+    switch (node->type)
+    {
+        case AST_INT_LITERAL:
+            type = VAL_INT;
+            break;
+        case AST_FLOAT_LITERAL:
+            type = VAL_FLOAT;
+            break;
+        case AST_STRING_LITERAL:
+            type = VAL_STRING;
+            break;
+        case AST_BOOL_LITERAL:
+            type = VAL_BOOL;
+            break;
+        case AST_LIST_LITERAL:
+            check_children(checker, node, 0);
+            type = VAL_LIST;
+            break;
+        case AST_VAR_REF:
+        {
+            Variable *variable = variable_of(checker, node);
+            // Read as a value, a function can be called from anywhere.
+            if (variable->function)
+                lose_callers(checker, variable->function);
+            type = variable->type;
+            break;
+        }
+        case AST_BINARY_OP:
+            if (node->children_count == 2)
+                type = check_binary(checker, node);
+            break;
+        case AST_LOGICAL_OP:
+            if (node->children_count == 2)
+                type = check_binary(checker, node);
+            break;
+        case AST_UNARY_OP:
+            if (node->children_count == 1)
+                type = check_unary(checker, node);
+            break;
+        case AST_FUNC_CALL:
+            if (node->children_count > 0)
+                type = check_call(checker, node);
+            break;
+        case AST_VAR_DECL:
+            check_var_decl(checker, node);
+            break;
+        case AST_ASSIGNMENT:
+            if (node->children_count == 2)
+                check_assignment(checker, node);
+            break;
+        case AST_RETURN:
+            check_return(checker, node);
+            break;
+        case AST_FUNC_DEF:
+            if (checker->declaring)
+            {
+                int is_redeclared = variable_of(checker, node)->is_declared;
+                declare_variable(checker, node, VAL_FUNC);
+                FunctionInfo *function = check_function(checker, node, 0);
+                Variable *variable = variable_of(checker, node);
+                // Only a variable bound to this one definition always holds it.
+                if (!is_redeclared && variable != &checker->unknown)
+                    variable->function = function;
+                else
+                    function->callers_known = 0;
+            }
+            else
+            {
+                check_function(checker, node, 0);
+            }
+            break;
+        case AST_CLASS_DEF:
+        {
+            int first_member = 0;
+            if (node->parent_class_name)
+            {
+                check_node(checker, node->children[0]);
+                first_member = 1;
+            }
+            if (checker->declaring)
+                declare_variable(checker, node, VAL_CLASS);
+            for (int i = first_member; i < node->children_count; i++)
+            {
+                if (node->children[i] && node->children[i]->type == AST_FUNC_DEF)
+                    check_function(checker, node->children[i], 1);
+            }
+            break;
+        }
+        case AST_IMPORT:
+            // A module may assign the program's globals, which the checker cannot see.
+            checker->prove_globals = 0;
+            if (checker->declaring)
+                declare_variable(checker, node, VAL_MODULE);
+            break;
+        case AST_FOREACH:
+            check_node(checker, get_child(node, 0));
+            enter_loop(checker, node);
+            if (checker->declaring)
+                declare_variable(checker, node, type_from_name(node->type_name));
+            // The elements of a list are not tracked.
+            write_variable(checker, variable_of(checker, node), TYPE_UNPROVEN);
+            check_node(checker, get_child(node, 1));
+            leave_loop(checker, node);
+            break;
+        case AST_WHILE:
+            check_node(checker, get_child(node, 0));
+            enter_loop(checker, node);
+            check_node(checker, get_child(node, 1));
+            leave_loop(checker, node);
+            break;
+        case AST_DO_WHILE:
+            enter_loop(checker, node);
+            check_node(checker, get_child(node, 0));
+            leave_loop(checker, node);
+            check_node(checker, get_child(node, 1));
+            break;
+        case AST_FOR:
+            check_node(checker, get_child(node, 0));
+            check_node(checker, get_child(node, 1));
+            check_node(checker, get_child(node, 2));
+            enter_loop(checker, node);
+            check_node(checker, get_child(node, 3));
+            leave_loop(checker, node);
+            break;
+        case AST_SWITCH:
+            check_node(checker, get_child(node, 0));
+            for (int i = 1; i < node->children_count; i++)
+                check_clause(checker, node->children[i]);
+            break;
+        case AST_BREAK:
+        case AST_CONTINUE:
+        {
+            // Outside of any loop, the signal ends the function early with no value.
+            CheckerFrame *frame = current_frame(checker);
+            int targets = node->type == AST_BREAK ? frame->breakables : frame->loops;
+            if (targets == 0 && frame->function)
+                drop_assumption(checker, &frame->function->returns);
+            break;
+        }
+        case AST_FIELD_DECL:
+            break;
+        default:
+            check_children(checker, node, 0);
+            break;
+    }
+
+    if (!checker->declaring)
+        node->static_type = type;
+    return type;
+}
+
+// --- Entry Point ---
+
+int check_program(ASTNode *root, int owns_globals, int report)
+{
+    Checker checker;
+    memset(&checker, 0, sizeof(Checker));
+    checker.unknown = (Variable){TYPE_UNPROVEN, TYPE_UNPROVEN, 1, NULL};
+    checker.prove_globals = owns_globals;
+
+    Variable *program_slots = new_variables(root->slot_count);
+    enter_frame(&checker, program_slots, root->slot_count, NULL);
+
+    checker.declaring = 1;
+    check_children(&checker, root, 0);
+    checker.declaring = 0;
+    if (!checker.prove_globals)
+    {
+        for (int i = 0; i < checker.global_capacity; i++)
+        {
+            checker.globals[i].type = TYPE_UNPROVEN;
+            if (checker.globals[i].function)
+                checker.globals[i].function->callers_known = 0;
+            checker.globals[i].function = NULL;
+        }
+    }
+
+    int passes = 0;
+    do
+    {
+        checker.changed = 0;
+        checker.next_function = 0;
+        checker.next_iteration = 0;
+        check_children(&checker, root, 0);
+        passes++;
+    }
+    while (checker.changed);
+
+#ifdef DEBUG_TRACE_CHECKER
+    printf("[CHECKER] Types settled after %d pass(es)\n", passes);
+    for (int i = 0; i < checker.function_count; i++)
+    {
+        FunctionInfo *function = checker.functions[i];
+        printf("[CHECKER] '%s' returns %s", function->def->value,
+               function->returns == TYPE_UNPROVEN ? "unproven" : type_name_of(function->returns));
+        for (int p = 0; p < function->def->arg_count && function->first_param + p < function->def->slot_count; p++)
+        {
+            int type = function->slots[function->first_param + p].type;
+            printf(", %s: %s", function->def->args[p], type == TYPE_UNPROVEN ? "unproven" : type_name_of(type));
+        }
+        printf("\n");
+    }
+#endif
+
+    if (report)
+    {
+        // The assumptions are settled: one more pass reports the errors under them.
+        checker.report = 1;
+        checker.next_function = 0;
+        checker.next_iteration = 0;
+        check_children(&checker, root, 0);
+    }
+
+    for (int i = 0; i < checker.function_count; i++)
+    {
+        free(checker.functions[i]->slots);
+        free(checker.functions[i]);
+    }
+    free(checker.functions);
+    for (int i = 0; i < checker.iteration_count; i++)
+        free(checker.iterations[i]);
+    free(checker.iterations);
+    free(checker.frames);
+    free(checker.globals);
+    free(program_slots);
+    return checker.error_count;
+}
@@ -0,0 +1,41 @@
+/**
+ * @file checker.h
+ * @brief Header file for the Pith static type checker.
+ *
+ * The checker runs after `resolve_program`. It reports the type errors it can see without
+ * running the program (an operator applied to operands it has no meaning for, an initializer,
+ * assignment, argument or return value that does not match its declared type, a call with the
+ * wrong number of arguments), and it records in `ASTNode.static_type` the type of every
+ * expression that yields the same type on every evaluation.
+ *
+ * Those proofs come from what the program actually stores, not from its declarations alone,
+ * so they hold whether or not the program has type errors: a variable is proven to be an int
+ * only if every value written to it (initializer, assignments, arguments of every call) is an
+ * int. The tree-walker uses them to run operators without checking their operand types.
+ */
+
+#ifndef PITH_CHECKER_H
+#define PITH_CHECKER_H
+
+#include "parser.h"
+
+/**
+ * @brief Checks a program and annotates its expressions with their proven types.
+ *
+ * @param root The AST_PROGRAM node, already resolved.
+ * @param owns_globals Whether no other code (a later REPL entry) will run against the program's
+ *                     globals, so that the types of globals can be proven.
+ * @param report Whether to print each type error to stderr.
+ * @return The number of type errors reported (0 when `report` is not set).
+ */
+int check_program(ASTNode *root, int owns_globals, int report);
+
+/**
+ * @brief Returns whether running a statement always ends in a `return`.
+ *
+ * Only a return, a block containing one and an if whose branches all return count: a function
+ * that may fall off the end of its body returns void.
+ */
+int always_returns(ASTNode *node);
+
+#endif //PITH_CHECKER_H
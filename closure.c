@@ -0,0 +1,1257 @@
+/**
+ * @file closure.c
+ * @brief Implementation of the Pith closure compiler.
+ *
+ * Every specialised closure does exactly what the matching case of `eval_node` or `exec_node`
+ * does, including which temporaries are rooted while the GC may run.
+ */
+
+#include "closure.h"
+#include "interpreter.h"
+#include "constants.h"
+#include "switch_table.h"
+#include "gc.h"
+#include "debug.h"
+#include "common.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief Runs in a row with the same operand types (or receiver class) before a node quickens.
+ */
+#define QUICKEN_THRESHOLD 8
+
+/**
+ * @brief `ClosureNode.hits` of a node that no longer observes its operands.
+ */
+#define QUICKEN_DONE (-1)
+
+static ClosureNode *build_expression(ASTNode *node);
+static ClosureNode *build_call(ASTNode *node, int is_tail_call);
+
+static ClosureNode *new_closure(ASTNode *node, ClosureFn fn, int operand_count)
+{
+    ClosureNode *closure = malloc(sizeof(ClosureNode) + operand_count * sizeof(ClosureNode *));
+    if (!closure)
+    {
+        fprintf(stderr, "Fatal: Memory allocation failed for closure.\n");
+        exit(1);
+    }
+    closure->fn = fn;
+    closure->node = node;
+    closure->constant = (Value){VAL_VOID};
+    closure->slot = 0;
+    closure->op = OPER_NONE;
+    closure->guard = 0;
+    closure->hits = 0;
+    closure->operand_count = operand_count;
+    return closure;
+}
+
+#define RUN(closure) ((closure)->fn((closure), env))
+
+/**
+ * @brief Checks that the first `count` children of a node exist, so they can be compiled.
+ */
+static int has_children(ASTNode *node, int count)
+{
+    if (count == 0 || node->children_count < count)
+        return 0;
+    for (int i = 0; i < count; i++)
+    {
+        if (!node->children[i])
+            return 0;
+    }
+    return 1;
+}
+
+// --- Generic Nodes ---
+
+static Value run_eval_node(ClosureNode *self, Env *env)
+{
+    return eval_node(self->node, env);
+}
+
+static Value run_exec_node(ClosureNode *self, Env *env)
+{
+    return exec_node(self->node, env);
+}
+
+// --- Variables and Constants ---
+
+static Value run_constant(ClosureNode *self, Env *env)
+{
+    return self->constant;
+}
+
+static Value get_local(ClosureNode *self, Env *env)
+{
+    return env->slots[self->slot];
+}
+
+static Value get_global(ClosureNode *self, Env *env)
+{
+    return global_get(self->slot, self->node->line_num);
+}
+
+static Value get_variable(ClosureNode *self, Env *env)
+{
+    return env_get(env, self->node);
+}
+
+static int is_local_read(ClosureNode *closure)
+{
+    return closure->fn == get_local;
+}
+
+// --- Quickening ---
+
+/**
+ * @brief Returns whether a generic node has now run often enough with the same `guard` (operand
+ * types or receiver class) to specialise for it.
+ *
+ * A node gets one chance: after QUICKEN_THRESHOLD runs in a row with the same guard it stops
+ * observing, whether or not a specialisation exists for what it saw.
+ */
+static int observe(ClosureNode *self, int guard)
+{
+    if (self->hits == QUICKEN_DONE)
+        return 0;
+    if (guard != self->guard)
+    {
+        self->guard = guard;
+        self->hits = 0;
+    }
+    if (++self->hits < QUICKEN_THRESHOLD)
+        return 0;
+    self->hits = QUICKEN_DONE;
+    return 1;
+}
+
+/**
+ * @brief Installs a specialised closure in place of a generic one.
+ */
+static void quicken(ClosureNode *self, ClosureFn specialised)
+{
+#ifdef DEBUG_TRACE_QUICKENING
+    printf("[QUICKEN] Node type %d at line %d specialised for guard %d\n", self->node->type,
+           self->node->line_num, self->guard);
+#endif
+    self->fn = specialised;
+}
+
+/**
+ * @brief Puts the generic closure back after a specialised one failed its guard, for good.
+ */
+static void deoptimise(ClosureNode *self, ClosureFn generic)
+{
+#ifdef DEBUG_TRACE_QUICKENING
+    printf("[QUICKEN] Node type %d at line %d fell back to its generic form\n", self->node->type,
+           self->node->line_num);
+#endif
+    self->fn = generic;
+}
+
+// --- Operators ---
+
+static Value int_value(int value)
+{
+    Value v;
+    v.type = VAL_INT;
+    v.int_val = value;
+    return v;
+}
+
+static Value float_value(double value)
+{
+    Value v;
+    v.type = VAL_FLOAT;
+    v.float_val = value;
+    return v;
+}
+
+static Value bool_value(int value)
+{
+    Value v;
+    v.type = VAL_BOOL;
+    v.int_val = value;
+    return v;
+}
+
+/**
+ * @brief Applies a binary operator to already-evaluated operands through `eval_binary_op`.
+ *
+ * Both operands stay rooted while the operator runs, as it may allocate (string concatenation).
+ */
+static Value binary_generic_path(ClosureNode *self, Value left, Value right)
+{
+    gc_push_value(left);
+    gc_push_value(right);
+    Value result = eval_binary_op(self->op, left, right);
+    gc_pop_roots(2);
+    return result;
+}
+
+/**
+ * @brief Operand types that binary operators specialise for.
+ */
+typedef enum
+{
+    OPERANDS_INT,
+    OPERANDS_FLOAT,
+    OPERANDS_STRING,
+    OPERANDS_OTHER,
+    OPERAND_KIND_COUNT
+} OperandKind;
+
+static OperandKind operand_kind(int left_type, int right_type)
+{
+    if (left_type != right_type)
+        return OPERANDS_OTHER;
+    switch (left_type)
+    {
+        case VAL_INT:
+            return OPERANDS_INT;
+        case VAL_FLOAT:
+            return OPERANDS_FLOAT;
+        case VAL_STRING:
+            return OPERANDS_STRING;
+        default:
+            return OPERANDS_OTHER;
+    }
+}
+
+/**
+ * @brief Where a binary operator reads its operands from.
+ *
+ * `local` operands are variables of the current frame and `constant` operands are literals, so
+ * reading them cannot trigger a collection and the left operand needs no root.
+ */
+typedef enum
+{
+    SHAPE_LOCAL_CONSTANT,
+    SHAPE_LOCAL_LOCAL,
+    SHAPE_ANY_CONSTANT,
+    SHAPE_ANY_ANY,
+    SHAPE_COUNT
+} BinaryShape;
+
+static void quicken_binary(ClosureNode *self, OperandKind kind);
+
+/**
+ * @brief The generic binary operator: runs the operands, applies the operator through the
+ * handler table, and watches the operand types to quicken the node.
+ */
+static Value binary_any_any(ClosureNode *self, Env *env)
+{
+    Value left = RUN(self->operands[0]);
+    gc_push_value(left);
+    Value right = RUN(self->operands[1]);
+    gc_pop_root();
+    OperandKind kind = operand_kind(left.type, right.type);
+    if (observe(self, kind))
+        quicken_binary(self, kind);
+    return binary_generic_path(self, left, right);
+}
+
+static Value binary_deoptimise(ClosureNode *self, Value left, Value right)
+{
+    deoptimise(self, binary_any_any);
+    return binary_generic_path(self, left, right);
+}
+
+/**
+ * @brief Defines the closures of a binary operator for one operand type, one per shape.
+ *
+ * Each computes the result directly when `guard` holds for its operands; any other operands
+ * deoptimise the node.
+ */
+#define BINARY_SHAPES(name, guard, result) \
+    static Value name##_local_constant(ClosureNode *self, Env *env) \
+    { \
+        Value l = env->slots[self->slot]; \
+        Value r = self->constant; \
+        if (guard) \
+            return result; \
+        return binary_deoptimise(self, l, r); \
+    } \
+    static Value name##_local_local(ClosureNode *self, Env *env) \
+    { \
+        Value l = env->slots[self->slot]; \
+        Value r = env->slots[self->operands[1]->slot]; \
+        if (guard) \
+            return result; \
+        return binary_deoptimise(self, l, r); \
+    } \
+    static Value name##_any_constant(ClosureNode *self, Env *env) \
+    { \
+        Value l = RUN(self->operands[0]); \
+        Value r = self->constant; \
+        if (guard) \
+            return result; \
+        return binary_deoptimise(self, l, r); \
+    } \
+    static Value name##_any_any(ClosureNode *self, Env *env) \
+    { \
+        Value l = RUN(self->operands[0]); \
+        gc_push_value(l); \
+        Value r = RUN(self->operands[1]); \
+        gc_pop_root(); \
+        if (guard) \
+            return result; \
+        return binary_deoptimise(self, l, r); \
+    }
+
+/**
+ * @brief Defines the closures of a binary operator for one operand type: the quickened ones,
+ * which check both operand types, and the `proven_` ones, used where the checker proved them.
+ */
+#define TYPED_BINARY_SHAPES(name, type_tag, result) \
+    BINARY_SHAPES(name, l.type == type_tag && r.type == type_tag, result) \
+    BINARY_SHAPES(proven_##name, 1, result)
+
+TYPED_BINARY_SHAPES(int_add, VAL_INT, int_value(l.int_val + r.int_val))
+TYPED_BINARY_SHAPES(int_subtract, VAL_INT, int_value(l.int_val - r.int_val))
+TYPED_BINARY_SHAPES(int_multiply, VAL_INT, int_value(l.int_val * r.int_val))
+TYPED_BINARY_SHAPES(int_less, VAL_INT, bool_value(l.int_val < r.int_val))
+TYPED_BINARY_SHAPES(int_greater, VAL_INT, bool_value(l.int_val > r.int_val))
+TYPED_BINARY_SHAPES(int_less_equal, VAL_INT, bool_value(l.int_val <= r.int_val))
+TYPED_BINARY_SHAPES(int_greater_equal, VAL_INT, bool_value(l.int_val >= r.int_val))
+TYPED_BINARY_SHAPES(int_equal, VAL_INT, bool_value(l.int_val == r.int_val))
+TYPED_BINARY_SHAPES(int_not_equal, VAL_INT, bool_value(l.int_val != r.int_val))
+
+TYPED_BINARY_SHAPES(float_add, VAL_FLOAT, float_value(l.float_val + r.float_val))
+TYPED_BINARY_SHAPES(float_subtract, VAL_FLOAT, float_value(l.float_val - r.float_val))
+TYPED_BINARY_SHAPES(float_multiply, VAL_FLOAT, float_value(l.float_val * r.float_val))
+TYPED_BINARY_SHAPES(float_divide, VAL_FLOAT, float_value(l.float_val / r.float_val))
+TYPED_BINARY_SHAPES(float_less, VAL_FLOAT, bool_value(l.float_val < r.float_val))
+TYPED_BINARY_SHAPES(float_greater, VAL_FLOAT, bool_value(l.float_val > r.float_val))
+TYPED_BINARY_SHAPES(float_less_equal, VAL_FLOAT, bool_value(l.float_val <= r.float_val))
+TYPED_BINARY_SHAPES(float_greater_equal, VAL_FLOAT, bool_value(l.float_val >= r.float_val))
+TYPED_BINARY_SHAPES(float_equal, VAL_FLOAT, bool_value(l.float_val == r.float_val))
+TYPED_BINARY_SHAPES(float_not_equal, VAL_FLOAT, bool_value(l.float_val != r.float_val))
+
+// Strings are interned, so equal strings are the same object.
+TYPED_BINARY_SHAPES(string_equal, VAL_STRING, bool_value(l.string == r.string))
+TYPED_BINARY_SHAPES(string_not_equal, VAL_STRING, bool_value(l.string != r.string))
+
+#undef TYPED_BINARY_SHAPES
+#undef BINARY_SHAPES
+
+#define SHAPES(name) {name##_local_constant, name##_local_local, name##_any_constant, name##_any_any}
+
+#define BINARY_CLOSURE_TABLE(prefix) { \
+    [OPER_ADD] = {[OPERANDS_INT] = SHAPES(prefix##int_add), [OPERANDS_FLOAT] = SHAPES(prefix##float_add)}, \
+    [OPER_SUBTRACT] = {[OPERANDS_INT] = SHAPES(prefix##int_subtract), \
+                       [OPERANDS_FLOAT] = SHAPES(prefix##float_subtract)}, \
+    [OPER_MULTIPLY] = {[OPERANDS_INT] = SHAPES(prefix##int_multiply), \
+                       [OPERANDS_FLOAT] = SHAPES(prefix##float_multiply)}, \
+    [OPER_DIVIDE] = {[OPERANDS_FLOAT] = SHAPES(prefix##float_divide)}, \
+    [OPER_LESS] = {[OPERANDS_INT] = SHAPES(prefix##int_less), [OPERANDS_FLOAT] = SHAPES(prefix##float_less)}, \
+    [OPER_GREATER] = {[OPERANDS_INT] = SHAPES(prefix##int_greater), \
+                      [OPERANDS_FLOAT] = SHAPES(prefix##float_greater)}, \
+    [OPER_LESS_EQUAL] = {[OPERANDS_INT] = SHAPES(prefix##int_less_equal), \
+                         [OPERANDS_FLOAT] = SHAPES(prefix##float_less_equal)}, \
+    [OPER_GREATER_EQUAL] = {[OPERANDS_INT] = SHAPES(prefix##int_greater_equal), \
+                            [OPERANDS_FLOAT] = SHAPES(prefix##float_greater_equal)}, \
+    [OPER_EQUAL] = {[OPERANDS_INT] = SHAPES(prefix##int_equal), [OPERANDS_FLOAT] = SHAPES(prefix##float_equal), \
+                    [OPERANDS_STRING] = SHAPES(prefix##string_equal)}, \
+    [OPER_NOT_EQUAL] = {[OPERANDS_INT] = SHAPES(prefix##int_not_equal), \
+                        [OPERANDS_FLOAT] = SHAPES(prefix##float_not_equal), \
+                        [OPERANDS_STRING] = SHAPES(prefix##string_not_equal)}, \
+}
+
+/**
+ * @brief The specialised closures of every (operator, operand type) pair that has them.
+ *
+ * Integer division and modulo are left to the generic path, which matches the VM's behavior on
+ * a zero divisor.
+ */
+static const ClosureFn quickened_binary_closures[BINARY_OPERATOR_COUNT][OPERAND_KIND_COUNT][SHAPE_COUNT] =
+    BINARY_CLOSURE_TABLE();
+
+/**
+ * @brief The closures that skip the operand type checks, for operands proven by the checker.
+ */
+static const ClosureFn proven_binary_closures[BINARY_OPERATOR_COUNT][OPERAND_KIND_COUNT][SHAPE_COUNT] =
+    BINARY_CLOSURE_TABLE(proven_);
+
+#undef BINARY_CLOSURE_TABLE
+#undef SHAPES
+
+static BinaryShape binary_shape(ClosureNode *self)
+{
+    ClosureNode *left = self->operands[0];
+    ClosureNode *right = self->operands[1];
+    if (right->fn == run_constant)
+        return is_local_read(left) ? SHAPE_LOCAL_CONSTANT : SHAPE_ANY_CONSTANT;
+    return is_local_read(left) && is_local_read(right) ? SHAPE_LOCAL_LOCAL : SHAPE_ANY_ANY;
+}
+
+static void quicken_binary(ClosureNode *self, OperandKind kind)
+{
+    ClosureFn specialised = quickened_binary_closures[self->op][kind][binary_shape(self)];
+    if (specialised)
+        quicken(self, specialised);
+}
+
+static Value run_concat(ClosureNode *self, Env *env)
+{
+    Value operands[MAX_CONCAT_OPERANDS];
+    for (int i = 0; i < self->operand_count; i++)
+    {
+        operands[i] = RUN(self->operands[i]);
+        gc_push_value(operands[i]);
+    }
+    Value result = concat_values(self->operand_count, operands);
+    gc_pop_roots(self->operand_count);
+    return result;
+}
+
+/**
+ * @brief Compiles a binary operator: a `+` chain building a string to one concatenation of all
+ * its operands, other operators to their unchecked closure if the checker proved the operand
+ * types, or else to the generic closure, which may quicken later.
+ */
+static ClosureNode *build_binary(ASTNode *node)
+{
+    ASTNode *parts[MAX_CONCAT_OPERANDS];
+    int part_count = concat_operands(node, parts);
+    if (part_count > 0)
+    {
+        ClosureNode *concat = new_closure(node, run_concat, part_count);
+        for (int i = 0; i < part_count; i++)
+            concat->operands[i] = compile_expression_closure(parts[i]);
+        return concat;
+    }
+
+    ClosureNode *closure = new_closure(node, binary_any_any, 2);
+    closure->op = node->op;
+    ClosureNode *left = closure->operands[0] = compile_expression_closure(node->children[0]);
+    ClosureNode *right = closure->operands[1] = compile_expression_closure(node->children[1]);
+    closure->slot = left->slot;
+    closure->constant = right->constant;
+
+    OperandKind kind = operand_kind(node->children[0]->static_type, node->children[1]->static_type);
+    ClosureFn proven = proven_binary_closures[node->op][kind][binary_shape(closure)];
+    if (proven)
+    {
+        closure->fn = proven;
+        closure->hits = QUICKEN_DONE;
+    }
+    return closure;
+}
+
+static Value run_logical(ClosureNode *self, Env *env)
+{
+    Value left = RUN(self->operands[0]);
+    // A false `and` or a true `or` decides the result without the right operand.
+    if (left.type == VAL_BOOL && left.int_val == (self->op == OPER_OR))
+        return left;
+    gc_push_value(left);
+    Value right = RUN(self->operands[1]);
+    gc_pop_root();
+    return eval_binary_op(self->op, left, right);
+}
+
+static Value run_unary(ClosureNode *self, Env *env)
+{
+    Value operand = RUN(self->operands[0]);
+    return eval_unary_op(self->op, operand, self->node->line_num);
+}
+
+// --- Members and Elements ---
+
+static Value get_member(ClosureNode *self, Env *env);
+
+/**
+ * @brief A field read quickened for instances of one class: reads the field's slot directly.
+ */
+static Value get_instance_field(ClosureNode *self, Env *env)
+{
+    Value object = RUN(self->operands[0]);
+    if (object.type == VAL_INSTANCE && object.instance->pith_class->id == self->guard &&
+        self->slot < object.instance->field_count && object.instance->fields[self->slot].type != VAL_VOID)
+        return object.instance->fields[self->slot];
+
+    deoptimise(self, get_member);
+    gc_push_value(object);
+    Value result = get_field_cached(object, MEMBER_NAME(self->node), self->node->cache, self->node->line_num);
+    gc_pop_root();
+    return result;
+}
+
+/**
+ * @brief The generic member read, through the site's inline cache. A site that keeps reading
+ * the same field of instances of one class quickens into `get_instance_field`.
+ */
+static Value get_member(ClosureNode *self, Env *env)
+{
+    Value object = RUN(self->operands[0]);
+    gc_push_value(object);
+    Value result = get_field_cached(object, MEMBER_NAME(self->node), self->node->cache, self->node->line_num);
+    gc_pop_root();
+
+    int guard = object.type == VAL_INSTANCE ? object.instance->pith_class->id : -1;
+    if (observe(self, guard) && guard >= 0)
+    {
+        FieldCache *cache = self->node->cache;
+        for (int i = 0; i < cache->count; i++)
+        {
+            // Methods are bound on every read, so only fields are worth a specialisation.
+            if (cache->entries[i].class_id == guard && cache->entries[i].slot >= 0)
+            {
+                self->slot = cache->entries[i].slot;
+                quicken(self, get_instance_field);
+                break;
+            }
+        }
+    }
+    return result;
+}
+
+static Value get_element(ClosureNode *self, Env *env);
+
+static Value get_list_element(ClosureNode *self, Env *env)
+{
+    Value collection = RUN(self->operands[0]);
+    gc_push_value(collection);
+    Value index = RUN(self->operands[1]);
+    gc_pop_root();
+    if (collection.type == VAL_LIST && index.type == VAL_INT)
+    {
+        if (index.int_val >= 0 && index.int_val < collection.list->count)
+            return collection.list->items[index.int_val];
+    }
+    else
+    {
+        deoptimise(self, get_element);
+    }
+    return get_index(collection, index, self->node->line_num);
+}
+
+/**
+ * @brief An element read of a list by an int, both proven by the checker: only the bounds are checked.
+ */
+static Value get_proven_list_element(ClosureNode *self, Env *env)
+{
+    Value collection = RUN(self->operands[0]);
+    gc_push_value(collection);
+    Value index = RUN(self->operands[1]);
+    gc_pop_root();
+    if (index.int_val >= 0 && index.int_val < collection.list->count)
+        return collection.list->items[index.int_val];
+    return get_index(collection, index, self->node->line_num);
+}
+
+static Value get_map_element(ClosureNode *self, Env *env)
+{
+    Value collection = RUN(self->operands[0]);
+    gc_push_value(collection);
+    Value index = RUN(self->operands[1]);
+    gc_pop_root();
+    if (collection.type == VAL_HASHMAP && index.type == VAL_STRING)
+        return hashmap_get(collection.hashmap, index.string);
+    deoptimise(self, get_element);
+    return get_index(collection, index, self->node->line_num);
+}
+
+/**
+ * @brief The generic element read. A site that keeps indexing lists with ints, or hashmaps with
+ * strings, quickens into `get_list_element` or `get_map_element`.
+ */
+static Value get_element(ClosureNode *self, Env *env)
+{
+    Value collection = RUN(self->operands[0]);
+    gc_push_value(collection);
+    Value index = RUN(self->operands[1]);
+    gc_pop_root();
+    Value result = get_index(collection, index, self->node->line_num);
+
+    int guard = collection.type << 8 | index.type;
+    if (observe(self, guard))
+    {
+        if (collection.type == VAL_LIST && index.type == VAL_INT)
+            quicken(self, get_list_element);
+        else if (collection.type == VAL_HASHMAP && index.type == VAL_STRING)
+            quicken(self, get_map_element);
+    }
+    return result;
+}
+
+// --- Calls ---
+
+/**
+ * @brief Evaluates the callee (or receiver) and the arguments of a call onto the frame stack.
+ *
+ * They stay rooted until `release_arguments` is called, after the call returns.
+ */
+static Value *run_arguments(ClosureNode *self, Env *env)
+{
+    Value *args = frame_stack_alloc(self->operand_count * sizeof(Value));
+    for (int i = 0; i < self->operand_count; i++)
+    {
+        args[i] = RUN(self->operands[i]);
+        gc_push_value(args[i]);
+    }
+    return args;
+}
+
+static void release_arguments(ClosureNode *self, Value *args)
+{
+    gc_pop_roots(self->operand_count);
+    frame_stack_release(args);
+}
+
+static Value run_call(ClosureNode *self, Env *env)
+{
+    Value *args = run_arguments(self, env);
+    Value result = call_value(args[0], self->operand_count - 1, args + 1, self->node->line_num);
+    release_arguments(self, args);
+    return result;
+}
+
+static Value run_invoke(ClosureNode *self, Env *env)
+{
+    ASTNode *callee = self->node->children[0];
+    Value *args = run_arguments(self, env);
+    Value result = call_method(MEMBER_NAME(callee), callee->cache, self->operand_count - 1, args,
+                               self->node->line_num);
+    release_arguments(self, args);
+    return result;
+}
+
+static Value run_tail_call(ClosureNode *self, Env *env)
+{
+    Value *args = run_arguments(self, env);
+    Value result = tail_call_value(args[0], self->operand_count - 1, args + 1, self->node->line_num);
+    release_arguments(self, args);
+    return result;
+}
+
+static Value run_tail_invoke(ClosureNode *self, Env *env)
+{
+    ASTNode *callee = self->node->children[0];
+    Value *args = run_arguments(self, env);
+    Value result = tail_call_method(MEMBER_NAME(callee), callee->cache, self->operand_count - 1, args,
+                                    self->node->line_num);
+    release_arguments(self, args);
+    return result;
+}
+
+/**
+ * @brief Compiles an AST_FUNC_CALL node.
+ *
+ * A member call (`obj.m(x)`) runs the receiver as its first operand and calls the member
+ * directly, so no bound method is created.
+ *
+ * @param is_tail_call Whether the call is returned by a `return` marked by the resolver.
+ */
+static ClosureNode *build_call(ASTNode *node, int is_tail_call)
+{
+    ASTNode *callee = node->children[0];
+    int is_member_call = callee->type == AST_FIELD_ACCESS;
+    ClosureFn fn;
+    if (is_member_call)
+        fn = is_tail_call ? run_tail_invoke : run_invoke;
+    else
+        fn = is_tail_call ? run_tail_call : run_call;
+
+    ClosureNode *closure = new_closure(node, fn, node->children_count);
+    closure->operands[0] = compile_expression_closure(is_member_call ? callee->children[0] : callee);
+    for (int i = 1; i < node->children_count; i++)
+        closure->operands[i] = compile_expression_closure(node->children[i]);
+    return closure;
+}
+
+// --- Expressions ---
+
+static ClosureNode *build_expression(ASTNode *node)
+{
+    ClosureNode *closure;
+    switch (node->type)
+    {
+        case AST_INT_LITERAL:
+        case AST_FLOAT_LITERAL:
+        case AST_STRING_LITERAL:
+        case AST_BOOL_LITERAL:
+            closure = new_closure(node, run_constant, 0);
+            closure->constant = LITERAL_VALUE(node);
+            return closure;
+        case AST_VAR_REF:
+            if (node->depth == SCOPE_GLOBAL)
+                closure = new_closure(node, get_global, 0);
+            else
+                closure = new_closure(node, node->depth == 0 ? get_local : get_variable, 0);
+            closure->slot = node->slot;
+            return closure;
+        case AST_BINARY_OP:
+            if (has_children(node, 2))
+                return build_binary(node);
+            break;
+        case AST_LOGICAL_OP:
+            if (has_children(node, 2))
+            {
+                closure = new_closure(node, run_logical, 2);
+                closure->op = node->op;
+                closure->operands[0] = compile_expression_closure(node->children[0]);
+                closure->operands[1] = compile_expression_closure(node->children[1]);
+                return closure;
+            }
+            break;
+        case AST_UNARY_OP:
+            if (has_children(node, 1))
+            {
+                closure = new_closure(node, run_unary, 1);
+                closure->op = node->op;
+                closure->operands[0] = compile_expression_closure(node->children[0]);
+                return closure;
+            }
+            break;
+        case AST_FIELD_ACCESS:
+            if (has_children(node, 1))
+            {
+                closure = new_closure(node, get_member, 1);
+                closure->operands[0] = compile_expression_closure(node->children[0]);
+                return closure;
+            }
+            break;
+        case AST_INDEX_ACCESS:
+            if (has_children(node, 2))
+            {
+                closure = new_closure(node, get_element, 2);
+                if (node->children[0]->static_type == VAL_LIST && node->children[1]->static_type == VAL_INT)
+                {
+                    closure->fn = get_proven_list_element;
+                    closure->hits = QUICKEN_DONE;
+                }
+                closure->operands[0] = compile_expression_closure(node->children[0]);
+                closure->operands[1] = compile_expression_closure(node->children[1]);
+                return closure;
+            }
+            break;
+        case AST_FUNC_CALL:
+            if (has_children(node, node->children_count))
+                return build_call(node, 0);
+            break;
+        default:
+            break;
+    }
+    return new_closure(node, run_eval_node, 0);
+}
+
+ClosureNode *compile_expression_closure(ASTNode *node)
+{
+    if (!node->closure)
+        node->closure = build_expression(node);
+    return node->closure;
+}
+
+// --- Statements ---
+
+static Value run_block(ClosureNode *self, Env *env)
+{
+    for (int i = 0; i < self->operand_count; i++)
+    {
+        Value result = RUN(self->operands[i]);
+        if (result.type != VAL_VOID)
+            return result;
+    }
+    return (Value){VAL_VOID};
+}
+
+static Value run_expression_statement(ClosureNode *self, Env *env)
+{
+    RUN(self->operands[0]);
+    return (Value){VAL_VOID};
+}
+
+static Value set_local(ClosureNode *self, Env *env)
+{
+    env->slots[self->slot] = RUN(self->operands[0]);
+    return (Value){VAL_VOID};
+}
+
+static Value set_variable(ClosureNode *self, Env *env)
+{
+    env_assign(env, self->node->children[0], RUN(self->operands[0]));
+    return (Value){VAL_VOID};
+}
+
+static Value define_global_variable(ClosureNode *self, Env *env)
+{
+    global_define(self->slot, RUN(self->operands[0]));
+    return (Value){VAL_VOID};
+}
+
+static Value set_member(ClosureNode *self, Env *env)
+{
+    ASTNode *target = self->node->children[0];
+    Value value = RUN(self->operands[0]);
+    gc_push_value(value);
+    Value object = RUN(self->operands[1]);
+    set_field_cached(object, MEMBER_NAME(target), value, target->cache, target->line_num);
+    gc_pop_root();
+    return (Value){VAL_VOID};
+}
+
+static Value set_element(ClosureNode *self, Env *env)
+{
+    Value value = RUN(self->operands[0]);
+    gc_push_value(value);
+    Value collection = RUN(self->operands[1]);
+    gc_push_value(collection);
+    Value index = RUN(self->operands[2]);
+    set_index(collection, index, value, self->node->children[0]->line_num);
+    gc_pop_roots(2);
+    return (Value){VAL_VOID};
+}
+
+static Value run_if(ClosureNode *self, Env *env)
+{
+    if (RUN(self->operands[0]).int_val)
+        return RUN(self->operands[1]);
+    if (self->operand_count > 2)
+        return RUN(self->operands[2]);
+    return (Value){VAL_VOID};
+}
+
+/**
+ * @brief Runs a loop body in a new frame (see `ASTNode.frame_captured`). `node` is the loop.
+ */
+static Value run_iteration(ClosureNode *self, Env *env)
+{
+    Env *iteration = env_new(self->node->slot_count, env);
+    gc_push_root((ObjHeader *) iteration);
+    Value result = self->operands[0]->fn(self->operands[0], iteration);
+    gc_pop_root();
+    return result;
+}
+
+static Value run_while(ClosureNode *self, Env *env)
+{
+    while (RUN(self->operands[0]).int_val)
+    {
+        Value result = RUN(self->operands[1]);
+        if (result.type == VAL_BREAK)
+            break;
+        if (result.type == VAL_CONTINUE)
+            continue;
+        if (result.type != VAL_VOID)
+            return result;
+    }
+    return (Value){VAL_VOID};
+}
+
+static Value run_do_while(ClosureNode *self, Env *env)
+{
+    do
+    {
+        Value result = RUN(self->operands[0]);
+        if (result.type == VAL_BREAK)
+            break;
+        if (result.type == VAL_CONTINUE)
+            continue;
+        if (result.type != VAL_VOID)
+            return result;
+    }
+    while (RUN(self->operands[1]).int_val);
+    return (Value){VAL_VOID};
+}
+
+static Value run_for(ClosureNode *self, Env *env)
+{
+    // Operands: initializer, condition, increment, body.
+    RUN(self->operands[0]);
+    while (RUN(self->operands[1]).int_val)
+    {
+        Value result = RUN(self->operands[3]);
+        if (result.type == VAL_BREAK)
+            break;
+        if (result.type != VAL_VOID && result.type != VAL_CONTINUE)
+            return result;
+        RUN(self->operands[2]);
+    }
+    return (Value){VAL_VOID};
+}
+
+/**
+ * @brief Returns whether an int comparison holds.
+ */
+static int compare_ints(Operator op, int l, int r)
+{
+    switch (op)
+    {
+        case OPER_LESS:
+            return l < r;
+        case OPER_GREATER:
+            return l > r;
+        case OPER_LESS_EQUAL:
+            return l <= r;
+        case OPER_GREATER_EQUAL:
+            return l >= r;
+        case OPER_EQUAL:
+            return l == r;
+        default:
+            return l != r;
+    }
+}
+
+/*
+ * A counted loop, `for (i = start; i < limit; i = i + step)` with a constant step, keeps its
+ * counter as a C int while it is one. The condition and the increment are not run as closures:
+ * `op` holds the comparison, `constant` the signed step. Whenever the counter or the limit is
+ * not an int, that test or increment goes through the generic operators, so the loop does
+ * exactly what `run_for` would.
+ */
+#define COUNTED_FOR(name, READ, WRITE) \
+    static Value name(ClosureNode *self, Env *env) \
+    { \
+        /* Operands: initializer, limit, body. */ \
+        RUN(self->operands[0]); \
+        while (1) \
+        { \
+            /* The counter is read before the limit runs, as `counter < limit` reads it. */ \
+            Value counter = READ; \
+            Value limit = RUN(self->operands[1]); \
+            if (counter.type == VAL_INT && limit.type == VAL_INT) \
+            { \
+                if (!compare_ints(self->op, counter.int_val, limit.int_val)) \
+                    break; \
+            } \
+            else if (!eval_binary_op(self->op, counter, limit).int_val) \
+            { \
+                break; \
+            } \
+            Value result = RUN(self->operands[2]); \
+            if (result.type == VAL_BREAK) \
+                break; \
+            if (result.type != VAL_VOID && result.type != VAL_CONTINUE) \
+                return result; \
+            counter = READ; \
+            if (counter.type == VAL_INT) \
+                counter.int_val += self->constant.int_val; \
+            else \
+                counter = eval_binary_op(OPER_ADD, counter, self->constant); \
+            WRITE(counter); \
+        } \
+        return (Value){VAL_VOID}; \
+    }
+
+#define WRITE_LOCAL(value) (env->slots[self->slot] = (value))
+#define WRITE_GLOBAL(value) global_assign(self->slot, (value), self->node->line_num)
+
+COUNTED_FOR(run_counted_for_local, env->slots[self->slot], WRITE_LOCAL)
+COUNTED_FOR(run_counted_for_global, global_get(self->slot, self->node->line_num), WRITE_GLOBAL)
+
+#undef WRITE_LOCAL
+#undef WRITE_GLOBAL
+#undef COUNTED_FOR
+
+static Value run_switch(ClosureNode *self, Env *env)
+{
+    // Operands: subject, then the body of each clause. As in `exec_node`, a matched clause runs
+    // with every clause after it, and no match runs each default clause.
+    int clause = find_switch_clause(self->node->switch_table, RUN(self->operands[0]));
+    for (int i = clause ? clause : 1; i < self->operand_count; i++)
+    {
+        if (!clause && self->node->children[i]->type != AST_DEFAULT)
+            continue;
+        Value result = RUN(self->operands[i]);
+        if (result.type != VAL_VOID)
+            return result.type == VAL_BREAK ? (Value){VAL_VOID} : result;
+    }
+    return (Value){VAL_VOID};
+}
+
+static Value run_return(ClosureNode *self, Env *env)
+{
+    return RUN(self->operands[0]);
+}
+
+/**
+ * @brief Compiles an assignment, or returns NULL if its target has no specialisation.
+ */
+static ClosureNode *build_assignment(ASTNode *node)
+{
+    ASTNode *target = node->children[0];
+    ClosureNode *closure;
+    switch (target->type)
+    {
+        case AST_VAR_REF:
+            if (target->depth == 0)
+            {
+                closure = new_closure(node, set_local, 1);
+                closure->slot = target->slot;
+            }
+            else
+            {
+                closure = new_closure(node, set_variable, 1);
+            }
+            closure->operands[0] = compile_expression_closure(node->children[1]);
+            return closure;
+        case AST_FIELD_ACCESS:
+            if (!has_children(target, 1))
+                return NULL;
+            closure = new_closure(node, set_member, 2);
+            closure->operands[0] = compile_expression_closure(node->children[1]);
+            closure->operands[1] = compile_expression_closure(target->children[0]);
+            return closure;
+        case AST_INDEX_ACCESS:
+            if (!has_children(target, 2))
+                return NULL;
+            closure = new_closure(node, set_element, 3);
+            closure->operands[0] = compile_expression_closure(node->children[1]);
+            closure->operands[1] = compile_expression_closure(target->children[0]);
+            closure->operands[2] = compile_expression_closure(target->children[1]);
+            return closure;
+        default:
+            return NULL;
+    }
+}
+
+/**
+ * @brief Returns whether a node reads or declares the variable at (depth, slot), in this frame or
+ * the globals.
+ */
+static int is_variable(ASTNode *node, int depth, int slot)
+{
+    return node && (node->type == AST_VAR_REF || node->type == AST_VAR_DECL) && node->depth == depth &&
+           node->slot == slot && (depth == 0 || depth == SCOPE_GLOBAL);
+}
+
+/**
+ * @brief Compiles the body of a loop, run in a frame of its own if it defines closures.
+ */
+static ClosureNode *compile_loop_body(ASTNode *loop, ASTNode *body)
+{
+    if (!loop->frame_captured)
+        return compile_block_closure(body);
+    ClosureNode *closure = new_closure(loop, run_iteration, 1);
+    closure->operands[0] = compile_block_closure(body);
+    return closure;
+}
+
+/**
+ * @brief Compiles a counted `for` loop, or returns NULL if the loop does not have that shape.
+ *
+ * The initializer declares or assigns the counter, the condition compares the counter to any
+ * limit expression, and the increment is `counter = counter + constant` or `- constant`.
+ */
+static ClosureNode *build_counted_for(ASTNode *node)
+{
+    ASTNode *init = node->children[0];
+    ASTNode *condition = node->children[1];
+    ASTNode *increment = node->children[2];
+
+    ASTNode *counter = init->type == AST_ASSIGNMENT && init->children_count == 2 ? init->children[0] : init;
+    if (counter->type != AST_VAR_REF && counter->type != AST_VAR_DECL)
+        return NULL;
+    int depth = counter->depth;
+    int slot = counter->slot;
+    if (!is_variable(counter, depth, slot))
+        return NULL;
+
+    if (condition->type != AST_BINARY_OP || condition->children_count != 2 ||
+        condition->op < OPER_LESS || condition->op > OPER_NOT_EQUAL ||
+        !is_variable(condition->children[0], depth, slot) || !condition->children[1])
+        return NULL;
+
+    if (increment->type != AST_ASSIGNMENT || increment->children_count != 2 ||
+        !is_variable(increment->children[0], depth, slot))
+        return NULL;
+    ASTNode *step = increment->children[1];
+    if (step->type != AST_BINARY_OP || step->children_count != 2 ||
+        (step->op != OPER_ADD && step->op != OPER_SUBTRACT) || !is_variable(step->children[0], depth, slot) ||
+        !step->children[1] || step->children[1]->type != AST_INT_LITERAL)
+        return NULL;
+
+    ClosureNode *closure = new_closure(node, depth == SCOPE_GLOBAL ? run_counted_for_global : run_counted_for_local, 3);
+    closure->slot = slot;
+    closure->op = condition->op;
+    // Adding the negated step gives the same int, float or void as subtracting it.
+    closure->constant = LITERAL_VALUE(step->children[1]);
+    if (step->op == OPER_SUBTRACT)
+        closure->constant.int_val = -closure->constant.int_val;
+    closure->operands[0] = compile_statement_closure(init);
+    closure->operands[1] = compile_expression_closure(condition->children[1]);
+    closure->operands[2] = compile_loop_body(node, node->children[3]);
+    return closure;
+}
+
+/**
+ * @brief Compiles a variable declaration with a plain initializer, or returns NULL for the
+ * other forms (arrays, maps, `list<T>` checks, no initializer).
+ */
+static ClosureNode *build_var_decl(ASTNode *node)
+{
+    if (!has_children(node, 1) || node->children[0]->type == AST_ARRAY_SPECIFIER ||
+        (node->type_name && (strncmp(node->type_name, "map<", 4) == 0 || strncmp(node->type_name, "list<", 5) == 0)))
+        return NULL;
+    ClosureNode *closure = new_closure(node, node->depth == SCOPE_GLOBAL ? define_global_variable : set_local, 1);
+    closure->slot = node->slot;
+    closure->operands[0] = compile_expression_closure(node->children[0]);
+    return closure;
+}
+
+/**
+ * @brief Compiles a switch whose case labels are all literals, or returns NULL for the others.
+ */
+static ClosureNode *build_switch(ASTNode *node)
+{
+    if (!has_children(node, node->children_count))
+        return NULL;
+    for (int i = 1; i < node->children_count; i++)
+    {
+        ASTNode *clause = node->children[i];
+        int body = clause->type == AST_CASE ? 1 : 0;
+        if ((clause->type != AST_CASE && clause->type != AST_DEFAULT) || !has_children(clause, body + 1))
+            return NULL;
+    }
+    if (!get_switch_table(node))
+        return NULL;
+
+    ClosureNode *closure = new_closure(node, run_switch, node->children_count);
+    closure->operands[0] = compile_expression_closure(node->children[0]);
+    for (int i = 1; i < node->children_count; i++)
+    {
+        ASTNode *clause = node->children[i];
+        closure->operands[i] = compile_block_closure(clause->children[clause->type == AST_CASE ? 1 : 0]);
+    }
+    return closure;
+}
+
+static ClosureNode *build_statement(ASTNode *node)
+{
+    ClosureNode *closure = NULL;
+    switch (node->type)
+    {
+        case AST_ASSIGNMENT:
+            if (has_children(node, 2))
+                closure = build_assignment(node);
+            break;
+        case AST_VAR_DECL:
+            closure = build_var_decl(node);
+            break;
+        case AST_IF:
+            if (has_children(node, node->children_count) && node->children_count >= 2)
+            {
+                closure = new_closure(node, run_if, node->children_count > 2 ? 3 : 2);
+                closure->operands[0] = compile_expression_closure(node->children[0]);
+                closure->operands[1] = compile_block_closure(node->children[1]);
+                if (node->children_count > 2)
+                {
+                    ASTNode *else_node = node->children[2];
+                    closure->operands[2] = else_node->type == AST_IF ? compile_statement_closure(else_node)
+                                                                    : compile_block_closure(else_node);
+                }
+            }
+            break;
+        case AST_WHILE:
+            if (has_children(node, 2))
+            {
+                closure = new_closure(node, run_while, 2);
+                closure->operands[0] = compile_expression_closure(node->children[0]);
+                closure->operands[1] = compile_loop_body(node, node->children[1]);
+            }
+            break;
+        case AST_DO_WHILE:
+            if (has_children(node, 2))
+            {
+                closure = new_closure(node, run_do_while, 2);
+                closure->operands[0] = compile_loop_body(node, node->children[0]);
+                closure->operands[1] = compile_expression_closure(node->children[1]);
+            }
+            break;
+        case AST_FOR:
+            if (has_children(node, 4))
+                closure = build_counted_for(node);
+            if (has_children(node, 4) && !closure)
+            {
+                closure = new_closure(node, run_for, 4);
+                closure->operands[0] = compile_statement_closure(node->children[0]);
+                closure->operands[1] = compile_expression_closure(node->children[1]);
+                closure->operands[2] = compile_statement_closure(node->children[2]);
+                closure->operands[3] = compile_loop_body(node, node->children[3]);
+            }
+            break;
+        case AST_SWITCH:
+            closure = build_switch(node);
+            break;
+        case AST_RETURN:
+            if (node->tail_call && has_children(node->children[0], node->children[0]->children_count))
+            {
+                // The returned call is only ever run by this statement, so its closure is the tail form.
+                ASTNode *call = node->children[0];
+                if (!call->closure)
+                    call->closure = build_call(call, 1);
+                closure = new_closure(node, run_return, 1);
+                closure->operands[0] = call->closure;
+            }
+            else if (has_children(node, 1))
+            {
+                closure = new_closure(node, run_return, 1);
+                closure->operands[0] = compile_expression_closure(node->children[0]);
+            }
+            break;
+        case AST_CLASS_DEF:
+        case AST_FIELD_DECL:
+        case AST_FUNC_DEF:
+        case AST_PRINT:
+        case AST_FOREACH:
+        case AST_BREAK:
+        case AST_CONTINUE:
+        case AST_IMPORT:
+            break;
+        default:
+            // An expression used as a statement: its value is discarded. The expression's own
+            // closure is not shared with any other node, so this closure owns it.
+            closure = new_closure(node, run_expression_statement, 1);
+            closure->operands[0] = build_expression(node);
+            break;
+    }
+    return closure ? closure : new_closure(node, run_exec_node, 0);
+}
+
+ClosureNode *compile_statement_closure(ASTNode *node)
+{
+    if (!node->closure)
+        node->closure = build_statement(node);
+    return node->closure;
+}
+
+ClosureNode *compile_block_closure(ASTNode *block)
+{
+    if (block->closure)
+        return block->closure;
+
+    // Missing statements do nothing, so they are left out.
+    int count = 0;
+    for (int i = 0; i < block->children_count; i++)
+    {
+        if (block->children[i])
+            count++;
+    }
+    ClosureNode *closure = new_closure(block, run_block, count);
+    count = 0;
+    for (int i = 0; i < block->children_count; i++)
+    {
+        if (block->children[i])
+            closure->operands[count++] = compile_statement_closure(block->children[i]);
+    }
+    block->closure = closure;
+    return closure;
+}
+
+void free_closure(ClosureNode *closure)
+{
+    if (!closure)
+        return;
+    for (int i = 0; i < closure->operand_count; i++)
+    {
+        if (closure->operands[i]->node == closure->node)
+            free(closure->operands[i]);
+    }
+    free(closure);
+}
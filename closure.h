@@ -0,0 +1,82 @@
+/**
+ * @file closure.h
+ * @brief Header file for the Pith closure compiler.
+ *
+ * The tree-walker does not switch on the type of every node it runs. The first time a node is
+ * evaluated or executed, it is compiled into a ClosureNode: a small struct holding a function
+ * pointer specialised for the node's shape (a local read, `local + constant` on ints, a call with
+ * its arguments, a while loop...) together with the closures of its children. Running the node
+ * is then a single indirect call. Shapes without a specialisation compile to a closure that runs
+ * the node through the plain switch of `eval_node` or `exec_node`, whose children are compiled
+ * in turn when they first run.
+ *
+ * Binary operators, element reads and member reads also quicken: they start out generic and
+ * watch the types of their operands (or the class of their receiver). A node that keeps seeing
+ * the same ones rewrites its function pointer to a variant specialised for them, such as an
+ * int-int add or a read of one field slot. The variant checks a guard before its fast path;
+ * when the guard fails, the node goes back to its generic form for good.
+ *
+ * A closure belongs to the AST node it was compiled from (`ASTNode.closure`) and is freed with it.
+ */
+
+#ifndef PITH_CLOSURE_H
+#define PITH_CLOSURE_H
+
+#include "value.h"
+#include "parser.h"
+
+typedef struct ClosureNode ClosureNode;
+
+/**
+ * @brief Runs a compiled node.
+ * @param self The closure being run.
+ * @param env The current frame.
+ * @return The value of an expression, or the result of a statement (as returned by `exec`).
+ */
+typedef Value (*ClosureFn)(ClosureNode *self, Env *env);
+
+/**
+ * @brief A node compiled for the tree-walker.
+ */
+struct ClosureNode
+{
+    ClosureFn fn; // Runs the node
+    ASTNode *node; // The node it was compiled from
+    Value constant; // Constant operand of the shapes that have one
+    int slot; // Variable slot of the shapes that read or write one
+    Operator op; // Operator of operations, for their generic path
+    int guard; // What a quickening node specialises for: operand types or receiver class id
+    int hits; // Runs in a row that saw `guard`, or QUICKEN_DONE once the node stopped observing
+    int operand_count;
+    ClosureNode *operands[]; // Closures of the children, in the order they run
+};
+
+/**
+ * @brief Compiles a node evaluated as an expression (see `eval`).
+ * @param node The expression node.
+ * @return The node's closure, also stored in `node->closure`.
+ */
+ClosureNode *compile_expression_closure(ASTNode *node);
+
+/**
+ * @brief Compiles a node executed as a statement (see `exec`).
+ * @param node The statement node.
+ * @return The node's closure, also stored in `node->closure`.
+ */
+ClosureNode *compile_statement_closure(ASTNode *node);
+
+/**
+ * @brief Compiles a block executed by `exec_block`.
+ * @param block The AST_BLOCK node.
+ * @return The block's closure, also stored in `block->closure`.
+ */
+ClosureNode *compile_block_closure(ASTNode *block);
+
+/**
+ * @brief Frees a closure compiled from a node (called by `free_ast`).
+ *
+ * The closures of the node's children belong to the children and are not freed.
+ */
+void free_closure(ClosureNode *closure);
+
+#endif //PITH_CLOSURE_H
@@ -0,0 +1,1038 @@
+/**
+ * @file compiler.c
+ * @brief Implementation of the Pith bytecode compiler.
+ *
+ * This file translates the AST produced by the parser into compact bytecode for the stack VM.
+ * Expressions are compiled to postfix stack code and control flow to forward/backward jumps.
+ * Variables use the (depth, slot) addresses assigned by the resolver, so the AST must have
+ * been through `resolve_program` (or `resolve_module`) first.
+ * Rare, definition-style statements (classes, functions, imports, array and map declarations)
+ * are delegated to the tree-walker through OP_EXEC_STMT, so both engines share one runtime.
+ */
+
+#include "compiler.h"
+#include "interpreter.h"
+#include "constants.h"
+#include "switch_table.h"
+#include "debug.h"
+#include "common.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_U16 65535
+
+/**
+ * @brief Book-keeping for a construct that `break` (and possibly `continue`) can target.
+ */
+typedef struct BreakContext
+{
+    struct BreakContext *enclosing;
+    int is_switch; // Switches accept 'break' but pass 'continue' through to the enclosing loop
+    int hidden_slots; // Stack slots owned by the construct (switch subject, foreach list/index)
+    int continue_target; // Backward continue target, or -1 if continue jumps are patched forward
+    int iteration_frame; // Each iteration runs in its own frame, which 'break' and 'continue' must leave
+    int *break_jumps;
+    int break_count;
+    int *continue_jumps;
+    int continue_count;
+} BreakContext;
+
+/**
+ * @brief State of the compiler while emitting one chunk.
+ */
+typedef struct
+{
+    Chunk *chunk;
+    BreakContext *context;
+} Compiler;
+
+// --- Forward Declarations ---
+static void compile_expression(Compiler *compiler, ASTNode *node);
+
+static void compile_statement(Compiler *compiler, ASTNode *node);
+
+// --- Chunk Management ---
+
+static Chunk *new_chunk()
+{
+    Chunk *chunk = calloc(1, sizeof(Chunk));
+    if (!chunk)
+    {
+        fprintf(stderr, "Fatal: Memory allocation failed for bytecode chunk.\n");
+        exit(1);
+    }
+    return chunk;
+}
+
+void free_chunk(Chunk *chunk)
+{
+    if (!chunk)
+        return;
+    free(chunk->code);
+    free(chunk->lines);
+    free(chunk->constants);
+    free(chunk->nodes);
+    free(chunk);
+}
+
+static void emit_byte(Compiler *compiler, uint8_t byte, int line)
+{
+    Chunk *chunk = compiler->chunk;
+    if (chunk->count >= chunk->capacity)
+    {
+        chunk->capacity = chunk->capacity == 0 ? 64 : chunk->capacity * 2;
+        chunk->code = realloc(chunk->code, chunk->capacity * sizeof(uint8_t));
+        chunk->lines = realloc(chunk->lines, chunk->capacity * sizeof(int));
+        if (!chunk->code || !chunk->lines)
+        {
+            fprintf(stderr, "Fatal: Memory allocation failed for bytecode.\n");
+            exit(1);
+        }
+    }
+    chunk->code[chunk->count] = byte;
+    chunk->lines[chunk->count] = line;
+    chunk->count++;
+}
+
+static void emit_u16(Compiler *compiler, int value, int line)
+{
+    emit_byte(compiler, (uint8_t) ((value >> 8) & 0xff), line);
+    emit_byte(compiler, (uint8_t) (value & 0xff), line);
+}
+
+static void emit_op_u16(Compiler *compiler, OpCode op, int operand, int line)
+{
+    emit_byte(compiler, op, line);
+    emit_u16(compiler, operand, line);
+}
+
+static int add_constant(Compiler *compiler, Value value, int line)
+{
+    Chunk *chunk = compiler->chunk;
+    if (chunk->constant_count >= MAX_U16)
+    {
+        report_error(line, "Too many constants in one function.");
+    }
+    if (chunk->constant_count >= chunk->constant_capacity)
+    {
+        chunk->constant_capacity = chunk->constant_capacity == 0 ? 16 : chunk->constant_capacity * 2;
+        chunk->constants = realloc(chunk->constants, chunk->constant_capacity * sizeof(Value));
+        if (!chunk->constants)
+        {
+            fprintf(stderr, "Fatal: Memory allocation failed for constant pool.\n");
+            exit(1);
+        }
+    }
+    chunk->constants[chunk->constant_count] = value;
+    return chunk->constant_count++;
+}
+
+static int add_node(Compiler *compiler, ASTNode *node)
+{
+    Chunk *chunk = compiler->chunk;
+    if (chunk->node_count >= MAX_U16)
+    {
+        report_error(node->line_num, "Too many delegated statements in one function.");
+    }
+    if (chunk->node_count >= chunk->node_capacity)
+    {
+        chunk->node_capacity = chunk->node_capacity == 0 ? 8 : chunk->node_capacity * 2;
+        chunk->nodes = realloc(chunk->nodes, chunk->node_capacity * sizeof(ASTNode *));
+        if (!chunk->nodes)
+        {
+            fprintf(stderr, "Fatal: Memory allocation failed for chunk nodes.\n");
+            exit(1);
+        }
+    }
+    chunk->nodes[chunk->node_count] = node;
+    return chunk->node_count++;
+}
+
+static void emit_void(Compiler *compiler, int line)
+{
+    emit_op_u16(compiler, OP_CONSTANT, add_constant(compiler, (Value){VAL_VOID}, line), line);
+}
+
+/**
+ * @brief Emits a forward jump with a placeholder offset.
+ * @return The position of the operand, to be passed to `patch_jump`.
+ */
+static int emit_jump(Compiler *compiler, OpCode op, int line)
+{
+    emit_byte(compiler, op, line);
+    emit_u16(compiler, 0xffff, line);
+    return compiler->chunk->count - 2;
+}
+
+static void patch_jump(Compiler *compiler, int operand_pos)
+{
+    int jump = compiler->chunk->count - operand_pos - 2;
+    if (jump > MAX_U16)
+    {
+        report_error(compiler->chunk->lines[operand_pos], "Too much code to jump over.");
+    }
+    compiler->chunk->code[operand_pos] = (uint8_t) ((jump >> 8) & 0xff);
+    compiler->chunk->code[operand_pos + 1] = (uint8_t) (jump & 0xff);
+}
+
+static void emit_loop(Compiler *compiler, int loop_start, int line)
+{
+    emit_byte(compiler, OP_LOOP, line);
+    int offset = compiler->chunk->count - loop_start + 2;
+    if (offset > MAX_U16)
+    {
+        report_error(line, "Loop body too large.");
+    }
+    emit_u16(compiler, offset, line);
+}
+
+// --- Break Contexts ---
+
+static void push_context(Compiler *compiler, BreakContext *context, int is_switch, int hidden_slots)
+{
+    memset(context, 0, sizeof(BreakContext));
+    context->enclosing = compiler->context;
+    context->is_switch = is_switch;
+    context->hidden_slots = hidden_slots;
+    context->continue_target = -1;
+    compiler->context = context;
+}
+
+static void add_jump(int **jumps, int *count, int operand_pos)
+{
+    *jumps = realloc(*jumps, (*count + 1) * sizeof(int));
+    if (!*jumps)
+    {
+        fprintf(stderr, "Fatal: Memory allocation failed for jump list.\n");
+        exit(1);
+    }
+    (*jumps)[(*count)++] = operand_pos;
+}
+
+static void patch_jump_list(Compiler *compiler, int *jumps, int count)
+{
+    for (int i = 0; i < count; i++)
+        patch_jump(compiler, jumps[i]);
+}
+
+/**
+ * @brief Closes a break context, patching all pending 'break' jumps to the current position.
+ */
+static void pop_context(Compiler *compiler)
+{
+    BreakContext *context = compiler->context;
+    patch_jump_list(compiler, context->break_jumps, context->break_count);
+    free(context->break_jumps);
+    free(context->continue_jumps);
+    compiler->context = context->enclosing;
+}
+
+static void compile_break(Compiler *compiler, ASTNode *node)
+{
+    BreakContext *context = compiler->context;
+    if (!context)
+    {
+        report_error(node->line_num, "'break' used outside of a loop or switch.");
+        return;
+    }
+    if (context->iteration_frame)
+        emit_byte(compiler, OP_LEAVE_FRAME, node->line_num);
+    add_jump(&context->break_jumps, &context->break_count, emit_jump(compiler, OP_JUMP, node->line_num));
+}
+
+static void compile_continue(Compiler *compiler, ASTNode *node)
+{
+    BreakContext *context = compiler->context;
+    // Continue passes through any enclosing switches, dropping their subjects.
+    while (context && context->is_switch)
+    {
+        for (int i = 0; i < context->hidden_slots; i++)
+            emit_byte(compiler, OP_POP, node->line_num);
+        context = context->enclosing;
+    }
+    if (!context)
+    {
+        report_error(node->line_num, "'continue' used outside of a loop.");
+        return;
+    }
+    if (context->iteration_frame)
+        emit_byte(compiler, OP_LEAVE_FRAME, node->line_num);
+    if (context->continue_target >= 0)
+    {
+        emit_loop(compiler, context->continue_target, node->line_num);
+    }
+    else
+    {
+        add_jump(&context->continue_jumps, &context->continue_count,
+                 emit_jump(compiler, OP_JUMP, node->line_num));
+    }
+}
+
+// --- Variables ---
+
+/**
+ * @brief Emits a read (`local_op` = OP_GET_LOCAL) or write (OP_SET_LOCAL) of a resolved variable.
+ */
+static void emit_variable(Compiler *compiler, OpCode local_op, ASTNode *node, int line)
+{
+    int is_get = local_op == OP_GET_LOCAL;
+    if (node->depth == SCOPE_GLOBAL)
+    {
+        emit_op_u16(compiler, is_get ? OP_GET_GLOBAL : OP_SET_GLOBAL, node->slot, line);
+    }
+    else if (node->depth == 0)
+    {
+        emit_op_u16(compiler, local_op, node->slot, line);
+    }
+    else
+    {
+        if (node->depth > 255)
+        {
+            report_error(line, "Functions are nested too deeply.");
+        }
+        emit_byte(compiler, is_get ? OP_GET_ENCLOSING : OP_SET_ENCLOSING, line);
+        emit_byte(compiler, (uint8_t) node->depth, line);
+        emit_u16(compiler, node->slot, line);
+    }
+}
+
+/**
+ * @brief Emits the store that completes a declaration (the value is on top of the stack).
+ */
+static void emit_declaration(Compiler *compiler, ASTNode *decl, int line)
+{
+    if (decl->depth == SCOPE_GLOBAL)
+        emit_op_u16(compiler, OP_DEFINE_GLOBAL, decl->slot, line);
+    else
+        emit_op_u16(compiler, OP_SET_LOCAL, decl->slot, line);
+}
+
+// --- Expressions ---
+
+static OpCode binary_opcode(Operator op)
+{
+    switch (op)
+    {
+        case OPER_ADD:
+            return OP_ADD;
+        case OPER_SUBTRACT:
+            return OP_SUBTRACT;
+        case OPER_MULTIPLY:
+            return OP_MULTIPLY;
+        case OPER_DIVIDE:
+            return OP_DIVIDE;
+        case OPER_MODULO:
+            return OP_MODULO;
+        case OPER_POWER:
+            return OP_POWER;
+        case OPER_LESS:
+            return OP_LESS;
+        case OPER_GREATER:
+            return OP_GREATER;
+        case OPER_LESS_EQUAL:
+            return OP_LESS_EQUAL;
+        case OPER_GREATER_EQUAL:
+            return OP_GREATER_EQUAL;
+        case OPER_EQUAL:
+            return OP_EQUAL;
+        case OPER_NOT_EQUAL:
+            return OP_NOT_EQUAL;
+        case OPER_AND:
+            return OP_AND;
+        default:
+            return OP_OR;
+    }
+}
+
+static void compile_arguments(Compiler *compiler, ASTNode *call, int first)
+{
+    int arg_count = call->children_count - first;
+    if (arg_count > 255)
+    {
+        report_error(call->line_num, "Cannot pass more than 255 arguments.");
+    }
+    for (int i = first; i < call->children_count; i++)
+        compile_expression(compiler, call->children[i]);
+}
+
+/**
+ * @brief Compiles an AST_FUNC_CALL node.
+ * @param is_tail_call Whether the call is returned by a `return` marked by the resolver.
+ */
+static void compile_call(Compiler *compiler, ASTNode *node, int is_tail_call)
+{
+    int line = node->line_num;
+    ASTNode *callee = node->children[0];
+    if (callee->type == AST_FIELD_ACCESS)
+    {
+        // Leave the receiver under the arguments and call the member directly.
+        compile_expression(compiler, callee->children[0]);
+        compile_arguments(compiler, node, 1);
+        emit_op_u16(compiler, is_tail_call ? OP_TAIL_INVOKE : OP_INVOKE, add_node(compiler, callee), line);
+    }
+    else
+    {
+        compile_expression(compiler, callee);
+        compile_arguments(compiler, node, 1);
+        emit_byte(compiler, is_tail_call ? OP_TAIL_CALL : OP_CALL, line);
+    }
+    emit_byte(compiler, (uint8_t) (node->children_count - 1), line);
+}
+
+static void compile_expression(Compiler *compiler, ASTNode *node)
+{
+    if (!node)
+    {
+        emit_void(compiler, 0);
+        return;
+    }
+
+    int line = node->line_num;
+    switch (node->type)
+    {
+        case AST_INT_LITERAL:
+        case AST_FLOAT_LITERAL:
+        case AST_STRING_LITERAL:
+        case AST_BOOL_LITERAL:
+            // Decoded by the parser; string constants are shared, never copied.
+            emit_op_u16(compiler, OP_CONSTANT, add_constant(compiler, LITERAL_VALUE(node), line), line);
+            break;
+        case AST_LIST_LITERAL:
+            for (int i = 0; i < node->children_count; i++)
+                compile_expression(compiler, node->children[i]);
+            emit_op_u16(compiler, OP_BUILD_LIST, node->children_count, line);
+            break;
+        case AST_HASHMAP_LITERAL:
+            for (int i = 0; i < node->children_count; i++)
+                compile_expression(compiler, node->children[i]);
+            emit_op_u16(compiler, OP_BUILD_MAP, node->children_count / 2, line);
+            break;
+        case AST_VAR_REF:
+            emit_variable(compiler, OP_GET_LOCAL, node, line);
+            break;
+        case AST_UNARY_OP:
+            compile_expression(compiler, node->children[0]);
+            emit_byte(compiler, node->op == OPER_NEGATE ? OP_NEGATE : OP_NOT, line);
+            break;
+        case AST_BINARY_OP:
+        {
+            ASTNode *parts[MAX_CONCAT_OPERANDS];
+            int part_count = concat_operands(node, parts);
+            if (part_count > 0)
+            {
+                for (int i = 0; i < part_count; i++)
+                    compile_expression(compiler, parts[i]);
+                emit_byte(compiler, OP_CONCAT, line);
+                emit_byte(compiler, (uint8_t) part_count, line);
+                break;
+            }
+            compile_expression(compiler, node->children[0]);
+            compile_expression(compiler, node->children[1]);
+            emit_byte(compiler, binary_opcode(node->op), line);
+            break;
+        }
+        case AST_LOGICAL_OP:
+        {
+            // The left operand stays on the stack as the result when it decides the outcome.
+            compile_expression(compiler, node->children[0]);
+            int end_jump = emit_jump(compiler, node->op == OPER_AND ? OP_AND_JUMP : OP_OR_JUMP, line);
+            compile_expression(compiler, node->children[1]);
+            emit_byte(compiler, binary_opcode(node->op), line);
+            patch_jump(compiler, end_jump);
+            break;
+        }
+        case AST_NEW_EXPR:
+        {
+            ASTNode *call_node = node->children[0];
+            compile_expression(compiler, call_node->children[0]);
+            compile_arguments(compiler, call_node, 1);
+            emit_byte(compiler, OP_NEW, line);
+            emit_byte(compiler, (uint8_t) (call_node->children_count - 1), line);
+            break;
+        }
+        case AST_FIELD_ACCESS:
+            compile_expression(compiler, node->children[0]);
+            emit_op_u16(compiler, OP_GET_FIELD, add_node(compiler, node), line);
+            break;
+        case AST_INDEX_ACCESS:
+            compile_expression(compiler, node->children[0]);
+            compile_expression(compiler, node->children[1]);
+            emit_byte(compiler, OP_GET_INDEX, line);
+            break;
+        case AST_FUNC_CALL:
+            compile_call(compiler, node, 0);
+            break;
+        default:
+            // Matches eval(): anything else evaluates to void.
+            emit_void(compiler, line);
+            break;
+    }
+}
+
+// --- Statements ---
+
+/**
+ * @brief Compiles the statements of a block.
+ */
+static void compile_block(Compiler *compiler, ASTNode *block)
+{
+    for (int i = 0; i < block->children_count; i++)
+        compile_statement(compiler, block->children[i]);
+}
+
+/**
+ * @brief Opens the frame of one loop iteration, if the resolver gave the loop one.
+ *
+ * The resolver does so when the body defines closures, so that each iteration's variables are
+ * captured separately. Must follow push_context so 'break' and 'continue' leave the frame too.
+ */
+static void enter_iteration(Compiler *compiler, ASTNode *loop)
+{
+    if (!loop->frame_captured)
+        return;
+    emit_op_u16(compiler, OP_ENTER_FRAME, loop->slot_count, loop->line_num);
+    compiler->context->iteration_frame = 1;
+}
+
+static void leave_iteration(Compiler *compiler, ASTNode *loop)
+{
+    if (loop->frame_captured)
+        emit_byte(compiler, OP_LEAVE_FRAME, loop->line_num);
+}
+
+static void compile_if(Compiler *compiler, ASTNode *node)
+{
+    compile_expression(compiler, node->children[0]);
+    int else_jump = emit_jump(compiler, OP_JUMP_IF_FALSE, node->line_num);
+    compile_block(compiler, node->children[1]);
+
+    if (node->children_count > 2)
+    {
+        int end_jump = emit_jump(compiler, OP_JUMP, node->line_num);
+        patch_jump(compiler, else_jump);
+        ASTNode *else_node = node->children[2];
+        if (else_node->type == AST_IF)
+            compile_if(compiler, else_node);
+        else
+            compile_block(compiler, else_node);
+        patch_jump(compiler, end_jump);
+    }
+    else
+    {
+        patch_jump(compiler, else_jump);
+    }
+}
+
+static void compile_while(Compiler *compiler, ASTNode *node)
+{
+    BreakContext context;
+    int loop_start = compiler->chunk->count;
+    compile_expression(compiler, node->children[0]);
+    int exit_jump = emit_jump(compiler, OP_JUMP_IF_FALSE, node->line_num);
+
+    push_context(compiler, &context, 0, 0);
+    context.continue_target = loop_start;
+    enter_iteration(compiler, node);
+    compile_block(compiler, node->children[1]);
+    leave_iteration(compiler, node);
+    emit_loop(compiler, loop_start, node->line_num);
+
+    patch_jump(compiler, exit_jump);
+    pop_context(compiler);
+}
+
+static void compile_do_while(Compiler *compiler, ASTNode *node)
+{
+    BreakContext context;
+    int loop_start = compiler->chunk->count;
+
+    push_context(compiler, &context, 0, 0);
+    enter_iteration(compiler, node);
+    compile_block(compiler, node->children[0]);
+    leave_iteration(compiler, node);
+
+    // 'continue' in a do-while re-checks the condition.
+    patch_jump_list(compiler, context.continue_jumps, context.continue_count);
+    if (node->children_count > 1)
+    {
+        compile_expression(compiler, node->children[1]);
+        int exit_jump = emit_jump(compiler, OP_JUMP_IF_FALSE, node->line_num);
+        emit_loop(compiler, loop_start, node->line_num);
+        patch_jump(compiler, exit_jump);
+    }
+    pop_context(compiler);
+}
+
+static void compile_for(Compiler *compiler, ASTNode *node)
+{
+    BreakContext context;
+    compile_statement(compiler, node->children[0]);
+
+    int loop_start = compiler->chunk->count;
+    compile_expression(compiler, node->children[1]);
+    int exit_jump = emit_jump(compiler, OP_JUMP_IF_FALSE, node->line_num);
+
+    push_context(compiler, &context, 0, 0);
+    enter_iteration(compiler, node);
+    compile_block(compiler, node->children[3]);
+    leave_iteration(compiler, node);
+
+    patch_jump_list(compiler, context.continue_jumps, context.continue_count);
+    compile_statement(compiler, node->children[2]);
+    emit_loop(compiler, loop_start, node->line_num);
+
+    patch_jump(compiler, exit_jump);
+    pop_context(compiler);
+}
+
+static void compile_foreach(Compiler *compiler, ASTNode *node)
+{
+    BreakContext context;
+    int line = node->line_num;
+
+    // Hidden loop state: [list, index]
+    compile_expression(compiler, node->children[0]);
+    Value zero;
+    zero.type = VAL_INT;
+    zero.int_val = 0;
+    emit_op_u16(compiler, OP_CONSTANT, add_constant(compiler, zero, line), line);
+
+    int loop_start = compiler->chunk->count;
+    int exit_jump = emit_jump(compiler, OP_FOREACH_NEXT, line);
+
+    push_context(compiler, &context, 0, 2);
+    context.continue_target = loop_start;
+
+    enter_iteration(compiler, node);
+    emit_declaration(compiler, node, line);
+    compile_block(compiler, node->children[1]);
+    leave_iteration(compiler, node);
+    emit_loop(compiler, loop_start, line);
+
+    patch_jump(compiler, exit_jump);
+    pop_context(compiler);
+    emit_byte(compiler, OP_POP, line);
+    emit_byte(compiler, OP_POP, line);
+}
+
+/**
+ * @brief Checks that the first `count` children of a node exist, so they can be compiled.
+ */
+static int has_children(ASTNode *node, int count)
+{
+    if (node->children_count < count)
+        return 0;
+    for (int i = 0; i < count; i++)
+    {
+        if (!node->children[i])
+            return 0;
+    }
+    return 1;
+}
+
+/**
+ * @brief Compiles a loop. A malformed loop, missing some of its parts, is left to the tree-walker,
+ * which reports the first error it runs into.
+ */
+static void compile_loop(Compiler *compiler, ASTNode *node)
+{
+    switch (node->type)
+    {
+        case AST_WHILE:
+            if (has_children(node, 2))
+            {
+                compile_while(compiler, node);
+                return;
+            }
+            break;
+        case AST_DO_WHILE:
+            if (has_children(node, 1))
+            {
+                compile_do_while(compiler, node);
+                return;
+            }
+            break;
+        case AST_FOR:
+            if (has_children(node, 4))
+            {
+                compile_for(compiler, node);
+                return;
+            }
+            break;
+        default:
+            if (has_children(node, 2))
+            {
+                compile_foreach(compiler, node);
+                return;
+            }
+            break;
+    }
+    emit_op_u16(compiler, OP_EXEC_STMT, add_node(compiler, node), node->line_num);
+}
+
+/**
+ * @brief Points entry `entry` of a switch's offset table at the current position.
+ */
+static void patch_switch_entry(Compiler *compiler, int table, int entry_count, int entry)
+{
+    int jump = compiler->chunk->count - (table + 2 * entry_count);
+    if (jump > MAX_U16)
+    {
+        report_error(compiler->chunk->lines[table], "Too much code to jump over.");
+    }
+    compiler->chunk->code[table + 2 * entry] = (uint8_t) ((jump >> 8) & 0xff);
+    compiler->chunk->code[table + 2 * entry + 1] = (uint8_t) (jump & 0xff);
+}
+
+/**
+ * @brief Compiles a switch statement.
+ *
+ * Bodies are laid out in source order so execution falls through until a 'break'. When every
+ * case label is a literal, OP_SWITCH_TABLE looks the subject up and jumps straight to its body
+ * (see switch_table.h); otherwise all case tests run first, each jumping to its body. As in the
+ * tree-walker, an unmatched subject runs only the default body, so that path gets its own copy
+ * placed after the fall-through chain.
+ */
+static void compile_switch(Compiler *compiler, ASTNode *node)
+{
+    BreakContext context;
+    int line = node->line_num;
+    int clause_count = node->children_count - 1;
+    int *body_jumps = malloc((clause_count > 0 ? clause_count : 1) * sizeof(int));
+    ASTNode *default_node = NULL;
+    int table = -1;
+    int no_match_jump = -1;
+
+    compile_expression(compiler, node->children[0]);
+
+    if (get_switch_table(node))
+    {
+        // Entry 0 is taken when nothing matches, entry i + 1 when clause i does.
+        emit_op_u16(compiler, OP_SWITCH_TABLE, add_node(compiler, node), line);
+        table = compiler->chunk->count;
+        for (int i = 0; i <= clause_count; i++)
+            emit_u16(compiler, 0, line);
+    }
+
+    for (int i = 0; i < clause_count; i++)
+    {
+        ASTNode *clause = node->children[i + 1];
+        body_jumps[i] = -1;
+        if (clause->type == AST_CASE && table < 0)
+        {
+            compile_expression(compiler, clause->children[0]);
+            emit_byte(compiler, OP_SWITCH_MATCH, clause->line_num);
+            int next_test = emit_jump(compiler, OP_JUMP_IF_FALSE, clause->line_num);
+            body_jumps[i] = emit_jump(compiler, OP_JUMP, clause->line_num);
+            patch_jump(compiler, next_test);
+        }
+        else if (clause->type == AST_DEFAULT && !default_node)
+        {
+            default_node = clause;
+        }
+    }
+    if (table < 0)
+        no_match_jump = emit_jump(compiler, OP_JUMP, line);
+
+    push_context(compiler, &context, 1, 1);
+    for (int i = 0; i < clause_count; i++)
+    {
+        ASTNode *clause = node->children[i + 1];
+        if (clause->type == AST_CASE)
+        {
+            if (table >= 0)
+                patch_switch_entry(compiler, table, clause_count + 1, i + 1);
+            else
+                patch_jump(compiler, body_jumps[i]);
+            if (clause->children_count > 1)
+                compile_block(compiler, clause->children[1]);
+        }
+        else if (clause->type == AST_DEFAULT && clause->children_count > 0)
+        {
+            compile_block(compiler, clause->children[0]);
+        }
+    }
+
+    int end_jump = default_node ? emit_jump(compiler, OP_JUMP, line) : -1;
+    if (table >= 0)
+    {
+        patch_switch_entry(compiler, table, clause_count + 1, 0);
+        for (int i = 0; i < clause_count; i++)
+        {
+            if (node->children[i + 1]->type != AST_CASE)
+                patch_switch_entry(compiler, table, clause_count + 1, i + 1);
+        }
+    }
+    else
+    {
+        patch_jump(compiler, no_match_jump);
+    }
+    if (default_node)
+    {
+        // The tree-walker runs every default label when nothing matched.
+        for (int i = 0; i < clause_count; i++)
+        {
+            ASTNode *clause = node->children[i + 1];
+            if (clause->type == AST_DEFAULT && clause->children_count > 0)
+                compile_block(compiler, clause->children[0]);
+        }
+        patch_jump(compiler, end_jump);
+    }
+    pop_context(compiler);
+    emit_byte(compiler, OP_POP, line);
+    free(body_jumps);
+}
+
+static void compile_var_decl(Compiler *compiler, ASTNode *node)
+{
+    int line = node->line_num;
+    int is_array = node->children_count > 0 && node->children[0]->type == AST_ARRAY_SPECIFIER;
+    if (is_array || strncmp(node->type_name, "map<", 4) == 0)
+    {
+        // Typed container declarations are rare; reuse the walker's implementation.
+        emit_op_u16(compiler, OP_EXEC_STMT, add_node(compiler, node), line);
+        return;
+    }
+
+    if (node->children_count > 0)
+        compile_expression(compiler, node->children[0]);
+    else
+        emit_void(compiler, line);
+
+    if (strncmp(node->type_name, "list<", 5) == 0)
+        emit_op_u16(compiler, OP_DECLARE_LIST, add_node(compiler, node), line);
+    emit_declaration(compiler, node, line);
+}
+
+static void compile_assignment(Compiler *compiler, ASTNode *node)
+{
+    ASTNode *target = node->children[0];
+    int line = target->line_num;
+
+    compile_expression(compiler, node->children[1]);
+    if (target->type == AST_VAR_REF)
+    {
+        emit_variable(compiler, OP_SET_LOCAL, target, line);
+    }
+    else if (target->type == AST_FIELD_ACCESS)
+    {
+        compile_expression(compiler, target->children[0]);
+        emit_op_u16(compiler, OP_SET_FIELD, add_node(compiler, target), line);
+    }
+    else if (target->type == AST_INDEX_ACCESS)
+    {
+        compile_expression(compiler, target->children[0]);
+        compile_expression(compiler, target->children[1]);
+        emit_byte(compiler, OP_SET_INDEX, line);
+    }
+    else
+    {
+        emit_byte(compiler, OP_POP, line);
+    }
+}
+
+static void compile_statement(Compiler *compiler, ASTNode *node)
+{
+    if (!node)
+        return;
+
+    int line = node->line_num;
+    switch (node->type)
+    {
+        case AST_CLASS_DEF:
+        case AST_FUNC_DEF:
+        case AST_IMPORT:
+            emit_op_u16(compiler, OP_EXEC_STMT, add_node(compiler, node), line);
+            break;
+        case AST_FIELD_DECL:
+        case AST_BLOCK:
+            // Field declarations only matter inside class definitions; a bare block is 'pass'.
+            break;
+        case AST_PRINT:
+            if (node->children_count > 255)
+            {
+                report_error(line, "Cannot print more than 255 values at once.");
+            }
+            for (int i = 0; i < node->children_count; i++)
+                compile_expression(compiler, node->children[i]);
+            emit_byte(compiler, OP_PRINT, line);
+            emit_byte(compiler, (uint8_t) node->children_count, line);
+            break;
+        case AST_VAR_DECL:
+            compile_var_decl(compiler, node);
+            break;
+        case AST_ASSIGNMENT:
+            compile_assignment(compiler, node);
+            break;
+        case AST_IF:
+            compile_if(compiler, node);
+            break;
+        case AST_WHILE:
+        case AST_DO_WHILE:
+        case AST_FOR:
+        case AST_FOREACH:
+            compile_loop(compiler, node);
+            break;
+        case AST_SWITCH:
+            compile_switch(compiler, node);
+            break;
+        case AST_BREAK:
+            compile_break(compiler, node);
+            break;
+        case AST_CONTINUE:
+            compile_continue(compiler, node);
+            break;
+        case AST_RETURN:
+            if (node->tail_call)
+            {
+                // The tail call instructions return by themselves.
+                compile_call(compiler, node->children[0], 1);
+                break;
+            }
+            compile_expression(compiler, node->children_count > 0 ? node->children[0] : NULL);
+            emit_byte(compiler, OP_RETURN, line);
+            break;
+        default:
+            // Expression statement
+            compile_expression(compiler, node);
+            emit_byte(compiler, OP_POP, line);
+            break;
+    }
+}
+
+// --- Entry Points ---
+
+static Chunk *compile_statements(ASTNode *container, const char *name)
+{
+    Compiler compiler;
+    compiler.chunk = new_chunk();
+    compiler.context = NULL;
+
+    for (int i = 0; i < container->children_count; i++)
+        compile_statement(&compiler, container->children[i]);
+    emit_void(&compiler, container->line_num);
+    emit_byte(&compiler, OP_RETURN, container->line_num);
+
+#ifdef DEBUG_PRINT_BYTECODE
+    disassemble_chunk(compiler.chunk, name);
+#else
+    (void) name;
+#endif
+    return compiler.chunk;
+}
+
+Chunk *compile_program(ASTNode *root)
+{
+    return compile_statements(root, "<script>");
+}
+
+Chunk *compile_function(ASTNode *func_def)
+{
+    return compile_statements(func_def->children[0], func_def->value);
+}
+
+// --- Disassembler ---
+
+static const char *opcode_names[] = {
+    "OP_CONSTANT", "OP_POP", "OP_GET_LOCAL", "OP_SET_LOCAL", "OP_GET_ENCLOSING", "OP_SET_ENCLOSING",
+    "OP_GET_GLOBAL", "OP_SET_GLOBAL", "OP_DEFINE_GLOBAL", "OP_GET_FIELD", "OP_SET_FIELD", "OP_GET_INDEX",
+    "OP_SET_INDEX", "OP_ADD", "OP_SUBTRACT", "OP_MULTIPLY", "OP_DIVIDE", "OP_MODULO", "OP_POWER", "OP_LESS",
+    "OP_GREATER", "OP_LESS_EQUAL", "OP_GREATER_EQUAL", "OP_EQUAL", "OP_NOT_EQUAL", "OP_AND", "OP_OR",
+    "OP_CONCAT", "OP_NEGATE", "OP_NOT", "OP_BUILD_LIST", "OP_BUILD_MAP", "OP_CALL", "OP_INVOKE",
+    "OP_TAIL_CALL", "OP_TAIL_INVOKE", "OP_NEW", "OP_PRINT", "OP_JUMP",
+    "OP_JUMP_IF_FALSE", "OP_AND_JUMP", "OP_OR_JUMP", "OP_LOOP", "OP_FOREACH_NEXT", "OP_ENTER_FRAME",
+    "OP_LEAVE_FRAME", "OP_SWITCH_MATCH",
+    "OP_SWITCH_TABLE", "OP_DECLARE_LIST", "OP_EXEC_STMT", "OP_RETURN"
+};
+
+int disassemble_instruction(Chunk *chunk, int offset)
+{
+    uint8_t op = chunk->code[offset];
+    printf("%04d %4d %-18s", offset, chunk->lines[offset], opcode_names[op]);
+    switch (op)
+    {
+        case OP_CONSTANT:
+        {
+            int index = (chunk->code[offset + 1] << 8) | chunk->code[offset + 2];
+            printf(" %5d '", index);
+            print_value(chunk->constants[index]);
+            printf("'\n");
+            return offset + 3;
+        }
+        case OP_GET_LOCAL:
+        case OP_SET_LOCAL:
+        case OP_GET_GLOBAL:
+        case OP_SET_GLOBAL:
+        case OP_DEFINE_GLOBAL:
+        case OP_BUILD_LIST:
+        case OP_BUILD_MAP:
+        case OP_ENTER_FRAME:
+        case OP_DECLARE_LIST:
+        case OP_EXEC_STMT:
+            printf(" %5d\n", (chunk->code[offset + 1] << 8) | chunk->code[offset + 2]);
+            return offset + 3;
+        case OP_GET_FIELD:
+        case OP_SET_FIELD:
+        {
+            int index = (chunk->code[offset + 1] << 8) | chunk->code[offset + 2];
+            printf(" %5d '%s'\n", index, chunk->nodes[index]->value);
+            return offset + 3;
+        }
+        case OP_INVOKE:
+        case OP_TAIL_INVOKE:
+        {
+            int index = (chunk->code[offset + 1] << 8) | chunk->code[offset + 2];
+            printf(" %5d '%s' %d\n", index, chunk->nodes[index]->value, chunk->code[offset + 3]);
+            return offset + 4;
+        }
+        case OP_JUMP:
+        case OP_JUMP_IF_FALSE:
+        case OP_AND_JUMP:
+        case OP_OR_JUMP:
+        case OP_FOREACH_NEXT:
+        {
+            int jump = (chunk->code[offset + 1] << 8) | chunk->code[offset + 2];
+            printf(" -> %d\n", offset + 3 + jump);
+            return offset + 3;
+        }
+        case OP_SWITCH_TABLE:
+        {
+            int index = (chunk->code[offset + 1] << 8) | chunk->code[offset + 2];
+            int entry_count = chunk->nodes[index]->children_count;
+            int table_end = offset + 3 + 2 * entry_count;
+            printf(" %5d ->", index);
+            for (int i = 0; i < entry_count; i++)
+                printf(" %d", table_end + ((chunk->code[offset + 3 + 2 * i] << 8) | chunk->code[offset + 4 + 2 * i]));
+            printf("\n");
+            return table_end;
+        }
+        case OP_LOOP:
+        {
+            int jump = (chunk->code[offset + 1] << 8) | chunk->code[offset + 2];
+            printf(" -> %d\n", offset + 3 - jump);
+            return offset + 3;
+        }
+        case OP_GET_ENCLOSING:
+        case OP_SET_ENCLOSING:
+            printf(" %5d %5d\n", chunk->code[offset + 1], (chunk->code[offset + 2] << 8) | chunk->code[offset + 3]);
+            return offset + 4;
+        case OP_CALL:
+        case OP_TAIL_CALL:
+        case OP_NEW:
+        case OP_PRINT:
+        case OP_CONCAT:
+            printf(" %5d\n", chunk->code[offset + 1]);
+            return offset + 2;
+        default:
+            printf("\n");
+            return offset + 1;
+    }
+}
+
+void disassemble_chunk(Chunk *chunk, const char *name)
+{
+    printf("== %s ==\n", name);
+    for (int offset = 0; offset < chunk->count;)
+        offset = disassemble_instruction(chunk, offset);
+}
@@ -0,0 +1,131 @@
+/**
+ * @file compiler.h
+ * @brief Header file for the Pith bytecode compiler.
+ *
+ * Defines the instruction set executed by the stack VM (see vm.h), the `Chunk` container
+ * that holds compiled code together with its constant pool, and the entry points that
+ * translate the AST produced by `parse_program` into bytecode.
+ */
+
+#ifndef PITH_COMPILER_H
+#define PITH_COMPILER_H
+
+#include <stdint.h>
+#include "value.h"
+
+/**
+ * @brief Enumeration of all bytecode instructions.
+ *
+ * Operands follow the opcode inline. `u16` operands are stored big-endian in two bytes.
+ */
+typedef enum
+{
+    OP_CONSTANT, // [u16 constant] Push a constant
+    OP_POP, // Discard the top of the stack
+    OP_GET_LOCAL, // [u16 slot] Push a variable of the current frame
+    OP_SET_LOCAL, // [u16 slot] Pop a value into a variable of the current frame
+    OP_GET_ENCLOSING, // [u8 depth][u16 slot] Push a variable of an enclosing frame
+    OP_SET_ENCLOSING, // [u8 depth][u16 slot] Pop a value into a variable of an enclosing frame
+    OP_GET_GLOBAL, // [u16 global] Push a global
+    OP_SET_GLOBAL, // [u16 global] Pop a value into an existing global
+    OP_DEFINE_GLOBAL, // [u16 global] Pop a value and define a global with it
+    OP_GET_FIELD, // [u16 node] Replace an object with one of its members, through the node's inline cache
+    OP_SET_FIELD, // [u16 node] Pop an object and a value, store the value in a field, through the node's inline cache
+    OP_GET_INDEX, // Pop an index and a collection, push the element
+    OP_SET_INDEX, // Pop an index, a collection and a value, store the element
+    OP_ADD, // Binary arithmetic and comparison operators
+    OP_SUBTRACT,
+    OP_MULTIPLY,
+    OP_DIVIDE,
+    OP_MODULO,
+    OP_POWER,
+    OP_LESS,
+    OP_GREATER,
+    OP_LESS_EQUAL,
+    OP_GREATER_EQUAL,
+    OP_EQUAL,
+    OP_NOT_EQUAL,
+    OP_AND,
+    OP_OR,
+    OP_CONCAT, // [u8 count] Pop the operands of a `+` chain, push their sum (see concat_values)
+    OP_NEGATE, // Unary '-'
+    OP_NOT, // Unary '!'
+    OP_BUILD_LIST, // [u16 count] Pop elements, push a new list
+    OP_BUILD_MAP, // [u16 pairs] Pop key/value pairs, push a new hashmap
+    OP_CALL, // [u8 args] Call the value below the arguments
+    OP_INVOKE, // [u16 node][u8 args] Call a member of the object below the arguments, without binding it
+    OP_TAIL_CALL, // [u8 args] Like OP_CALL, then return the result (see tail_call_value)
+    OP_TAIL_INVOKE, // [u16 node][u8 args] Like OP_INVOKE, then return the result (see tail_call_method)
+    OP_NEW, // [u8 args] Instantiate the class below the arguments
+    OP_PRINT, // [u8 count] Pop and print values
+    OP_JUMP, // [u16 offset] Jump forward
+    OP_JUMP_IF_FALSE, // [u16 offset] Pop a condition, jump forward if it is false
+    OP_AND_JUMP, // [u16 offset] Jump forward, keeping the left operand of 'and', if it is false
+    OP_OR_JUMP, // [u16 offset] Jump forward, keeping the left operand of 'or', if it is true
+    OP_LOOP, // [u16 offset] Jump backward
+    OP_FOREACH_NEXT, // [u16 offset] With [list, index] on the stack, push the next item or jump forward
+    OP_ENTER_FRAME, // [u16 slots] Run the following code in a new frame enclosed by the current one
+    OP_LEAVE_FRAME, // Return to the frame enclosing the current one
+    OP_SWITCH_MATCH, // Pop a case value, push whether it matches the switch subject below it
+    OP_SWITCH_TABLE, // [u16 node][u16 offset per child of the switch] Jump to the clause the subject on top of the stack matches
+    OP_DECLARE_LIST, // [u16 node] Apply a declared list<T> type to the top of the stack
+    OP_EXEC_STMT, // [u16 node] Execute a statement with the tree-walker
+    OP_RETURN // Pop the return value and leave the current frame
+} OpCode;
+
+/**
+ * @brief A sequence of compiled bytecode with its constant pool.
+ */
+typedef struct Chunk
+{
+    uint8_t *code; // Instruction stream
+    int *lines; // Source line for each byte of code
+    int count; // Number of bytes used
+    int capacity; // Allocated capacity
+    Value *constants; // Literal values referenced by instructions
+    int constant_count;
+    int constant_capacity;
+    ASTNode **nodes; // AST nodes referenced by OP_EXEC_STMT, OP_DECLARE_LIST, OP_SWITCH_TABLE and the field instructions
+    int node_count;
+    int node_capacity;
+} Chunk;
+
+/**
+ * @brief Compiles the top-level statements of a program.
+ * @param root The AST_PROGRAM node, annotated by the resolver.
+ * @return The compiled chunk. The caller owns it (see `free_chunk`).
+ */
+Chunk *compile_program(ASTNode *root);
+
+/**
+ * @brief Compiles the body of a function definition.
+ * @param func_def The AST_FUNC_DEF node.
+ * @return The compiled chunk. The caller owns it (see `free_chunk`).
+ */
+Chunk *compile_function(ASTNode *func_def);
+
+/**
+ * @brief Frees a chunk and its arrays.
+ *
+ * Constants are GC-managed, so they are not freed here.
+ *
+ * @param chunk The chunk to free (may be NULL).
+ */
+void free_chunk(Chunk *chunk);
+
+/**
+ * @brief Prints a human-readable listing of a chunk to stdout.
+ * @param chunk The chunk to disassemble.
+ * @param name A label printed in the header.
+ */
+void disassemble_chunk(Chunk *chunk, const char *name);
+
+/**
+ * @brief Prints a single instruction and returns the offset of the next one.
+ * @param chunk The chunk containing the instruction.
+ * @param offset The byte offset of the instruction.
+ * @return The offset of the following instruction.
+ */
+int disassemble_instruction(Chunk *chunk, int offset);
+
+#endif //PITH_COMPILER_H
@@ -0,0 +1,63 @@
+/**
+ * @file constants.c
+ * @brief Implementation of the Pith constant pool.
+ */
+
+#include "constants.h"
+#include "interpreter.h"
+#include "gc.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+ConstantPool constant_pool = {NULL, 0, 0};
+
+static int add_constant_value(Value value)
+{
+    if (constant_pool.count >= constant_pool.capacity)
+    {
+        constant_pool.capacity = constant_pool.capacity == 0 ? 64 : constant_pool.capacity * 2;
+        constant_pool.values = realloc(constant_pool.values, constant_pool.capacity * sizeof(Value));
+        if (!constant_pool.values)
+        {
+            fprintf(stderr, "Fatal: Memory allocation failed for constant pool.\n");
+            exit(1);
+        }
+    }
+    constant_pool.values[constant_pool.count] = value;
+    return constant_pool.count++;
+}
+
+int make_literal_constant(ASTNodeType type, const char *text)
+{
+    Value value;
+    switch (type)
+    {
+        case AST_INT_LITERAL:
+            value.type = VAL_INT;
+            value.int_val = atoi(text);
+            break;
+        case AST_FLOAT_LITERAL:
+            value.type = VAL_FLOAT;
+            value.float_val = atof(text);
+            break;
+        case AST_STRING_LITERAL:
+            value.type = VAL_STRING;
+            value.string = copy_string(text, (int) strlen(text));
+            break;
+        case AST_BOOL_LITERAL:
+            value.type = VAL_BOOL;
+            value.int_val = (strcmp(text, "true") == 0);
+            break;
+        default:
+            value.type = VAL_VOID;
+            break;
+    }
+    return add_constant_value(value);
+}
+
+void mark_constants()
+{
+    for (int i = 0; i < constant_pool.count; i++)
+        mark_value(constant_pool.values[i]);
+}
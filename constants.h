@@ -0,0 +1,53 @@
+/**
+ * @file constants.h
+ * @brief Header file for the Pith constant pool.
+ *
+ * Literals are decoded once, when the parser builds their AST node, into ready-made Values
+ * stored in a single pool shared by every program, module and REPL entry of the run. A literal
+ * node keeps the index of its Value in `ASTNode.constant`; so does a field access node, for its
+ * interned member name.
+ *
+ * String constants are ordinary GC strings kept alive by the pool, which is a GC root.
+ */
+
+#ifndef PITH_CONSTANTS_H
+#define PITH_CONSTANTS_H
+
+#include "value.h"
+
+/**
+ * @brief The decoded values of every literal parsed so far.
+ */
+typedef struct
+{
+    Value *values;
+    int count;
+    int capacity;
+} ConstantPool;
+
+extern ConstantPool constant_pool;
+
+/**
+ * @brief Reads the Value of a literal node.
+ */
+#define LITERAL_VALUE(node) (constant_pool.values[(node)->constant])
+
+/**
+ * @brief Reads the interned member name of an AST_FIELD_ACCESS node.
+ */
+#define MEMBER_NAME(node) (constant_pool.values[(node)->constant].string)
+
+/**
+ * @brief Decodes the text of a literal and adds it to the pool.
+ * @param type AST_INT_LITERAL, AST_FLOAT_LITERAL, AST_STRING_LITERAL or AST_BOOL_LITERAL.
+ * @param text The literal as written in the source (without quotes for strings).
+ * @return The index of the new constant.
+ */
+int make_literal_constant(ASTNodeType type, const char *text);
+
+/**
+ * @brief Marks every constant (called by the GC).
+ */
+void mark_constants();
+
+#endif //PITH_CONSTANTS_H
@@ -61,6 +61,35 @@
 // Traces the process of importing modules.
 // #define DEBUG_TRACE_IMPORT
 
+// --- Bytecode Listing ---
+// Prints the disassembled bytecode of every chunk compiled for the VM (--vm).
+// #define DEBUG_PRINT_BYTECODE
+
+// --- VM Execution Tracing ---
+// Prints the value stack and each instruction as the VM executes it.
+// #define DEBUG_TRACE_VM
+
+// --- Closure Compiler ---
+// Runs every node through the plain switch of eval_node/exec_node instead of compiled closures.
+// Per-node tracing (DEBUG_TRACE_EXECUTION, DEBUG_DEEP_DIVE_INTERP) only sees nodes run that way.
+// #define DEBUG_NO_CLOSURE_COMPILER
+
+// --- Quickening Tracing ---
+// Logs closure nodes specialising for the types they see, and falling back when a guard fails.
+// #define DEBUG_TRACE_QUICKENING
+
+// --- Static Checker Tracing ---
+// Logs the passes the checker needs and the result and parameter types it proves for each function.
+// #define DEBUG_TRACE_CHECKER
+
+// --- JIT Tracing ---
+// Logs each hot function the JIT compiles (with --jit), or the line that keeps it on the engine.
+// #define DEBUG_TRACE_JIT
+
+// --- Inline Cache Statistics ---
+// Counts field and method lookups served by inline caches, and prints the totals at exit.
+// #define DEBUG_FIELD_CACHE_STATS
+
 // --- Tokenizer Tracing ---
 // Traces the execution of the tokenizer, showing each character as it is processed.
 // #define DEBUG_TRACE_TOKENIZER
@@ -9,6 +9,8 @@
 
 #include "gc.h"
 #include "interpreter.h"
+#include "vm.h"
+#include "constants.h"
 #include <stdlib.h>
 #include <stdio.h>
 
@@ -17,18 +19,26 @@ ObjHeader *objects = NULL;
 
 // --- Temporary Root Stack ---
 // Used to protect objects from GC while they are being constructed or used on the C stack.
-#define MAX_TEMP_ROOTS 256
-ObjHeader *temp_roots[MAX_TEMP_ROOTS];
+// It grows as needed, since the tree-walker keeps operands and arguments here across nested calls.
+ObjHeader **temp_roots = NULL;
 int temp_root_count = 0;
+int temp_root_capacity = 0;
 
 // --- Allocation Tracking ---
 size_t bytes_allocated = 0;
 size_t next_gc_threshold = 1024 * 1024; // Start at 1MB
 
-// Forward declarations
-void mark_object(ObjHeader *obj);
+// --- Substring Views ---
+// Views marked this cycle. Whether a view keeps its parent alive is only decided once marking is
+// done (see resolve_string_views).
+static ObjString **marked_views = NULL;
+static int marked_view_count = 0;
+static int marked_view_capacity = 0;
 
-void mark_value(Value v);
+void gc_track_bytes(size_t size)
+{
+    bytes_allocated += size;
+}
 
 /**
  * @brief Pushes an object onto the temporary root stack.
@@ -40,14 +50,65 @@ void mark_value(Value v);
  */
 void gc_push_root(ObjHeader *obj)
 {
-    if (temp_root_count >= MAX_TEMP_ROOTS)
+    if (temp_root_count >= temp_root_capacity)
     {
-        fprintf(stderr, "Fatal: GC temp root stack overflow.\n");
-        exit(1);
+        temp_root_capacity = temp_root_capacity == 0 ? 256 : temp_root_capacity * 2;
+        temp_roots = realloc(temp_roots, temp_root_capacity * sizeof(ObjHeader *));
+        if (temp_roots == NULL)
+        {
+            fprintf(stderr, "Fatal: Memory allocation failed for GC temp roots.\n");
+            exit(1);
+        }
     }
     temp_roots[temp_root_count++] = obj;
 }
 
+/**
+ * @brief Returns the heap object referenced by a value, or NULL for non-object values.
+ */
+static ObjHeader *value_object(Value v)
+{
+    switch (v.type)
+    {
+        case VAL_STRING:
+            return (ObjHeader *) v.string;
+        case VAL_LIST:
+            return (ObjHeader *) v.list;
+        case VAL_HASHMAP:
+            return (ObjHeader *) v.hashmap;
+        case VAL_FUNC:
+            return (ObjHeader *) v.func;
+        case VAL_MODULE:
+            return (ObjHeader *) v.module;
+        case VAL_CLASS:
+            return (ObjHeader *) v.pith_class;
+        case VAL_INSTANCE:
+            return (ObjHeader *) v.instance;
+        case VAL_BOUND_METHOD:
+            return (ObjHeader *) v.bound_method;
+        case VAL_STRING_BUILDER:
+            return (ObjHeader *) v.builder;
+        case VAL_STRUCT_DEF:
+            return (ObjHeader *) v.struct_def;
+        case VAL_STRUCT_INSTANCE:
+            return (ObjHeader *) v.struct_instance;
+        default:
+            return NULL;
+    }
+}
+
+/**
+ * @brief Pushes the object referenced by a value (if any) onto the temporary root stack.
+ *
+ * Every call must be matched by a `gc_pop_root`, even for values that are not objects.
+ *
+ * @param v The value to protect.
+ */
+void gc_push_value(Value v)
+{
+    gc_push_root(value_object(v));
+}
+
 /**
  * @brief Pops the last object from the temporary root stack.
  */
@@ -64,6 +125,29 @@ void gc_pop_root()
     }
 }
 
+/**
+ * @brief Pops several objects from the temporary root stack.
+ *
+ * @param count The number of objects to pop.
+ */
+void gc_pop_roots(int count)
+{
+    if (count > temp_root_count)
+    {
+        fprintf(stderr, "Fatal: GC temp root stack underflow.\n");
+        exit(1);
+    }
+    temp_root_count -= count;
+}
+
+/**
+ * @brief Empties the temporary root stack after an error has been recovered from.
+ */
+void gc_reset_roots()
+{
+    temp_root_count = 0;
+}
+
 /**
  * @brief Allocates memory for a new garbage-collected object.
  *
@@ -110,25 +194,7 @@ void *allocate_obj(size_t size, ObjType type)
  */
 void mark_value(Value v)
 {
-    if (v.type == VAL_LIST)
-        mark_object((ObjHeader *) v.list);
-    else if (v.type == VAL_HASHMAP)
-        mark_object((ObjHeader *) v.hashmap);
-    else if (v.type == VAL_FUNC)
-        mark_object((ObjHeader *) v.func);
-    else if (v.type == VAL_MODULE)
-        mark_object((ObjHeader *) v.module);
-    else if (v.type == VAL_CLASS)
-        mark_object((ObjHeader *) v.pith_class);
-    else if (v.type == VAL_INSTANCE)
-        mark_object((ObjHeader *) v.instance);
-    else if (v.type == VAL_BOUND_METHOD)
-        mark_object((ObjHeader *) v.bound_method);
-    else if (v.type == VAL_STRUCT_DEF)
-        mark_object((ObjHeader *) v.struct_def);
-    else
-        if (v.type == VAL_STRUCT_INSTANCE)
-            mark_object((ObjHeader *) v.struct_instance);
+    mark_object(value_object(v));
 }
 
 /**
@@ -145,7 +211,10 @@ void mark_object(ObjHeader *obj)
     printf("[GC] Marking object %p of type %d\n", (void *) obj, obj->type);
 #endif
 
-    obj->is_marked = 1;
+    // Stack frames are never swept, which is what clears the mark of heap objects, so they are
+    // traced on every visit instead. Only roots refer to them, so this cannot loop.
+    if (obj->type != OBJ_STACK_ENV)
+        obj->is_marked = 1;
 
     switch (obj->type)
     {
@@ -161,13 +230,12 @@ void mark_object(ObjHeader *obj)
         case OBJ_MAP:
         {
             HashMap *map = (HashMap *) obj;
-            for (int i = 0; i < map->bucket_count; i++)
+            for (int i = 0; i < map->capacity; i++)
             {
-                MapEntry *entry = map->buckets[i];
-                while (entry)
+                if (map->entries[i].key)
                 {
-                    mark_value(entry->value);
-                    entry = entry->next;
+                    mark_object((ObjHeader *) map->entries[i].key);
+                    mark_value(map->entries[i].value);
                 }
             }
             break;
@@ -188,6 +256,10 @@ void mark_object(ObjHeader *obj)
         {
             PithClass *cls = (PithClass *) obj;
             mark_object((ObjHeader *) cls->methods);
+            for (int i = 0; i < cls->field_count; i++)
+            {
+                mark_object((ObjHeader *) cls->fields[i]);
+            }
             if (cls->parent)
             {
                 mark_object((ObjHeader *) cls->parent);
@@ -198,7 +270,10 @@ void mark_object(ObjHeader *obj)
         {
             PithInstance *inst = (PithInstance *) obj;
             mark_object((ObjHeader *) inst->pith_class);
-            mark_object((ObjHeader *) inst->fields);
+            for (int i = 0; i < inst->field_count; i++)
+            {
+                mark_value(inst->fields[i]);
+            }
             break;
         }
         case OBJ_BOUND_METHOD:
@@ -209,13 +284,34 @@ void mark_object(ObjHeader *obj)
             break;
         }
         case OBJ_ENV:
+        case OBJ_STACK_ENV:
         {
             Env *env = (Env *) obj;
-            mark_value(env->val);
-            mark_object((ObjHeader *) env->next);
+            for (int i = 0; i < env->slot_count; i++)
+                mark_value(env->slots[i]);
+            mark_object((ObjHeader *) env->enclosing);
+            break;
+        }
+        case OBJ_STRING:
+        {
+            ObjString *string = (ObjString *) obj;
+            if (!string->parent)
+                break;
+            if (marked_view_count >= marked_view_capacity)
+            {
+                marked_view_capacity = marked_view_capacity == 0 ? 64 : marked_view_capacity * 2;
+                marked_views = realloc(marked_views, marked_view_capacity * sizeof(ObjString *));
+                if (marked_views == NULL)
+                {
+                    fprintf(stderr, "Fatal: Memory allocation failed for GC string views.\n");
+                    exit(1);
+                }
+            }
+            marked_views[marked_view_count++] = string;
             break;
         }
         case OBJ_STRUCT_DEF:
+        case OBJ_STRING_BUILDER:
             // No child objects to mark
             break;
         case OBJ_STRUCT_INSTANCE:
@@ -234,16 +330,22 @@ void mark_object(ObjHeader *obj)
 /**
  * @brief Marks all root objects.
  *
- * Roots include the global environment, native registries, and the temporary root stack.
+ * Roots include the global table, running frames, native registries, the temporary root stack and the
+ * VM's value and frame stacks.
  */
 void mark_roots()
 {
-    // Mark the global environment
-    mark_object((ObjHeader *) global_env);
+    // Mark the globals and the frames of running code
+    mark_interpreter_roots();
+
+    // Mark string literals and other constants
+    mark_constants();
 
     // Mark native registries
     mark_object((ObjHeader *) native_string_methods);
     mark_object((ObjHeader *) native_list_methods);
+    mark_object((ObjHeader *) native_string_builder_methods);
+    mark_object((ObjHeader *) native_map_methods);
     mark_object((ObjHeader *) native_module_funcs);
 
     // Mark temporary roots (from C stack)
@@ -251,25 +353,9 @@ void mark_roots()
     {
         mark_object(temp_roots[i]);
     }
-}
 
-/**
- * @brief Frees content owned by a Value (e.g., strings).
- *
- * Note: This only frees the raw C-string if it's a VAL_STRING.
- * Other object types are managed by the GC object list.
- *
- * @param v The value to free content for.
- */
-void free_value_content(Value v)
-{
-    if (v.type == VAL_STRING && v.str_val != NULL)
-    {
-#ifdef DEBUG_TRACE_ADVANCED_MEMORY
-        printf("[ADV_MEMORY] Freeing string content '%s' at %p\n", v.str_val, (void *) v.str_val);
-#endif
-        free(v.str_val);
-    }
+    // Mark values and environments held by the bytecode VM
+    vm_mark_roots();
 }
 
 /**
@@ -297,10 +383,6 @@ void sweep()
                 case OBJ_LIST:
                 {
                     List *list = (List *) unreached;
-                    for (int i = 0; i < list->count; i++)
-                    {
-                        free_value_content(list->items[i]);
-                    }
                     free(list->items);
                     bytes_allocated -= sizeof(List);
                     break;
@@ -308,19 +390,8 @@ void sweep()
                 case OBJ_MAP:
                 {
                     HashMap *map = (HashMap *) unreached;
-                    for (int i = 0; i < map->bucket_count; i++)
-                    {
-                        MapEntry *entry = map->buckets[i];
-                        while (entry)
-                        {
-                            MapEntry *next = entry->next;
-                            free(entry->key);
-                            free_value_content(entry->value);
-                            free(entry);
-                            entry = next;
-                        }
-                    }
-                    free(map->buckets);
+                    free(map->control);
+                    free(map->entries);
                     bytes_allocated -= sizeof(HashMap);
                     break;
                 }
@@ -343,36 +414,25 @@ void sweep()
                 {
                     PithClass *cls = (PithClass *) unreached;
                     free(cls->name);
-                    if (cls->fields)
-                    {
-                        for (int i = 0; i < cls->field_count; i++)
-                        {
-                            free(cls->fields[i]);
-                        }
-                        free(cls->fields);
-                    }
+                    free(cls->fields);
                     bytes_allocated -= sizeof(PithClass);
                     break;
                 }
                 case OBJ_ENV:
                 {
                     Env *env = (Env *) unreached;
-                    free(env->name);
-                    free_value_content(env->val);
-                    bytes_allocated -= sizeof(Env);
+                    bytes_allocated -= sizeof(Env) + env->slot_count * sizeof(Value);
                     break;
                 }
                 case OBJ_INSTANCE:
                 {
-                    // PithInstance doesn't own extra raw memory, just pointers to other GC objects
+                    PithInstance *inst = (PithInstance *) unreached;
+                    free(inst->fields);
                     bytes_allocated -= sizeof(PithInstance);
                     break;
                 }
                 case OBJ_BOUND_METHOD:
                 {
-                    BoundMethod *bm = (BoundMethod *) unreached;
-                    free_value_content(bm->receiver);
-                    free_value_content(bm->method);
                     bytes_allocated -= sizeof(BoundMethod);
                     break;
                 }
@@ -394,14 +454,39 @@ void sweep()
                 case OBJ_STRUCT_INSTANCE:
                 {
                     StructInstance *inst = (StructInstance *) unreached;
-                    for (int i = 0; i < inst->def->field_count; i++)
-                    {
-                        free_value_content(inst->field_values[i]);
-                    }
                     free(inst->field_values);
                     bytes_allocated -= sizeof(StructInstance);
                     break;
                 }
+                case OBJ_STRING:
+                {
+                    ObjString *string = (ObjString *) unreached;
+                    if (string->chars == (char *) (string + 1))
+                    {
+                        bytes_allocated -= sizeof(ObjString) + string->length + 1;
+                    }
+                    else
+                    {
+                        // A view, or a view copied out of its parent (see materialise_string)
+                        bytes_allocated -= sizeof(ObjString);
+                        if (!string->parent)
+                        {
+                            free(string->chars);
+                            bytes_allocated -= string->length + 1;
+                        }
+                    }
+                    break;
+                }
+                case OBJ_STRING_BUILDER:
+                {
+                    StringBuilder *builder = (StringBuilder *) unreached;
+                    free(builder->chars);
+                    bytes_allocated -= sizeof(StringBuilder) + builder->capacity;
+                    break;
+                }
+                case OBJ_STACK_ENV:
+                    // Never on the object list
+                    break;
             }
             free(unreached);
         }
@@ -413,6 +498,30 @@ void sweep()
     }
 }
 
+/**
+ * @brief Decides, once marking is done, which parents the marked substring views keep alive.
+ *
+ * A view covering at least a quarter of its parent keeps the parent. A smaller one only shares it
+ * if something else keeps it alive; otherwise the view copies its characters out, so that a few
+ * short tokens do not pin a large string.
+ */
+static void resolve_string_views()
+{
+    for (int i = 0; i < marked_view_count; i++)
+    {
+        ObjString *view = marked_views[i];
+        if (view->length >= view->parent->length / 4)
+            view->parent->obj.is_marked = 1;
+    }
+    for (int i = 0; i < marked_view_count; i++)
+    {
+        ObjString *view = marked_views[i];
+        if (view->parent && !view->parent->obj.is_marked)
+            materialise_string(view);
+    }
+    marked_view_count = 0;
+}
+
 /**
  * @brief Performs a full garbage collection cycle.
  *
@@ -426,6 +535,8 @@ void gc_collect()
 #endif
 
     mark_roots();
+    resolve_string_views();
+    remove_unmarked_strings();
     sweep();
 
     next_gc_threshold = bytes_allocated * 2;
@@ -453,6 +564,7 @@ void free_all_objects()
     }
 
     // Call sweep. Since nothing is marked (and we don't call mark_roots), everything will be freed.
+    remove_unmarked_strings();
     sweep();
 }
 
@@ -22,6 +22,16 @@
  */
 void *allocate_obj(size_t size, ObjType type);
 
+/**
+ * @brief Counts memory an object has grown outside its own allocation, such as a buffer.
+ *
+ * The bytes pace collections like allocated objects do, but no collection runs here; the next
+ * allocation starts one if the threshold is passed. The object's sweep must subtract them again.
+ *
+ * @param size The number of bytes the object grew by.
+ */
+void gc_track_bytes(size_t size);
+
 /**
  * @brief Triggers a garbage collection cycle.
  *
@@ -41,6 +51,18 @@ void free_all_objects();
  */
 void print_gc_stats();
 
+/**
+ * @brief Marks an object and everything reachable from it.
+ * @param obj The object to mark (may be NULL).
+ */
+void mark_object(ObjHeader *obj);
+
+/**
+ * @brief Marks the object referenced by a value, if any.
+ * @param v The value to mark.
+ */
+void mark_value(Value v);
+
 // --- Temporary Root Management ---
 
 /**
@@ -53,9 +75,29 @@ void print_gc_stats();
  */
 void gc_push_root(ObjHeader *obj);
 
+/**
+ * @brief Pushes the object referenced by a value (if any) onto the temporary root stack.
+ *
+ * Every call must be matched by a pop, even for values that are not objects.
+ *
+ * @param v The value to protect.
+ */
+void gc_push_value(Value v);
+
 /**
  * @brief Pops the last object from the temporary root stack.
  */
 void gc_pop_root();
 
+/**
+ * @brief Pops several objects from the temporary root stack.
+ * @param count The number of objects to pop.
+ */
+void gc_pop_roots(int count);
+
+/**
+ * @brief Empties the temporary root stack after an error has been recovered from.
+ */
+void gc_reset_roots();
+
 #endif //PITH_GC_H
@@ -13,6 +13,12 @@
 #include "debug.h"
 #include "common.h"
 #include "gc.h" // Include GC
+#include "vm.h"
+#include "resolver.h"
+#include "constants.h"
+#include "closure.h"
+#include "jit.h"
+#include "string_search.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -20,37 +26,43 @@
 #include <stdarg.h>
 #include <time.h>
 #include <ctype.h>
+#include <limits.h>
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
 
-// --- Environment ---
-// Env struct definition moved to value.h
-
-Env *global_env = NULL;
+// --- Execution Engine ---
+ExecutionEngine execution_engine = ENGINE_TREE_WALKER;
 
 // --- Native Registries ---
 HashMap *native_string_methods;
 HashMap *native_list_methods;
+HashMap *native_string_builder_methods;
+HashMap *native_map_methods;
 HashMap *native_module_funcs;
 
+static ObjString *init_string = NULL; // Interned name of constructors, set on first use
+
 // --- Forward Declarations ---
 Value eval(ASTNode *node, Env *env);
 
-Value exec(ASTNode *node, Env **env_ptr);
+Value exec(ASTNode *node, Env *env);
 
-Value exec_block(ASTNode *node, Env **env_ptr);
+Value exec_block(ASTNode *node, Env *env);
 
 HashMap *hashmap_create(ValueType key_type, ValueType value_type);
 
-void hashmap_set(HashMap *map, const char *key, Value value, int line_num);
+void hashmap_set(HashMap *map, ObjString *key, Value value, int line_num);
 
-Value hashmap_get(HashMap *map, const char *key);
+Value hashmap_get(HashMap *map, ObjString *key);
 
 void interpret(ASTNode *root);
 
 char *read_file_content(const char *filename);
 
-Value value_copy(Value v);
+static char *read_file_bytes(const char *filename, long *length);
 
-void define_all_natives_in_env(Env **env_ptr);
+void define_all_natives();
 
 void register_all_native_methods();
 
@@ -58,7 +70,7 @@ void register_all_native_modules();
 
 ValueType get_type_from_name(const char *type_name);
 
-void exec_module(ASTNode *root, Env **env_ptr);
+void exec_module(ASTNode *root, Env *env);
 
 const char *get_value_type_name(ValueType type);
 
@@ -165,144 +177,619 @@ void report_error(int line, const char *format, ...)
     current_error_reporter(line, "%s", buffer);
 }
 
+// --- Strings ---
+
+/**
+ * @brief The intern table: every live string, so that equal strings share one object.
+ *
+ * Strings are interned as they are created, which turns string equality and map key lookup
+ * into pointer comparisons. The table does not keep its strings alive; the GC drops the
+ * unreachable ones before sweeping (see remove_unmarked_strings).
+ */
+static ObjString **interned = NULL;
+static int interned_capacity = 0;
+static int interned_used = 0; // Live strings plus tombstones
+static ObjHeader interned_tombstone;
+
+#define STRING_TOMBSTONE ((ObjString *) &interned_tombstone)
+
+unsigned long hash_string(const char *chars, int length)
+{
+    unsigned long hash = 5381;
+    for (int i = 0; i < length; i++)
+        hash = ((hash << 5) + hash) + (unsigned char) chars[i];
+    return hash;
+}
+
+/**
+ * @brief Finds the interned string with the given characters.
+ * @return The string, or NULL if none is interned.
+ */
+static ObjString *find_interned(const char *chars, int length, unsigned long hash)
+{
+    if (interned_capacity == 0)
+        return NULL;
+    int mask = interned_capacity - 1;
+    for (int i = (int) (hash & mask);; i = (i + 1) & mask)
+    {
+        ObjString *string = interned[i];
+        if (string == NULL)
+            return NULL;
+        if (string != STRING_TOMBSTONE && string->hash == hash && string->length == length &&
+            memcmp(string->chars, chars, length) == 0)
+            return string;
+    }
+}
+
+static void insert_interned(ObjString *string)
+{
+    if ((interned_used + 1) * 4 > interned_capacity * 3)
+    {
+        ObjString **old = interned;
+        int old_capacity = interned_capacity;
+        interned_capacity = old_capacity == 0 ? 256 : old_capacity * 2;
+        interned = calloc(interned_capacity, sizeof(ObjString *));
+        if (!interned)
+        {
+            fprintf(stderr, "Fatal: Memory allocation failed for string table.\n");
+            exit(1);
+        }
+        interned_used = 0;
+        for (int i = 0; i < old_capacity; i++)
+        {
+            if (old[i] && old[i] != STRING_TOMBSTONE)
+                insert_interned(old[i]);
+        }
+        free(old);
+    }
+
+    int mask = interned_capacity - 1;
+    int i = (int) (string->hash & mask);
+    while (interned[i] != NULL && interned[i] != STRING_TOMBSTONE)
+        i = (i + 1) & mask;
+    if (interned[i] == NULL)
+        interned_used++;
+    interned[i] = string;
+}
+
+void remove_unmarked_strings()
+{
+    for (int i = 0; i < interned_capacity; i++)
+    {
+        if (interned[i] && interned[i] != STRING_TOMBSTONE && !interned[i]->obj.is_marked)
+            interned[i] = STRING_TOMBSTONE;
+    }
+}
+
+/**
+ * @brief Allocates a string with room for `length` characters, which the caller fills in
+ *        before passing it to intern_string.
+ */
+static ObjString *allocate_string(int length)
+{
+    ObjString *string = (ObjString *) allocate_obj(sizeof(ObjString) + length + 1, OBJ_STRING);
+    string->length = length;
+    string->hash = 0;
+    string->chars = (char *) (string + 1);
+    string->parent = NULL;
+    string->chars[length] = '\0';
+    return string;
+}
+
+/**
+ * @brief Interns a string just filled in after allocate_string.
+ * @return The canonical string: `string` itself, or an equal string interned earlier (in
+ *         which case `string` is left for the GC).
+ */
+static ObjString *intern_string(ObjString *string)
+{
+    string->hash = hash_string(string->chars, string->length);
+    ObjString *existing = find_interned(string->chars, string->length, string->hash);
+    if (existing)
+        return existing;
+    insert_interned(string);
+    return string;
+}
+
+ObjString *copy_string(const char *chars, int length)
+{
+    unsigned long hash = hash_string(chars, length);
+    ObjString *existing = find_interned(chars, length, hash);
+    if (existing)
+        return existing;
+
+    ObjString *string = allocate_string(length);
+    memcpy(string->chars, chars, length);
+    string->hash = hash;
+    insert_interned(string);
+    return string;
+}
+
+ObjString *take_string(char *chars)
+{
+    ObjString *string = copy_string(chars, (int) strlen(chars));
+    free(chars);
+    return string;
+}
+
+/**
+ * @brief Shortest substring made a view; a shorter one costs less to copy than to keep its
+ *        parent alive for.
+ */
+#define MIN_VIEW_LENGTH 16
+
+ObjString *copy_substring(ObjString *source, int start, int length)
+{
+    if (start == 0 && length == source->length)
+        return source;
+    unsigned long hash = hash_string(source->chars + start, length);
+    ObjString *existing = find_interned(source->chars + start, length, hash);
+    if (existing)
+        return existing;
+
+    // A collection may copy `source` out of its own parent, so its characters are only read
+    // once the new string is allocated.
+    ObjString *string;
+    if (length < MIN_VIEW_LENGTH)
+    {
+        string = allocate_string(length);
+        memcpy(string->chars, source->chars + start, length);
+    }
+    else
+    {
+        string = (ObjString *) allocate_obj(sizeof(ObjString), OBJ_STRING);
+        string->length = length;
+        string->chars = source->chars + start;
+        string->parent = source->parent ? source->parent : source;
+    }
+    string->hash = hash;
+    insert_interned(string);
+    return string;
+}
+
+void materialise_string(ObjString *string)
+{
+    char *chars = malloc(string->length + 1);
+    if (!chars)
+    {
+        fprintf(stderr, "Fatal: Memory allocation failed for string.\n");
+        exit(1);
+    }
+    memcpy(chars, string->chars, string->length);
+    chars[string->length] = '\0';
+    string->chars = chars;
+    string->parent = NULL;
+    // Freed with the string (see sweep), so the GC counts the copy like the inline characters.
+    gc_track_bytes(string->length + 1);
+}
+
+const char *string_chars(ObjString *string)
+{
+    if (string->parent)
+        materialise_string(string);
+    return string->chars;
+}
+
+// --- Frames ---
+
 /**
- * @brief Creates a deep copy of a value.
+ * @brief Frames currently running, kept here so the GC can see them.
  *
- * Currently only strings need deep copying.
+ * While its code runs, a frame is only referenced from the C stack, so every frame entered by
+ * `call_function`, `interpret`, the REPL or an import is pushed here until it is left.
+ */
+static Env **active_frames = NULL;
+static int active_frame_count = 0;
+static int active_frame_capacity = 0;
+
+/**
+ * @brief Allocates a frame whose slots are all initialized to void.
  *
- * @param v The value to copy.
- * @return The copied value.
+ * @param slot_count Number of variable slots (see `ASTNode.slot_count`).
+ * @param enclosing The frame the running code was defined in.
+ * @return The new frame.
  */
-Value value_copy(Value v)
+Env *env_new(int slot_count, Env *enclosing)
 {
-#ifdef DEBUG_TRACE_MEMORY
-    printf("[MEMORY] Copying value of type %s\n", get_value_type_name(v.type));
+    Env *env = (Env *) allocate_obj(sizeof(Env) + slot_count * sizeof(Value), OBJ_ENV);
+    env->enclosing = enclosing;
+    env->slot_count = slot_count;
+    for (int i = 0; i < slot_count; i++)
+        env->slots[i] = (Value){VAL_VOID};
+
+#ifdef DEBUG_TRACE_ENVIRONMENT_ADV
+    printf("[ENV_ADV] New frame %p with %d slots, enclosing %p\n", (void *) env, slot_count, (void *) enclosing);
 #endif
-#ifdef DEBUG_TRACE_ADVANCED_MEMORY
-    if (v.type == VAL_STRING)
-        printf("[ADV_MEMORY] Copying string at %p\n", (void *) v.str_val);
+    return env;
+}
+
+/**
+ * @brief Registers a frame as running, protecting it from the GC.
+ * @param env The frame being entered.
+ */
+void push_frame(Env *env)
+{
+    if (active_frame_count >= active_frame_capacity)
+    {
+        active_frame_capacity = active_frame_capacity == 0 ? 64 : active_frame_capacity * 2;
+        active_frames = realloc(active_frames, active_frame_capacity * sizeof(Env *));
+        if (!active_frames)
+        {
+            fprintf(stderr, "Fatal: Memory allocation failed for frame stack.\n");
+            exit(1);
+        }
+    }
+    active_frames[active_frame_count++] = env;
+}
+
+/**
+ * @brief Unregisters the most recently entered frame.
+ */
+void pop_frame()
+{
+    active_frame_count--;
+}
+
+// --- C Stack Guard ---
+
+static char *c_stack_base; // Address of a local of the outermost call
+static size_t c_stack_budget; // Bytes of C stack that nested calls may use
+
+static size_t measure_c_stack_budget()
+{
+#ifdef _WIN32
+    size_t size = 1024 * 1024; // The default stack of the main thread
+#else
+    size_t size = 8 * 1024 * 1024;
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_STACK, &limit) == 0 && limit.rlim_cur != RLIM_INFINITY)
+        size = (size_t) limit.rlim_cur;
 #endif
+    // The rest is left for the natives and the code running between two calls.
+    return size / 4 * 3;
+}
 
-    if (v.type == VAL_STRING)
+/**
+ * @brief Reports a stack overflow if nested calls have used up their share of the C stack.
+ *
+ * Both engines recurse on the C stack for every call, and how much a call takes depends on the
+ * engine, the build and the code: the tree-walker recurses through the nesting of the called
+ * body's expressions, and a debug build's frames are several times larger. So nested calls are
+ * limited by the C stack they have used rather than by their number.
+ *
+ * @param line The line of the call being made.
+ */
+static void check_c_stack(int line)
+{
+    char marker;
+    if (!c_stack_base)
     {
-        Value new_v;
-        new_v.type = VAL_STRING;
-        new_v.str_val = strdup(v.str_val);
-        return new_v;
+        c_stack_base = &marker;
+        c_stack_budget = measure_c_stack_budget();
     }
-    return v;
+    size_t used = c_stack_base > &marker ? (size_t) (c_stack_base - &marker) : (size_t) (&marker - c_stack_base);
+    if (used > c_stack_budget)
+    {
+        report_error(line, "Stack overflow: calls are nested too deeply.");
+    }
+}
+
+// --- Frame Stack ---
+
+/**
+ * @brief LIFO storage for call frames that nothing can capture, and for argument arrays.
+ *
+ * A call whose function defines no nested function or class (see `ASTNode.frame_captured`)
+ * cannot leave its frame behind, so the frame is carved out of this stack instead of the GC
+ * heap and given back on return. The stack is a list of blocks that never move, so pointers
+ * into it stay valid while deeper calls grow it; releasing an allocation also releases
+ * everything allocated after it.
+ */
+#define FRAME_STACK_BLOCK_SIZE (64 * 1024)
+
+typedef struct
+{
+    char *base;
+    size_t used;
+    size_t size;
+} FrameStackBlock;
+
+static FrameStackBlock *frame_stack_blocks = NULL;
+static int frame_stack_block_count = 0;
+static int frame_stack_current = 0; // Block allocations are made from
+
+/**
+ * @brief Allocates memory on top of the frame stack.
+ *
+ * Sizes are rounded up so that every allocation is 16-byte aligned.
+ */
+void *frame_stack_alloc(size_t size)
+{
+    // Never hand out an empty allocation: releasing it must not look like emptying its block.
+    size = size == 0 ? 16 : (size + 15) & ~(size_t) 15;
+    FrameStackBlock *block = frame_stack_block_count > 0 ? &frame_stack_blocks[frame_stack_current] : NULL;
+    if (!block || block->used + size > block->size)
+    {
+        if (block)
+            frame_stack_current++;
+        if (frame_stack_current >= frame_stack_block_count)
+        {
+            frame_stack_blocks = realloc(frame_stack_blocks, (frame_stack_block_count + 1) * sizeof(FrameStackBlock));
+            if (!frame_stack_blocks)
+            {
+                fprintf(stderr, "Fatal: Memory allocation failed for frame stack.\n");
+                exit(1);
+            }
+            frame_stack_blocks[frame_stack_block_count++] = (FrameStackBlock){NULL, 0, 0};
+        }
+        block = &frame_stack_blocks[frame_stack_current];
+        if (block->size < size)
+        {
+            free(block->base);
+            block->size = size > FRAME_STACK_BLOCK_SIZE ? size : FRAME_STACK_BLOCK_SIZE;
+            block->base = malloc(block->size);
+            if (!block->base)
+            {
+                fprintf(stderr, "Fatal: Memory allocation failed for frame stack.\n");
+                exit(1);
+            }
+        }
+        block->used = 0;
+    }
+    void *memory = block->base + block->used;
+    block->used += size;
+    return memory;
+}
+
+/**
+ * @brief Releases an allocation of the frame stack and everything allocated after it.
+ */
+void frame_stack_release(void *memory)
+{
+    FrameStackBlock *block = &frame_stack_blocks[frame_stack_current];
+    block->used = (size_t) ((char *) memory - block->base);
+    if (block->used == 0 && frame_stack_current > 0)
+        frame_stack_current--;
+}
+
+/**
+ * @brief Allocates a frame on the frame stack, with all slots initialized to void.
+ *
+ * The frame is not a GC object: it is traced through `active_frames` while it runs and must be
+ * released with `frame_stack_release` when the call returns.
+ */
+static Env *stack_env_new(int slot_count, Env *enclosing)
+{
+    Env *env = (Env *) frame_stack_alloc(sizeof(Env) + slot_count * sizeof(Value));
+    env->obj.type = OBJ_STACK_ENV;
+    env->obj.is_marked = 0;
+    env->obj.next = NULL;
+    env->enclosing = enclosing;
+    env->slot_count = slot_count;
+    for (int i = 0; i < slot_count; i++)
+        env->slots[i] = (Value){VAL_VOID};
+
+#ifdef DEBUG_TRACE_ENVIRONMENT_ADV
+    printf("[ENV_ADV] New stack frame %p with %d slots, enclosing %p\n", (void *) env, slot_count, (void *) enclosing);
+#endif
+    return env;
+}
+
+/**
+ * @brief A call made in tail position, waiting for the running `call_function` to make it.
+ *
+ * `return f(...)` does not call f from inside the returning function: it records the call here
+ * and returns VAL_TAIL_CALL, which unwinds to `call_function`, where f runs in place of the
+ * call that returned. Long chains of tail calls therefore keep the C stack and the frame stack
+ * flat. The receiver and arguments are GC roots until the call is made.
+ */
+static struct
+{
+    Func *func; // NULL when no call is waiting
+    Value this_val;
+    Value *args;
+    int arg_count;
+    int capacity;
+} tail_call = {NULL};
+
+/**
+ * @brief Abandons every running frame (used after the REPL recovers from an error).
+ */
+void reset_call_stack()
+{
+    active_frame_count = 0;
+    tail_call.func = NULL;
+    for (int i = 0; i < frame_stack_block_count; i++)
+        frame_stack_blocks[i].used = 0;
+    frame_stack_current = 0;
+    gc_reset_roots();
+    vm_reset();
+}
+
+/**
+ * @brief Returns the frame `depth` levels up the chain of enclosing frames.
+ */
+static Env *env_ancestor(Env *env, int depth)
+{
+    while (depth-- > 0)
+        env = env->enclosing;
+    return env;
 }
 
+// --- Globals ---
+
+/**
+ * @brief An entry in the global table.
+ */
+typedef struct
+{
+    char *name;
+    Value value;
+    int is_defined; // The resolver creates entries before the variable is declared
+} GlobalVar;
+
+static GlobalVar *globals = NULL;
+static int global_count = 0;
+static int global_capacity = 0;
+static HashMap *global_slots = NULL; // Name -> index into `globals`
+
 /**
- * @brief Defines a new variable in the current environment.
+ * @brief Returns the global table index for a name, creating an undefined entry if needed.
+ *
+ * Called by the resolver; entries persist across REPL inputs.
  *
- * @param env_ptr Pointer to the environment pointer.
- * @param name The name of the variable.
- * @param val The value of the variable.
+ * @param name The variable name.
+ * @return The index of the entry.
  */
-void env_define(Env **env_ptr, const char *name, Value val)
+int global_slot(const char *name)
+{
+    if (!global_slots)
+        global_slots = hashmap_create(VAL_STRING, VAL_INT);
+
+    ObjString *key = copy_string(name, (int) strlen(name));
+    Value existing = hashmap_get(global_slots, key);
+    if (existing.type == VAL_INT)
+        return existing.int_val;
+
+    if (global_count >= global_capacity)
+    {
+        global_capacity = global_capacity == 0 ? 64 : global_capacity * 2;
+        globals = realloc(globals, global_capacity * sizeof(GlobalVar));
+        if (!globals)
+        {
+            fprintf(stderr, "Fatal: Memory allocation failed for global table.\n");
+            exit(1);
+        }
+    }
+    globals[global_count].name = strdup(name);
+    globals[global_count].value = (Value){VAL_VOID};
+    globals[global_count].is_defined = 0;
+
+    Value index;
+    index.type = VAL_INT;
+    index.int_val = global_count;
+    hashmap_set(global_slots, key, index, 0);
+    return global_count++;
+}
+
+void global_define(int slot, Value val)
 {
 #ifdef DEBUG_TRACE_ENVIRONMENT
-    printf("[ENV] Defining variable '%s'\n", name);
+    printf("[ENV] Defining global '%s'\n", globals[slot].name);
 #endif
-#ifdef DEBUG_TRACE_ENVIRONMENT_ADV
-    printf("[ENV_ADV] Defining '%s' with type %s in env %p\n", name, get_value_type_name(val.type), (void *) *env_ptr);
+    globals[slot].value = val;
+    globals[slot].is_defined = 1;
+}
+
+void define_global(const char *name, Value val)
+{
+    global_define(global_slot(name), val);
+}
+
+Value global_get(int slot, int line)
+{
+    if (!globals[slot].is_defined)
+        report_error(line, "Undefined variable '%s'.", globals[slot].name);
+    return globals[slot].value;
+}
+
+Value global_peek(int slot)
+{
+    return globals[slot].is_defined ? globals[slot].value : (Value){VAL_VOID};
+}
+
+void global_assign(int slot, Value val, int line)
+{
+    if (!globals[slot].is_defined)
+        report_error(line, "Undefined variable '%s'.", globals[slot].name);
+    globals[slot].value = val;
+}
+
+void mark_interpreter_roots()
+{
+    mark_object((ObjHeader *) global_slots);
+    mark_object((ObjHeader *) init_string);
+    for (int i = 0; i < global_count; i++)
+        mark_value(globals[i].value);
+    for (int i = 0; i < active_frame_count; i++)
+        mark_object((ObjHeader *) active_frames[i]);
+    if (tail_call.func)
+    {
+        mark_object((ObjHeader *) tail_call.func);
+        mark_value(tail_call.this_val);
+        for (int i = 0; i < tail_call.arg_count; i++)
+            mark_value(tail_call.args[i]);
+    }
+}
+
+// --- Variable Access ---
+
+/**
+ * @brief Defines the variable introduced by a declaration node.
+ *
+ * @param env The current frame.
+ * @param decl The declaring node, annotated by the resolver.
+ * @param val The initial value.
+ */
+void env_define(Env *env, ASTNode *decl, Value val)
+{
+#ifdef DEBUG_TRACE_ENVIRONMENT
+    printf("[ENV] Defining variable '%s'\n", decl->value);
 #endif
 #ifdef DEBUG_DEEP_DIVE_INTERP
-    printf("[DDI_ENV] Defining variable '%s'\n", name);
+    printf("[DDI_ENV] Defining variable '%s'\n", decl->value);
 #endif
 
-    // Use GC allocator for Env nodes
-    Env *new_entry = (Env *) allocate_obj(sizeof(Env), OBJ_ENV);
-    new_entry->name = strdup(name);
-    new_entry->val = value_copy(val);
-    new_entry->next = *env_ptr;
-    *env_ptr = new_entry;
+    if (decl->depth == SCOPE_GLOBAL)
+        global_define(decl->slot, val);
+    else
+        env->slots[decl->slot] = val;
 }
 
 /**
  * @brief Assigns a value to an existing variable.
  *
- * Searches the current environment chain and then the global environment.
- *
- * @param env The current environment.
- * @param name The name of the variable.
+ * @param env The current frame.
+ * @param ref The AST_VAR_REF node being assigned to.
  * @param val The new value.
- * @param line The line number for error reporting.
  */
-void env_assign(Env *env, const char *name, Value val, int line)
+void env_assign(Env *env, ASTNode *ref, Value val)
 {
 #ifdef DEBUG_TRACE_ENVIRONMENT
-    printf("[ENV] Assigning to variable '%s'\n", name);
-#endif
-#ifdef DEBUG_TRACE_ENVIRONMENT_ADV
-    printf("[ENV_ADV] Assigning '%s' with type %s in env %p\n", name, get_value_type_name(val.type), (void *) env);
+    printf("[ENV] Assigning to variable '%s'\n", ref->value);
 #endif
 #ifdef DEBUG_DEEP_DIVE_INTERP
-    printf("[DDI_ENV] Assigning variable '%s'\n", name);
+    printf("[DDI_ENV] Assigning variable '%s'\n", ref->value);
 #endif
 
-    while (env)
-    {
-        if (strcmp(env->name, name) == 0)
-        {
-            env->val = value_copy(val);
-            return;
-        }
-        env = env->next;
-    }
-    Env *g = global_env;
-    while (g)
-    {
-        if (strcmp(g->name, name) == 0)
-        {
-            g->val = value_copy(val);
-            return;
-        }
-        g = g->next;
-    }
-    report_error(line, "Undefined variable '%s'.", name);
+    if (ref->depth == SCOPE_GLOBAL)
+        global_assign(ref->slot, val, ref->line_num);
+    else
+        env_ancestor(env, ref->depth)->slots[ref->slot] = val;
 }
 
 /**
  * @brief Retrieves the value of a variable.
  *
- * Searches the current environment chain and then the global environment.
- *
- * @param env The current environment.
- * @param name The name of the variable.
- * @param line The line number for error reporting.
+ * @param env The current frame.
+ * @param ref The AST_VAR_REF node being read.
  * @return The value of the variable.
  */
-Value env_get(Env *env, const char *name, int line)
+Value env_get(Env *env, ASTNode *ref)
 {
 #ifdef DEBUG_TRACE_ENVIRONMENT
-    printf("[ENV] Getting variable '%s'\n", name);
-#endif
-#ifdef DEBUG_TRACE_ENVIRONMENT_ADV
-    printf("[ENV_ADV] Getting '%s' from env %p\n", name, (void *) env);
+    printf("[ENV] Getting variable '%s'\n", ref->value);
 #endif
 #ifdef DEBUG_DEEP_DIVE_INTERP
-    printf("[DDI_ENV] Getting variable '%s'\n", name);
+    printf("[DDI_ENV] Getting variable '%s'\n", ref->value);
 #endif
 
-    while (env)
-    {
-        if (strcmp(env->name, name) == 0)
-            return env->val;
-        env = env->next;
-    }
-    Env *g = global_env;
-    while (g)
-    {
-        if (strcmp(g->name, name) == 0)
-            return g->val;
-        g = g->next;
-    }
-    report_error(line, "Undefined variable '%s'.", name);
-    return (Value){VAL_VOID};
+    if (ref->depth == SCOPE_GLOBAL)
+        return global_get(ref->slot, ref->line_num);
+    return env_ancestor(env, ref->depth)->slots[ref->slot];
 }
 
+
 const char *get_value_type_name(ValueType type)
 {
     switch (type)
@@ -331,6 +818,8 @@ const char *get_value_type_name(ValueType type)
             return "list";
         case VAL_HASHMAP:
             return "hashmap";
+        case VAL_STRING_BUILDER:
+            return "StringBuilder";
         default:
             return "unknown";
     }
@@ -343,7 +832,7 @@ void print_value(Value v)
     else if (v.type == VAL_FLOAT)
         printf("%f", v.float_val);
     else if (v.type == VAL_STRING)
-        printf("%s", v.str_val);
+        fwrite(v.string->chars, 1, v.string->length, stdout);
     else if (v.type == VAL_BOOL)
         printf("%s", v.int_val ? "true" : "false");
     else if (v.type == VAL_FUNC)
@@ -360,6 +849,8 @@ void print_value(Value v)
         printf("<instance of %s>", v.instance->pith_class->name);
     else if (v.type == VAL_BOUND_METHOD)
         printf("<bound method>");
+    else if (v.type == VAL_STRING_BUILDER)
+        fwrite(v.builder->chars, 1, v.builder->length, stdout);
     else if (v.type == VAL_LIST)
     {
         printf("[");
@@ -375,18 +866,17 @@ void print_value(Value v)
     {
         printf("{");
         int first = 1;
-        for (int i = 0; i < v.hashmap->bucket_count; i++)
+        for (int i = 0; i < v.hashmap->capacity; i++)
         {
-            MapEntry *entry = v.hashmap->buckets[i];
-            while (entry)
-            {
-                if (!first)
-                    printf(", ");
-                printf("%s: ", entry->key);
-                print_value(entry->value);
-                first = 0;
-                entry = entry->next;
-            }
+            MapEntry *entry = &v.hashmap->entries[i];
+            if (!entry->key)
+                continue;
+            if (!first)
+                printf(", ");
+            fwrite(entry->key->chars, 1, entry->key->length, stdout);
+            printf(": ");
+            print_value(entry->value);
+            first = 0;
         }
         printf("}");
     }
@@ -426,7 +916,7 @@ Value native_input(int arg_count, Value *args)
     buffer[strcspn(buffer, "\n")] = 0;
     Value v;
     v.type = VAL_STRING;
-    v.str_val = strdup(buffer);
+    v.string = copy_string(buffer, (int) strlen(buffer));
     return v;
 }
 
@@ -516,21 +1006,29 @@ Value native_len(int arg_count, Value *args)
     printf("[DDI_NATIVE_METHOD] Calling len()\n");
 #endif
     if (arg_count != 1)
-        report_error(0, "len() takes no arguments.");
+        report_error(get_exec_error_line(), "len() takes no arguments.");
     Value self = args[0];
     Value v;
     v.type = VAL_INT;
     if (self.type == VAL_STRING)
     {
-        v.int_val = strlen(self.str_val);
+        v.int_val = self.string->length;
     }
     else if (self.type == VAL_LIST)
     {
         v.int_val = self.list->count;
     }
+    else if (self.type == VAL_STRING_BUILDER)
+    {
+        v.int_val = self.builder->length;
+    }
+    else if (self.type == VAL_HASHMAP)
+    {
+        v.int_val = self.hashmap->count;
+    }
     else
     {
-        report_error(0, "len() can only be called on a string or a list.");
+        report_error(get_exec_error_line(), "len() can only be called on a string, a list, a hashmap or a StringBuilder.");
     }
     return v;
 }
@@ -634,14 +1132,16 @@ Value native_io_read_file(int arg_count, Value *args)
     {
         report_error(0, "read_file() takes exactly one string argument (the path).");
     }
-    char *content = read_file_content(args[0].str_val);
+    long length;
+    char *content = read_file_bytes(string_chars(args[0].string), &length);
     if (content == NULL)
     {
         return (Value){VAL_VOID};
     }
     Value v;
     v.type = VAL_STRING;
-    v.str_val = content;
+    v.string = copy_string(content, (int) length);
+    free(content);
     return v;
 }
 
@@ -651,7 +1151,7 @@ Value native_io_write_file(int arg_count, Value *args)
     {
         report_error(0, "write_file() takes two string arguments (path, content).");
     }
-    FILE *file = fopen(args[0].str_val, "w");
+    FILE *file = fopen(string_chars(args[0].string), "w");
     if (file == NULL)
     {
         Value v;
@@ -659,7 +1159,7 @@ Value native_io_write_file(int arg_count, Value *args)
         v.int_val = 0;
         return v;
     }
-    fprintf(file, "%s", args[1].str_val);
+    fwrite(args[1].string->chars, 1, args[1].string->length, file);
     fclose(file);
     Value v;
     v.type = VAL_BOOL;
@@ -687,7 +1187,7 @@ Value native_integer_fromString(int arg_count, Value *args)
     }
     Value v;
     v.type = VAL_INT;
-    v.int_val = atoi(args[0].str_val);
+    v.int_val = atoi(string_chars(args[0].string));
     return v;
 }
 
@@ -701,7 +1201,7 @@ Value native_integer_toString(int arg_count, Value *args)
     snprintf(buffer, sizeof(buffer), "%d", args[0].int_val);
     Value v;
     v.type = VAL_STRING;
-    v.str_val = strdup(buffer);
+    v.string = copy_string(buffer, (int) strlen(buffer));
     return v;
 }
 
@@ -719,22 +1219,18 @@ Value native_string_trim(int arg_count, Value *args)
     if (args[0].type != VAL_STRING)
         report_error(0, "trim() must be called on a string.");
 
-    char *original = args[0].str_val;
-    char *start = original;
-    while (isspace(*start))
+    ObjString *original = args[0].string;
+    int start = 0;
+    while (start < original->length && isspace((unsigned char) original->chars[start]))
         start++;
 
-    char *end = original + strlen(original) - 1;
-    while (end > start && isspace(*end))
+    int end = original->length;
+    while (end > start && isspace((unsigned char) original->chars[end - 1]))
         end--;
 
-    char *new_str = malloc(end - start + 2);
-    strncpy(new_str, start, end - start + 1);
-    new_str[end - start + 1] = '\0';
-
     Value v;
     v.type = VAL_STRING;
-    v.str_val = new_str;
+    v.string = copy_substring(original, start, end - start);
     return v;
 }
 
@@ -758,57 +1254,51 @@ Value native_string_split(int arg_count, Value *args)
     list->items = malloc(list->capacity * sizeof(Value));
     gc_push_root((ObjHeader *) list);
 
-    const char *str = args[0].str_val;
-    const char *delim = args[1].str_val;
-    size_t delim_len = strlen(delim);
+    // Tokens are substrings of the receiver (see copy_substring). Its characters can move when
+    // a token is allocated, so positions are kept as offsets.
+    ObjString *str = args[0].string;
+    ObjString *delim = args[1].string;
 
-    if (delim_len == 0)
+    if (delim->length == 0)
     {
 #ifdef DEBUG_TRACE_NATIVE
         printf("[NATIVE_SPLIT] Delimiter is empty, returning list of characters.\n");
 #endif
-        for (int i = 0; str[i] != '\0'; i++)
+        for (int i = 0; i < str->length; i++)
         {
-            char *char_str = malloc(2);
-            char_str[0] = str[i];
-            char_str[1] = '\0';
             Value val;
             val.type = VAL_STRING;
-            val.str_val = char_str;
+            val.string = copy_substring(str, i, 1);
             list_add(list, val);
         }
     }
     else
     {
-        const char *current_pos = str;
+        int current_pos = 0;
         const char *found_pos;
-        while ((found_pos = strstr(current_pos, delim)) != NULL)
+        while ((found_pos = find_substring(str->chars + current_pos, str->length - current_pos, delim->chars,
+                                           delim->length)) != NULL)
         {
-            size_t len = found_pos - current_pos;
-            char *token = malloc(len + 1);
-            strncpy(token, current_pos, len);
-            token[len] = '\0';
-
+            int found = (int) (found_pos - str->chars);
             Value val;
             val.type = VAL_STRING;
-            val.str_val = token;
+            val.string = copy_substring(str, current_pos, found - current_pos);
             list_add(list, val);
 
 #ifdef DEBUG_TRACE_NATIVE
-            printf("[NATIVE_SPLIT] Found token: '%s'\n", token);
+            printf("[NATIVE_SPLIT] Found token: '%.*s'\n", val.string->length, val.string->chars);
 #endif
 
-            current_pos = found_pos + delim_len;
+            current_pos = found + delim->length;
         }
 
         // Add the last token
-        char *last_token = strdup(current_pos);
         Value val;
         val.type = VAL_STRING;
-        val.str_val = last_token;
+        val.string = copy_substring(str, current_pos, str->length - current_pos);
         list_add(list, val);
 #ifdef DEBUG_TRACE_NATIVE
-        printf("[NATIVE_SPLIT] Found last token: '%s'\n", last_token);
+        printf("[NATIVE_SPLIT] Found last token: '%.*s'\n", val.string->length, val.string->chars);
 #endif
     }
 
@@ -832,16 +1322,16 @@ Value native_string_upper(int arg_count, Value *args)
     if (args[0].type != VAL_STRING)
         report_error(0, "upper() must be called on a string.");
 
-    char *original = args[0].str_val;
-    char *new_str = strdup(original);
-    for (int i = 0; new_str[i]; i++)
+    ObjString *original = args[0].string;
+    ObjString *new_str = allocate_string(original->length);
+    for (int i = 0; i < original->length; i++)
     {
-        new_str[i] = toupper(new_str[i]);
+        new_str->chars[i] = toupper(original->chars[i]);
     }
 
     Value v;
     v.type = VAL_STRING;
-    v.str_val = new_str;
+    v.string = intern_string(new_str);
     return v;
 }
 
@@ -858,16 +1348,16 @@ Value native_string_lower(int arg_count, Value *args)
     if (args[0].type != VAL_STRING)
         report_error(0, "lower() must be called on a string.");
 
-    char *original = args[0].str_val;
-    char *new_str = strdup(original);
-    for (int i = 0; new_str[i]; i++)
+    ObjString *original = args[0].string;
+    ObjString *new_str = allocate_string(original->length);
+    for (int i = 0; i < original->length; i++)
     {
-        new_str[i] = tolower(new_str[i]);
+        new_str->chars[i] = tolower(original->chars[i]);
     }
 
     Value v;
     v.type = VAL_STRING;
-    v.str_val = new_str;
+    v.string = intern_string(new_str);
     return v;
 }
 
@@ -884,12 +1374,12 @@ Value native_string_startswith(int arg_count, Value *args)
     if (args[0].type != VAL_STRING || args[1].type != VAL_STRING)
         report_error(0, "startswith() requires a string object and a string prefix.");
 
-    char *str = args[0].str_val;
-    char *prefix = args[1].str_val;
+    ObjString *str = args[0].string;
+    ObjString *prefix = args[1].string;
 
     Value v;
     v.type = VAL_BOOL;
-    v.int_val = (strncmp(prefix, str, strlen(prefix)) == 0);
+    v.int_val = prefix->length <= str->length && memcmp(str->chars, prefix->chars, prefix->length) == 0;
     return v;
 }
 
@@ -906,20 +1396,18 @@ Value native_string_endswith(int arg_count, Value *args)
     if (args[0].type != VAL_STRING || args[1].type != VAL_STRING)
         report_error(0, "endswith() requires a string object and a string suffix.");
 
-    char *str = args[0].str_val;
-    char *suffix = args[1].str_val;
-    int str_len = strlen(str);
-    int suffix_len = strlen(suffix);
+    ObjString *str = args[0].string;
+    ObjString *suffix = args[1].string;
 
     Value v;
     v.type = VAL_BOOL;
-    if (suffix_len > str_len)
+    if (suffix->length > str->length)
     {
         v.int_val = 0;
     }
     else
     {
-        v.int_val = (strcmp(str + str_len - suffix_len, suffix) == 0);
+        v.int_val = memcmp(str->chars + str->length - suffix->length, suffix->chars, suffix->length) == 0;
     }
     return v;
 }
@@ -937,63 +1425,207 @@ Value native_string_contains(int arg_count, Value *args)
     if (args[0].type != VAL_STRING || args[1].type != VAL_STRING)
         report_error(0, "contains() requires a string object and a string substring.");
 
-    char *haystack = args[0].str_val;
-    char *needle = args[1].str_val;
+    ObjString *haystack = args[0].string;
+    ObjString *needle = args[1].string;
 
     Value v;
     v.type = VAL_BOOL;
-    v.int_val = (strstr(haystack, needle) != NULL);
+    v.int_val = find_substring(haystack->chars, haystack->length, needle->chars, needle->length) != NULL;
     return v;
 }
 
-Value native_list_join(int arg_count, Value *args)
+Value native_string_find(int arg_count, Value *args)
 {
 #ifdef DEBUG_TRACE_NATIVE
-    printf("[NATIVE] Calling list.join()\n");
+    printf("[NATIVE] Calling string.find()\n");
 #endif
 #ifdef DEBUG_DEEP_DIVE_INTERP
-    printf("[DDI_NATIVE_METHOD] Calling list.join()\n");
+    printf("[DDI_NATIVE_METHOD] Calling string.find()\n");
 #endif
     if (arg_count != 2)
-        report_error(0, "join() takes exactly one argument (the delimiter).");
-    if (args[0].type != VAL_LIST || args[1].type != VAL_STRING)
-        report_error(0, "join() requires a list object and a string delimiter.");
+        report_error(0, "find() takes exactly one argument (the substring).");
+    if (args[0].type != VAL_STRING || args[1].type != VAL_STRING)
+        report_error(0, "find() requires a string object and a string substring.");
 
-    List *list = args[0].list;
-    char *delim = args[1].str_val;
+    ObjString *haystack = args[0].string;
+    ObjString *needle = args[1].string;
+    const char *found = find_substring(haystack->chars, haystack->length, needle->chars, needle->length);
 
-    if (list->count == 0)
-    {
-        Value v;
-        v.type = VAL_STRING;
-        v.str_val = strdup("");
-        return v;
-    }
+    Value v;
+    v.type = VAL_INT;
+    v.int_val = found ? (int) (found - haystack->chars) : -1;
+    return v;
+}
 
-    size_t total_len = 0;
+Value native_string_count(int arg_count, Value *args)
+{
+#ifdef DEBUG_TRACE_NATIVE
+    printf("[NATIVE] Calling string.count()\n");
+#endif
+#ifdef DEBUG_DEEP_DIVE_INTERP
+    printf("[DDI_NATIVE_METHOD] Calling string.count()\n");
+#endif
+    if (arg_count != 2)
+        report_error(0, "count() takes exactly one argument (the substring).");
+    if (args[0].type != VAL_STRING || args[1].type != VAL_STRING)
+        report_error(0, "count() requires a string object and a string substring.");
+
+    ObjString *haystack = args[0].string;
+    ObjString *needle = args[1].string;
+
+    Value v;
+    v.type = VAL_INT;
+    if (needle->length == 0)
+    {
+        // The empty string occurs before every character and at the end.
+        v.int_val = haystack->length + 1;
+        return v;
+    }
+    v.int_val = 0;
+    const char *end = haystack->chars + haystack->length;
+    const char *found = haystack->chars;
+    while ((found = find_substring(found, (int) (end - found), needle->chars, needle->length)) != NULL)
+    {
+        v.int_val++;
+        found += needle->length;
+    }
+    return v;
+}
+
+Value native_string_replace(int arg_count, Value *args)
+{
+#ifdef DEBUG_TRACE_NATIVE
+    printf("[NATIVE] Calling string.replace()\n");
+#endif
+#ifdef DEBUG_DEEP_DIVE_INTERP
+    printf("[DDI_NATIVE_METHOD] Calling string.replace()\n");
+#endif
+    if (arg_count != 3)
+        report_error(0, "replace() takes exactly two arguments (old, new).");
+    if (args[0].type != VAL_STRING || args[1].type != VAL_STRING || args[2].type != VAL_STRING)
+        report_error(0, "replace() requires a string object and string old and new substrings.");
+
+    ObjString *str = args[0].string;
+    ObjString *old_str = args[1].string;
+    ObjString *new_str = args[2].string;
+
+    Value v;
+    v.type = VAL_STRING;
+    v.string = str;
+    if (old_str->length == 0)
+        return v;
+
+    int count = 0;
+    const char *end = str->chars + str->length;
+    const char *found = str->chars;
+    while ((found = find_substring(found, (int) (end - found), old_str->chars, old_str->length)) != NULL)
+    {
+        count++;
+        found += old_str->length;
+    }
+    if (count == 0)
+        return v;
+
+    long long total_len = str->length + (long long) count * (new_str->length - old_str->length);
+    if (total_len > INT_MAX)
+        report_error(0, "replace() result is too long.");
+
+    // The receiver's characters can move when the result is allocated (see copy_substring), so
+    // the occurrences are found again afterwards.
+    ObjString *result = allocate_string((int) total_len);
+    char *out = result->chars;
+    const char *pos = str->chars;
+    end = str->chars + str->length;
+    while ((found = find_substring(pos, (int) (end - pos), old_str->chars, old_str->length)) != NULL)
+    {
+        memcpy(out, pos, found - pos);
+        out += found - pos;
+        memcpy(out, new_str->chars, new_str->length);
+        out += new_str->length;
+        pos = found + old_str->length;
+    }
+    memcpy(out, pos, end - pos);
+
+    v.string = intern_string(result);
+    return v;
+}
+
+Value native_string_substring(int arg_count, Value *args)
+{
+#ifdef DEBUG_TRACE_NATIVE
+    printf("[NATIVE] Calling string.substring()\n");
+#endif
+#ifdef DEBUG_DEEP_DIVE_INTERP
+    printf("[DDI_NATIVE_METHOD] Calling string.substring()\n");
+#endif
+    if (arg_count != 3)
+        report_error(0, "substring() takes exactly two arguments (start, end).");
+    if (args[0].type != VAL_STRING || args[1].type != VAL_INT || args[2].type != VAL_INT)
+        report_error(0, "substring() requires a string object and int start and end indices.");
+
+    ObjString *str = args[0].string;
+    int start = args[1].int_val;
+    int end = args[2].int_val;
+    if (start < 0 || end < start || end > str->length)
+        report_error(0, "substring(%d, %d) is out of range for a string of length %d.", start, end, str->length);
+
+    Value v;
+    v.type = VAL_STRING;
+    v.string = copy_substring(str, start, end - start);
+    return v;
+}
+
+Value native_list_join(int arg_count, Value *args)
+{
+#ifdef DEBUG_TRACE_NATIVE
+    printf("[NATIVE] Calling list.join()\n");
+#endif
+#ifdef DEBUG_DEEP_DIVE_INTERP
+    printf("[DDI_NATIVE_METHOD] Calling list.join()\n");
+#endif
+    if (arg_count != 2)
+        report_error(get_exec_error_line(), "join() takes exactly one argument (the delimiter).");
+    if (args[0].type != VAL_LIST || args[1].type != VAL_STRING)
+        report_error(get_exec_error_line(), "join() requires a list object and a string delimiter.");
+
+    List *list = args[0].list;
+    ObjString *delim = args[1].string;
+
+    if (list->count == 0)
+    {
+        Value v;
+        v.type = VAL_STRING;
+        v.string = copy_string("", 0);
+        return v;
+    }
+
+    long long total_len = (long long) delim->length * (list->count - 1);
     for (int i = 0; i < list->count; i++)
     {
         if (list->items[i].type != VAL_STRING)
-            report_error(0, "join() can only be called on a list of strings.");
-        total_len += strlen(list->items[i].str_val);
+            report_error(get_exec_error_line(), "join() can only be called on a list of strings.");
+        total_len += list->items[i].string->length;
     }
-    total_len += strlen(delim) * (list->count - 1);
-
-    char *result_str = malloc(total_len + 1);
-    result_str[0] = '\0';
+    if (total_len > INT_MAX)
+        report_error(get_exec_error_line(), "join() result is too long.");
 
+    // Each part is copied once, at the end of what has been written so far.
+    ObjString *result = allocate_string((int) total_len);
+    char *end = result->chars;
     for (int i = 0; i < list->count; i++)
     {
-        strcat(result_str, list->items[i].str_val);
-        if (i < list->count - 1)
+        if (i > 0)
         {
-            strcat(result_str, delim);
+            memcpy(end, delim->chars, delim->length);
+            end += delim->length;
         }
+        memcpy(end, list->items[i].string->chars, list->items[i].string->length);
+        end += list->items[i].string->length;
     }
 
     Value v;
     v.type = VAL_STRING;
-    v.str_val = result_str;
+    v.string = intern_string(result);
     return v;
 }
 
@@ -1105,6 +1737,146 @@ Value native_list_clear(int arg_count, Value *args)
     return (Value){VAL_VOID};
 }
 
+// --- Map Native Functions ---
+
+Value native_map_remove(int arg_count, Value *args)
+{
+#ifdef DEBUG_TRACE_NATIVE
+    printf("[NATIVE] Calling map.remove()\n");
+#endif
+#ifdef DEBUG_DEEP_DIVE_INTERP
+    printf("[DDI_NATIVE_METHOD] Calling map.remove()\n");
+#endif
+    if (arg_count != 2)
+        report_error(0, "remove() takes exactly one argument (the key).");
+    if (args[0].type != VAL_HASHMAP || args[1].type != VAL_STRING)
+        report_error(0, "remove() requires a hashmap object and a string key.");
+
+    Value v;
+    v.type = VAL_BOOL;
+    v.int_val = hashmap_delete(args[0].hashmap, args[1].string);
+    return v;
+}
+
+// --- StringBuilder Native Functions ---
+
+/**
+ * @brief Copies characters to the end of a builder, doubling its buffer as needed.
+ */
+static void builder_append(StringBuilder *builder, const char *chars, int length)
+{
+    if (length == 0)
+        return;
+    if (length > INT_MAX - builder->length)
+        report_error(get_exec_error_line(), "StringBuilder contents are too long.");
+    if (builder->length + length > builder->capacity)
+    {
+        long long capacity = builder->capacity < 16 ? 16 : builder->capacity;
+        while (capacity < builder->length + length)
+            capacity *= 2;
+        if (capacity > INT_MAX)
+            capacity = INT_MAX;
+        builder->chars = realloc(builder->chars, (size_t) capacity);
+        if (!builder->chars)
+        {
+            fprintf(stderr, "Fatal: Memory allocation failed for StringBuilder.\n");
+            exit(1);
+        }
+        // The buffer paces the GC; no collection runs here, so `chars` stays valid.
+        gc_track_bytes((size_t) capacity - builder->capacity);
+        builder->capacity = (int) capacity;
+    }
+    memcpy(builder->chars + builder->length, chars, length);
+    builder->length += length;
+}
+
+/**
+ * @brief Appends a string, or an int, float or bool written as `print` writes it.
+ */
+static void builder_append_value(StringBuilder *builder, Value value, const char *method)
+{
+    char buffer[64];
+    int length;
+    switch (value.type)
+    {
+        case VAL_STRING:
+            builder_append(builder, value.string->chars, value.string->length);
+            return;
+        case VAL_INT:
+            length = snprintf(buffer, sizeof(buffer), "%d", value.int_val);
+            break;
+        case VAL_FLOAT:
+            length = snprintf(buffer, sizeof(buffer), "%f", value.float_val);
+            break;
+        case VAL_BOOL:
+            length = snprintf(buffer, sizeof(buffer), "%s", value.int_val ? "true" : "false");
+            break;
+        default:
+            report_error(get_exec_error_line(), "%s() cannot append a value of type '%s'.", method,
+                         get_value_type_name(value.type));
+            return;
+    }
+    builder_append(builder, buffer, length);
+}
+
+Value native_string_builder(int arg_count, Value *args)
+{
+#ifdef DEBUG_TRACE_NATIVE
+    printf("[NATIVE] Calling StringBuilder()\n");
+#endif
+    if (arg_count > 1)
+        report_error(get_exec_error_line(), "StringBuilder() takes at most one argument (the initial contents).");
+    StringBuilder *builder = (StringBuilder *) allocate_obj(sizeof(StringBuilder), OBJ_STRING_BUILDER);
+    builder->chars = NULL;
+    builder->length = 0;
+    builder->capacity = 0;
+    if (arg_count == 1)
+        builder_append_value(builder, args[0], "StringBuilder");
+
+    Value v;
+    v.type = VAL_STRING_BUILDER;
+    v.builder = builder;
+    return v;
+}
+
+Value native_string_builder_append(int arg_count, Value *args)
+{
+#ifdef DEBUG_TRACE_NATIVE
+    printf("[NATIVE] Calling StringBuilder.append()\n");
+#endif
+    if (arg_count != 2)
+        report_error(get_exec_error_line(), "append() takes exactly one argument.");
+    builder_append_value(args[0].builder, args[1], "append");
+    return (Value){VAL_VOID};
+}
+
+Value native_string_builder_append_line(int arg_count, Value *args)
+{
+#ifdef DEBUG_TRACE_NATIVE
+    printf("[NATIVE] Calling StringBuilder.append_line()\n");
+#endif
+    if (arg_count > 2)
+        report_error(get_exec_error_line(), "append_line() takes at most one argument.");
+    if (arg_count == 2)
+        builder_append_value(args[0].builder, args[1], "append_line");
+    builder_append(args[0].builder, "\n", 1);
+    return (Value){VAL_VOID};
+}
+
+Value native_string_builder_build(int arg_count, Value *args)
+{
+#ifdef DEBUG_TRACE_NATIVE
+    printf("[NATIVE] Calling StringBuilder.build()\n");
+#endif
+    if (arg_count != 1)
+        report_error(get_exec_error_line(), "build() takes no arguments.");
+    StringBuilder *builder = args[0].builder;
+    Value v;
+    v.type = VAL_STRING;
+    v.string = copy_string(builder->length > 0 ? builder->chars : "", builder->length);
+    return v;
+}
+
 
 // Execution context for native error reporting
 static int current_exec_line = 0;
@@ -1119,19 +1891,20 @@ int get_exec_error_line()
     return current_exec_line;
 }
 
-void define_native_in_env(Env **env_ptr, const char *name, NativeFn function)
+void define_native(const char *name, NativeFn function)
 {
     Value v;
     v.type = VAL_NATIVE_FN;
     v.native_fn = function;
-    env_define(env_ptr, name, v);
+    define_global(name, v);
 }
 
-void define_all_natives_in_env(Env **env_ptr)
+void define_all_natives()
 {
-    define_native_in_env(env_ptr, "clock", native_clock);
-    define_native_in_env(env_ptr, "input", native_input);
-    define_native_in_env(env_ptr, "isinstance", native_isinstance);
+    define_native("clock", native_clock);
+    define_native("input", native_input);
+    define_native("isinstance", native_isinstance);
+    define_native("StringBuilder", native_string_builder);
 }
 
 void register_native_method(HashMap *method_map, const char *name, NativeFn function)
@@ -1139,7 +1912,25 @@ void register_native_method(HashMap *method_map, const char *name, NativeFn func
     Value method_val;
     method_val.type = VAL_NATIVE_FN;
     method_val.native_fn = function;
-    hashmap_set(method_map, name, method_val, 0);
+    hashmap_set(method_map, copy_string(name, (int) strlen(name)), method_val, 0);
+}
+
+/**
+ * @brief Creates the function table of a native module and registers it under `name`.
+ * @return The (empty) function table.
+ */
+static HashMap *register_native_module(const char *name)
+{
+    HashMap *funcs = hashmap_create(VAL_STRING, VAL_NATIVE_FN);
+    gc_push_root((ObjHeader *) funcs);
+
+    Value module_val;
+    module_val.type = VAL_HASHMAP;
+    module_val.hashmap = funcs;
+    hashmap_set(native_module_funcs, copy_string(name, (int) strlen(name)), module_val, 0);
+
+    gc_pop_root();
+    return funcs;
 }
 
 void register_all_native_methods()
@@ -1153,6 +1944,10 @@ void register_all_native_methods()
     register_native_method(native_string_methods, "startswith", native_string_startswith);
     register_native_method(native_string_methods, "endswith", native_string_endswith);
     register_native_method(native_string_methods, "contains", native_string_contains);
+    register_native_method(native_string_methods, "find", native_string_find);
+    register_native_method(native_string_methods, "count", native_string_count);
+    register_native_method(native_string_methods, "replace", native_string_replace);
+    register_native_method(native_string_methods, "substring", native_string_substring);
 
     native_list_methods = hashmap_create(VAL_STRING, VAL_NATIVE_FN);
     register_native_method(native_list_methods, "len", native_len);
@@ -1162,6 +1957,16 @@ void register_all_native_methods()
     register_native_method(native_list_methods, "remove", native_list_remove);
     register_native_method(native_list_methods, "insert", native_list_insert);
     register_native_method(native_list_methods, "clear", native_list_clear);
+
+    native_string_builder_methods = hashmap_create(VAL_STRING, VAL_NATIVE_FN);
+    register_native_method(native_string_builder_methods, "len", native_len);
+    register_native_method(native_string_builder_methods, "append", native_string_builder_append);
+    register_native_method(native_string_builder_methods, "append_line", native_string_builder_append_line);
+    register_native_method(native_string_builder_methods, "build", native_string_builder_build);
+
+    native_map_methods = hashmap_create(VAL_STRING, VAL_NATIVE_FN);
+    register_native_method(native_map_methods, "len", native_len);
+    register_native_method(native_map_methods, "remove", native_map_remove);
 }
 
 void register_all_native_modules()
@@ -1169,7 +1974,7 @@ void register_all_native_modules()
     native_module_funcs = hashmap_create(VAL_STRING, VAL_HASHMAP);
 
     // Math module
-    HashMap *math_funcs = hashmap_create(VAL_STRING, VAL_NATIVE_FN);
+    HashMap *math_funcs = register_native_module("math");
     register_native_method(math_funcs, "sqrt", native_math_sqrt);
     register_native_method(math_funcs, "sin", native_math_sin);
     register_native_method(math_funcs, "cos", native_math_cos);
@@ -1178,50 +1983,66 @@ void register_all_native_modules()
     register_native_method(math_funcs, "ceil", native_math_ceil);
     register_native_method(math_funcs, "log", native_math_log);
 
-    Value math_module_val;
-    math_module_val.type = VAL_HASHMAP;
-    math_module_val.hashmap = math_funcs;
-    hashmap_set(native_module_funcs, "math", math_module_val, 0);
-
     // IO module
-    HashMap *io_funcs = hashmap_create(VAL_STRING, VAL_NATIVE_FN);
+    HashMap *io_funcs = register_native_module("io");
     register_native_method(io_funcs, "read_file", native_io_read_file);
     register_native_method(io_funcs, "write_file", native_io_write_file);
 
-    Value io_module_val;
-    io_module_val.type = VAL_HASHMAP;
-    io_module_val.hashmap = io_funcs;
-    hashmap_set(native_module_funcs, "io", io_module_val, 0);
-
     // Sys module
-    HashMap *sys_funcs = hashmap_create(VAL_STRING, VAL_NATIVE_FN);
+    HashMap *sys_funcs = register_native_module("sys");
     register_native_method(sys_funcs, "exit", native_sys_exit);
 
-    Value sys_module_val;
-    sys_module_val.type = VAL_HASHMAP;
-    sys_module_val.hashmap = sys_funcs;
-    hashmap_set(native_module_funcs, "sys", sys_module_val, 0);
-
     // Integer module
-    HashMap *integer_funcs = hashmap_create(VAL_STRING, VAL_NATIVE_FN);
+    HashMap *integer_funcs = register_native_module("integer");
     register_native_method(integer_funcs, "fromString", native_integer_fromString);
     register_native_method(integer_funcs, "toString", native_integer_toString);
+}
+
+/**
+ * @brief Runs one iteration of a loop body, in a frame of its own if the loop defines closures.
+ *
+ * @param loop The loop node.
+ * @param body The body block.
+ * @param env The loop's frame.
+ * @param variable The foreach variable's value for this iteration, or NULL.
+ * @return The result of the block.
+ */
+Value exec_loop_body(ASTNode *loop, ASTNode *body, Env *env, const Value *variable)
+{
+    if (!body)
+        return (Value){VAL_VOID}; // A malformed loop, whose body a parse error left out
+    if (!loop->frame_captured)
+    {
+        if (variable)
+            env_define(env, loop, *variable);
+        return exec_block(body, env);
+    }
 
-    Value integer_module_val;
-    integer_module_val.type = VAL_HASHMAP;
-    integer_module_val.hashmap = integer_funcs;
-    hashmap_set(native_module_funcs, "integer", integer_module_val, 0);
+    Env *iteration = env_new(loop->slot_count, env);
+    gc_push_root((ObjHeader *) iteration);
+    if (variable)
+        env_define(iteration, loop, *variable);
+    Value result = exec_block(body, iteration);
+    gc_pop_root();
+    return result;
 }
 
 /**
- * @brief Executes a block of statements in a new scope.
+ * @brief Executes a block of statements.
+ *
+ * Block scoping is resolved statically (see resolver.c), so the statements run directly in
+ * the current frame.
  *
  * @param node The block AST node.
- * @param env_ptr Pointer to the current environment pointer.
+ * @param env The current frame.
  * @return The result of the block execution (e.g., return value).
  */
-Value exec_block(ASTNode *node, Env **env_ptr)
+Value exec_block(ASTNode *node, Env *env)
 {
+#ifndef DEBUG_NO_CLOSURE_COMPILER
+    ClosureNode *closure = node->closure ? node->closure : compile_block_closure(node);
+    return closure->fn(closure, env);
+#else
 #ifdef DEBUG_TRACE_EXECUTION
     printf("[EXEC] Entering new block scope.\n");
 #endif
@@ -1229,15 +2050,11 @@ Value exec_block(ASTNode *node, Env **env_ptr)
     printf("[DDI_BLOCK] Entering block scope.\n");
 #endif
 
-    Env *original_env = *env_ptr;
-    Env *block_env = original_env;
-
     for (int i = 0; i < node->children_count; i++)
     {
-        Value result = exec(node->children[i], &block_env);
+        Value result = exec(node->children[i], env);
         if (result.type != VAL_VOID)
         {
-            *env_ptr = original_env;
 #ifdef DEBUG_TRACE_EXECUTION
             printf("[EXEC] Exiting block scope (with return).\n");
 #endif
@@ -1248,7 +2065,6 @@ Value exec_block(ASTNode *node, Env **env_ptr)
         }
     }
 
-    *env_ptr = original_env;
 #ifdef DEBUG_TRACE_EXECUTION
     printf("[EXEC] Exiting block scope.\n");
 #endif
@@ -1256,29 +2072,86 @@ Value exec_block(ASTNode *node, Env **env_ptr)
     printf("[DDI_BLOCK] Exiting block scope.\n");
 #endif
     return (Value){VAL_VOID};
+#endif
+}
+
+// --- HashMap ---
+
+#define MAP_INITIAL_CAPACITY 8
+#define MAP_SLOT_EMPTY 0x00
+#define MAP_SLOT_DELETED 0x01
+#define MAP_TAG(hash) ((unsigned char) (0x80 | (((hash) >> 7) & 0x7f)))
+
+static void hashmap_alloc_slots(HashMap *map, int capacity)
+{
+    map->control = calloc(capacity, sizeof(unsigned char));
+    map->entries = calloc(capacity, sizeof(MapEntry));
+    if (!map->control || !map->entries)
+    {
+        fprintf(stderr, "Fatal: Memory allocation failed for hashmap.\n");
+        exit(1);
+    }
+    map->capacity = capacity;
 }
 
-unsigned long hash_string(const char *str)
+/**
+ * @brief Finds the slot holding `key`.
+ * @return The slot index, or -1 if the key is absent.
+ */
+static int hashmap_find(HashMap *map, ObjString *key)
 {
-    unsigned long hash = 5381;
-    int c;
-    while ((c = *str++))
-        hash = ((hash << 5) + hash) + c;
-    return hash;
+    unsigned char tag = MAP_TAG(key->hash);
+    int mask = map->capacity - 1;
+    // The load factor guarantees an empty slot, which ends every probe.
+    for (int i = (int) (key->hash & mask);; i = (i + 1) & mask)
+    {
+        unsigned char control = map->control[i];
+        if (control == MAP_SLOT_EMPTY)
+            return -1;
+        if (control == tag && map->entries[i].key == key)
+            return i;
+    }
+}
+
+/**
+ * @brief Moves every live entry into a fresh table of `capacity` slots, dropping tombstones.
+ */
+static void hashmap_resize(HashMap *map, int capacity)
+{
+    unsigned char *old_control = map->control;
+    MapEntry *old_entries = map->entries;
+    int old_capacity = map->capacity;
+
+    hashmap_alloc_slots(map, capacity);
+    map->tombstones = 0;
+    int mask = capacity - 1;
+    for (int i = 0; i < old_capacity; i++)
+    {
+        if (!old_entries[i].key)
+            continue;
+        int j = (int) (old_entries[i].key->hash & mask);
+        while (map->control[j] != MAP_SLOT_EMPTY)
+            j = (j + 1) & mask;
+        map->control[j] = old_control[i];
+        map->entries[j] = old_entries[i];
+    }
+    free(old_control);
+    free(old_entries);
 }
 
 HashMap *hashmap_create(ValueType key_type, ValueType value_type)
 {
     // Use GC allocator for HashMap
     HashMap *map = (HashMap *) allocate_obj(sizeof(HashMap), OBJ_MAP);
-    map->bucket_count = 16;
-    map->buckets = calloc(map->bucket_count, sizeof(MapEntry *));
+    hashmap_alloc_slots(map, MAP_INITIAL_CAPACITY);
+    map->count = 0;
+    map->tombstones = 0;
     map->key_type = key_type;
     map->value_type = value_type;
     return map;
 }
 
-void hashmap_set(HashMap *map, const char *key, Value value, int line_num)
+void hashmap_set(HashMap *map, ObjString *key, Value value, int line_num)
 {
     if (map->value_type != VAL_VOID && value.type != map->value_type)
     {
@@ -1287,43 +2160,61 @@ void hashmap_set(HashMap *map, const char *key, Value value, int line_num)
     }
 
 #ifdef DEBUG_TRACE_MEMORY
-    printf("[MEMORY] Set key '%s' in hashmap.\n", key);
+    printf("[MEMORY] Set key '%s' in hashmap.\n", key->chars);
 #endif
 #ifdef DEBUG_TRACE_ADVANCED_MEMORY
-    printf("[ADV_MEMORY] Setting key '%s' in hashmap at %p\n", key, (void *) map);
+    printf("[ADV_MEMORY] Setting key '%s' in hashmap at %p\n", key->chars, (void *) map);
 #endif
 
-    unsigned long hash = hash_string(key);
-    int index = hash % map->bucket_count;
-    MapEntry *entry = map->buckets[index];
-    while (entry)
+    int index = hashmap_find(map, key);
+    if (index >= 0)
     {
-        if (strcmp(entry->key, key) == 0)
-        {
-            entry->value = value;
-            return;
-        }
-        entry = entry->next;
+        map->entries[index].value = value;
+        return;
     }
-    MapEntry *new_entry = malloc(sizeof(MapEntry));
-    new_entry->key = strdup(key);
-    new_entry->value = value;
-    new_entry->next = map->buckets[index];
-    map->buckets[index] = new_entry;
-}
 
-Value hashmap_get(HashMap *map, const char *key)
-{
-    unsigned long hash = hash_string(key);
-    int index = hash % map->bucket_count;
-    MapEntry *entry = map->buckets[index];
-    while (entry)
+    if ((map->count + map->tombstones + 1) * 4 > map->capacity * 3)
     {
-        if (strcmp(entry->key, key) == 0)
-            return entry->value;
-        entry = entry->next;
+        // Double the table, unless tombstones take up the space: then rehashing is enough.
+        int capacity = (map->count + 1) * 2 > map->capacity ? map->capacity * 2 : map->capacity;
+        hashmap_resize(map, capacity);
     }
-    return (Value){VAL_VOID};
+
+    int mask = map->capacity - 1;
+    index = (int) (key->hash & mask);
+    while (map->control[index] != MAP_SLOT_EMPTY && map->control[index] != MAP_SLOT_DELETED)
+        index = (index + 1) & mask;
+    if (map->control[index] == MAP_SLOT_DELETED)
+        map->tombstones--;
+
+    map->control[index] = MAP_TAG(key->hash);
+    map->entries[index].key = key;
+    map->entries[index].value = value;
+    map->count++;
+}
+
+Value hashmap_get(HashMap *map, ObjString *key)
+{
+    int index = hashmap_find(map, key);
+    if (index < 0)
+        return (Value){VAL_VOID};
+    return map->entries[index].value;
+}
+
+int hashmap_delete(HashMap *map, ObjString *key)
+{
+    int index = hashmap_find(map, key);
+    if (index < 0)
+        return 0;
+
+    // Leave a tombstone so that probes for keys stored past this slot keep going.
+    MapEntry *entry = &map->entries[index];
+    entry->key = NULL;
+    entry->value = (Value){VAL_VOID};
+    map->control[index] = MAP_SLOT_DELETED;
+    map->count--;
+    map->tombstones++;
+    return 1;
 }
 
 ValueType get_type_from_name(const char *type_name)
@@ -1339,55 +2230,1108 @@ ValueType get_type_from_name(const char *type_name)
     return VAL_VOID; // Default/unknown
 }
 
+// --- Operators ---
+
 /**
- * @brief Evaluates an expression AST node.
- *
- * Handles literals, variable references, operations, function calls, etc.
- *
- * @param node The expression node.
- * @param env The current environment.
- * @return The result of the evaluation.
+ * @brief Number of operand types that operators are defined on (VAL_INT to VAL_BOOL).
  */
-Value eval(ASTNode *node, Env *env)
+#define OPERAND_TYPE_COUNT (VAL_BOOL + 1)
+
+typedef Value (*BinaryHandler)(Value left, Value right);
+
+static Value int_result(int value)
 {
-    if (!node)
-        return (Value){VAL_VOID};
+    Value v;
+    v.type = VAL_INT;
+    v.int_val = value;
+    return v;
+}
 
-#ifdef DEBUG_TRACE_EXECUTION
-    printf("[EXEC] Evaluating expression node type %d\n", node->type);
-#endif
-#ifdef DEBUG_DEEP_DIVE_INTERP
-    printf("[DDI_EVAL] Evaluating node type %d\n", node->type);
-#endif
+static Value float_result(double value)
+{
+    Value v;
+    v.type = VAL_FLOAT;
+    v.float_val = value;
+    return v;
+}
 
-    Value result;
+static Value bool_result(int value)
+{
+    Value v;
+    v.type = VAL_BOOL;
+    v.int_val = value;
+    return v;
+}
 
-    switch (node->type)
-    {
-        case AST_INT_LITERAL:
-        {
-            result.type = VAL_INT;
-            result.int_val = atoi(node->value);
-            break;
-        }
-        case AST_FLOAT_LITERAL:
-        {
-            result.type = VAL_FLOAT;
-            result.float_val = atof(node->value);
-            break;
-        }
-        case AST_STRING_LITERAL:
-        {
-            result.type = VAL_STRING;
-            result.str_val = strdup(node->value);
-            break;
+static double as_double(Value v)
+{
+    return v.type == VAL_INT ? v.int_val : v.float_val;
+}
+
+static Value int_add(Value l, Value r)
+{
+    return int_result(l.int_val + r.int_val);
+}
+
+static Value int_subtract(Value l, Value r)
+{
+    return int_result(l.int_val - r.int_val);
+}
+
+static Value int_multiply(Value l, Value r)
+{
+    return int_result(l.int_val * r.int_val);
+}
+
+static Value int_divide(Value l, Value r)
+{
+    return int_result(l.int_val / r.int_val);
+}
+
+static Value int_modulo(Value l, Value r)
+{
+    return int_result(l.int_val % r.int_val);
+}
+
+static Value int_power(Value l, Value r)
+{
+    return int_result((int) pow(l.int_val, r.int_val));
+}
+
+static Value int_less(Value l, Value r)
+{
+    return bool_result(l.int_val < r.int_val);
+}
+
+static Value int_greater(Value l, Value r)
+{
+    return bool_result(l.int_val > r.int_val);
+}
+
+static Value int_less_equal(Value l, Value r)
+{
+    return bool_result(l.int_val <= r.int_val);
+}
+
+static Value int_greater_equal(Value l, Value r)
+{
+    return bool_result(l.int_val >= r.int_val);
+}
+
+static Value int_equal(Value l, Value r)
+{
+    return bool_result(l.int_val == r.int_val);
+}
+
+static Value int_not_equal(Value l, Value r)
+{
+    return bool_result(l.int_val != r.int_val);
+}
+
+// Any mix of int and float operands is computed in double precision.
+static Value num_add(Value l, Value r)
+{
+    return float_result(as_double(l) + as_double(r));
+}
+
+static Value num_subtract(Value l, Value r)
+{
+    return float_result(as_double(l) - as_double(r));
+}
+
+static Value num_multiply(Value l, Value r)
+{
+    return float_result(as_double(l) * as_double(r));
+}
+
+static Value num_divide(Value l, Value r)
+{
+    return float_result(as_double(l) / as_double(r));
+}
+
+static Value num_power(Value l, Value r)
+{
+    return float_result(pow(as_double(l), as_double(r)));
+}
+
+static Value num_less(Value l, Value r)
+{
+    return bool_result(as_double(l) < as_double(r));
+}
+
+static Value num_greater(Value l, Value r)
+{
+    return bool_result(as_double(l) > as_double(r));
+}
+
+static Value num_less_equal(Value l, Value r)
+{
+    return bool_result(as_double(l) <= as_double(r));
+}
+
+static Value num_greater_equal(Value l, Value r)
+{
+    return bool_result(as_double(l) >= as_double(r));
+}
+
+static Value num_equal(Value l, Value r)
+{
+    return bool_result(as_double(l) == as_double(r));
+}
+
+static Value num_not_equal(Value l, Value r)
+{
+    return bool_result(as_double(l) != as_double(r));
+}
+
+static Value string_concat(Value l, Value r)
+{
+    ObjString *result = allocate_string(l.string->length + r.string->length);
+    memcpy(result->chars, l.string->chars, l.string->length);
+    memcpy(result->chars + l.string->length, r.string->chars, r.string->length);
+    Value v;
+    v.type = VAL_STRING;
+    v.string = intern_string(result);
+    return v;
+}
+
+static Value string_equal(Value l, Value r)
+{
+    return bool_result(l.string == r.string);
+}
+
+static Value string_not_equal(Value l, Value r)
+{
+    return bool_result(l.string != r.string);
+}
+
+static Value bool_and(Value l, Value r)
+{
+    return bool_result(l.int_val && r.int_val);
+}
+
+static Value bool_or(Value l, Value r)
+{
+    return bool_result(l.int_val || r.int_val);
+}
+
+#define INT_OR_FLOAT(op, int_handler, num_handler) \
+    [op][VAL_INT][VAL_INT] = int_handler, \
+    [op][VAL_INT][VAL_FLOAT] = num_handler, \
+    [op][VAL_FLOAT][VAL_INT] = num_handler, \
+    [op][VAL_FLOAT][VAL_FLOAT] = num_handler
+
+/**
+ * @brief Handlers for every (operator, left type, right type) combination with a defined meaning.
+ *
+ * Empty entries (including `%` on floats) evaluate to void.
+ */
+static const BinaryHandler binary_handlers[BINARY_OPERATOR_COUNT][OPERAND_TYPE_COUNT][OPERAND_TYPE_COUNT] = {
+    INT_OR_FLOAT(OPER_ADD, int_add, num_add),
+    INT_OR_FLOAT(OPER_SUBTRACT, int_subtract, num_subtract),
+    INT_OR_FLOAT(OPER_MULTIPLY, int_multiply, num_multiply),
+    INT_OR_FLOAT(OPER_DIVIDE, int_divide, num_divide),
+    [OPER_MODULO][VAL_INT][VAL_INT] = int_modulo,
+    INT_OR_FLOAT(OPER_POWER, int_power, num_power),
+    INT_OR_FLOAT(OPER_LESS, int_less, num_less),
+    INT_OR_FLOAT(OPER_GREATER, int_greater, num_greater),
+    INT_OR_FLOAT(OPER_LESS_EQUAL, int_less_equal, num_less_equal),
+    INT_OR_FLOAT(OPER_GREATER_EQUAL, int_greater_equal, num_greater_equal),
+    INT_OR_FLOAT(OPER_EQUAL, int_equal, num_equal),
+    INT_OR_FLOAT(OPER_NOT_EQUAL, int_not_equal, num_not_equal),
+    [OPER_ADD][VAL_STRING][VAL_STRING] = string_concat,
+    [OPER_EQUAL][VAL_STRING][VAL_STRING] = string_equal,
+    [OPER_NOT_EQUAL][VAL_STRING][VAL_STRING] = string_not_equal,
+    [OPER_AND][VAL_BOOL][VAL_BOOL] = bool_and,
+    [OPER_OR][VAL_BOOL][VAL_BOOL] = bool_or,
+};
+
+#undef INT_OR_FLOAT
+
+/**
+ * @brief Applies a binary operator to two already-evaluated operands.
+ *
+ * Shared by the tree-walker (`AST_BINARY_OP`) and the bytecode VM's generic slow path.
+ * Operand combinations without a defined meaning yield a void value.
+ *
+ * @param op The binary operator (OPER_ADD to OPER_OR).
+ * @param left The left operand.
+ * @param right The right operand.
+ * @return The result of the operation.
+ */
+Value eval_binary_op(Operator op, Value left, Value right)
+{
+    if (left.type < OPERAND_TYPE_COUNT && right.type < OPERAND_TYPE_COUNT)
+    {
+        BinaryHandler handler = binary_handlers[op][left.type][right.type];
+        if (handler)
+            return handler(left, right);
+    }
+    return (Value){VAL_VOID};
+}
+
+int concat_operands(ASTNode *node, ASTNode **operands)
+{
+    int count = 0;
+    int builds_string = node->static_type == VAL_STRING;
+    ASTNode *spine = node;
+    while (count < MAX_CONCAT_OPERANDS - 1 && spine->type == AST_BINARY_OP && spine->op == OPER_ADD &&
+           spine->children_count == 2 && spine->children[0] && spine->children[1])
+    {
+        operands[count++] = spine->children[1];
+        spine = spine->children[0];
+    }
+    operands[count++] = spine;
+    if (count < 3)
+        return 0;
+
+    // The operands were collected right to left.
+    for (int i = 0; i < count / 2; i++)
+    {
+        ASTNode *operand = operands[i];
+        operands[i] = operands[count - 1 - i];
+        operands[count - 1 - i] = operand;
+    }
+    for (int i = 0; i < count; i++)
+    {
+        if (operands[i]->type == AST_STRING_LITERAL || operands[i]->static_type == VAL_STRING)
+            builds_string = 1;
+    }
+    return builds_string ? count : 0;
+}
+
+Value concat_values(int count, Value *operands)
+{
+    int length = 0;
+    for (int i = 0; i < count; i++)
+    {
+        if (operands[i].type != VAL_STRING)
+        {
+            // `+` has no side effects and never fails, so adding in order after evaluating every
+            // operand gives the chain's result. Each partial sum is rooted while the next is made.
+            Value sum = operands[0];
+            for (int j = 1; j < count; j++)
+            {
+                gc_push_value(sum);
+                sum = eval_binary_op(OPER_ADD, sum, operands[j]);
+                gc_pop_root();
+            }
+            return sum;
+        }
+        length += operands[i].string->length;
+    }
+
+    ObjString *result = allocate_string(length);
+    char *end = result->chars;
+    for (int i = 0; i < count; i++)
+    {
+        memcpy(end, operands[i].string->chars, operands[i].string->length);
+        end += operands[i].string->length;
+    }
+    Value v;
+    v.type = VAL_STRING;
+    v.string = intern_string(result);
+    return v;
+}
+
+/**
+ * @brief Applies a unary operator to an already-evaluated operand.
+ *
+ * @param op The unary operator (OPER_NEGATE or OPER_NOT).
+ * @param operand The operand value.
+ * @param line The line number for error reporting.
+ * @return The result of the operation.
+ */
+Value eval_unary_op(Operator op, Value operand, int line)
+{
+    Value result = {VAL_VOID};
+    if (op == OPER_NEGATE)
+    {
+        if (operand.type == VAL_INT)
+        {
+            result.type = VAL_INT;
+            result.int_val = -operand.int_val;
+        }
+        else if (operand.type == VAL_FLOAT)
+        {
+            result.type = VAL_FLOAT;
+            result.float_val = -operand.float_val;
+        }
+        else
+        {
+            report_error(line, "Operand for unary '-' must be a number.");
+        }
+    }
+    else if (op == OPER_NOT)
+    {
+        if (operand.type == VAL_BOOL)
+        {
+            result.type = VAL_BOOL;
+            result.int_val = !operand.int_val;
+        }
+        else
+        {
+            report_error(line, "Operand for '!' must be a boolean.");
+        }
+    }
+    return result;
+}
+
+// --- Classes and Instances ---
+
+static int next_class_id = 1;
+
+#ifdef DEBUG_FIELD_CACHE_STATS
+static long field_cache_hits = 0;
+static long field_cache_misses = 0;
+
+void print_field_cache_stats()
+{
+    long total = field_cache_hits + field_cache_misses;
+    printf("[FIELD_CACHE] %ld hits, %ld misses (%.1f%% hit rate)\n", field_cache_hits, field_cache_misses,
+           total > 0 ? 100.0 * field_cache_hits / total : 0.0);
+}
+#endif
+
+int class_field_slot(PithClass *pith_class, ObjString *name)
+{
+    for (int i = 0; i < pith_class->field_count; i++)
+    {
+        if (pith_class->fields[i] == name)
+            return i;
+    }
+    return -1;
+}
+
+/**
+ * @brief Returns the slot of a field, appending it to the class's layout if it is new.
+ */
+static int add_class_field(PithClass *pith_class, ObjString *name)
+{
+    int slot = class_field_slot(pith_class, name);
+    if (slot >= 0)
+        return slot;
+
+    pith_class->fields = realloc(pith_class->fields, sizeof(ObjString *) * (pith_class->field_count + 1));
+    if (!pith_class->fields)
+    {
+        fprintf(stderr, "Fatal: Memory allocation failed for class fields.\n");
+        exit(1);
+    }
+    pith_class->fields[pith_class->field_count] = name;
+    return pith_class->field_count++;
+}
+
+/**
+ * @brief Wraps a receiver and a method into a GC-managed BoundMethod value.
+ */
+static Value bind_method(Value receiver, Value method_val)
+{
+    // Use GC allocator for BoundMethod
+    BoundMethod *bound = (BoundMethod *) allocate_obj(sizeof(BoundMethod), OBJ_BOUND_METHOD);
+    bound->receiver = receiver;
+    bound->method = method_val;
+    Value result;
+    result.type = VAL_BOUND_METHOD;
+    result.bound_method = bound;
+    return result;
+}
+
+/**
+ * @brief Looks up a member of a value (`object.name`) without binding methods to it.
+ *
+ * Instances yield fields first, then methods. Classes yield raw (unbound) methods, modules
+ * yield members, and strings/lists yield native methods.
+ *
+ * @param object The receiver value.
+ * @param name The member name.
+ * @param line The line number for error reporting.
+ * @param is_method Set to 1 if the member is a method that expects `object` as its receiver.
+ * @return The member value.
+ */
+static Value find_member(Value object, ObjString *name, int line, int *is_method)
+{
+    *is_method = 0;
+    if (object.type == VAL_INSTANCE)
+    {
+        PithInstance *instance = object.instance;
+        int slot = class_field_slot(instance->pith_class, name);
+        if (slot >= 0 && slot < instance->field_count && instance->fields[slot].type != VAL_VOID)
+            return instance->fields[slot];
+
+        Value method_val = hashmap_get(object.instance->pith_class->methods, name);
+        if (method_val.type != VAL_VOID)
+        {
+            *is_method = 1;
+            return method_val;
+        }
+    }
+    else if (object.type == VAL_CLASS)
+    {
+        // This is for C++ style parent calls: ClassName.method(...)
+        Value method_val = hashmap_get(object.pith_class->methods, name);
+        if (method_val.type == VAL_FUNC)
+        {
+            return method_val; // Return the raw, unbound Func
+        }
+    }
+    else if (object.type == VAL_MODULE)
+    {
+#ifdef DEBUG_TRACE_IMPORT
+        printf("[IMPORT] Accessing member '%s' of module '%s'\n", name->chars, object.module->name);
+#endif
+#ifdef DEBUG_DEEP_DIVE_INTERP
+        printf("[DDI_MODULE_ACCESS] Accessing member '%s' of module '%s'\n", name->chars, object.module->name);
+#endif
+        return hashmap_get(object.module->members, name);
+    }
+    else if (object.type == VAL_STRING || object.type == VAL_LIST || object.type == VAL_STRING_BUILDER ||
+             object.type == VAL_HASHMAP)
+    {
+        HashMap *methods = object.type == VAL_STRING ? native_string_methods
+                           : object.type == VAL_LIST ? native_list_methods
+                           : object.type == VAL_HASHMAP ? native_map_methods
+                           : native_string_builder_methods;
+        Value method_val = hashmap_get(methods, name);
+        if (method_val.type != VAL_VOID)
+        {
+            *is_method = 1;
+            return method_val;
+        }
+    }
+    report_error(line, "Value of type '%s' has no field or method named '%s'.",
+                 get_value_type_name(object.type), name->chars);
+    return (Value){VAL_VOID};
+}
+
+/**
+ * @brief Reads a field or method from a value (`object.name`); methods are bound to `object`.
+ *
+ * @param object The receiver value.
+ * @param name The member name.
+ * @param line The line number for error reporting.
+ * @return The member value.
+ */
+Value get_field(Value object, ObjString *name, int line)
+{
+    int is_method;
+    Value member = find_member(object, name, line, &is_method);
+    return is_method ? bind_method(object, member) : member;
+}
+
+/**
+ * @brief Writes a field on an instance (`object.name = val`).
+ *
+ * Assigning a field the class does not declare adds it to the class's layout.
+ *
+ * @param object The receiver value; must be an instance.
+ * @param name The field name.
+ * @param val The value to store.
+ * @param line The line number for error reporting.
+ */
+void set_field(Value object, ObjString *name, Value val, int line)
+{
+    if (object.type == VAL_INSTANCE)
+    {
+        PithInstance *instance = object.instance;
+        int slot = add_class_field(instance->pith_class, name);
+        if (slot >= instance->field_count)
+        {
+            // The instance predates the field: catch up with the class's layout.
+            int field_count = instance->pith_class->field_count;
+            instance->fields = realloc(instance->fields, sizeof(Value) * field_count);
+            if (!instance->fields)
+            {
+                fprintf(stderr, "Fatal: Memory allocation failed for instance fields.\n");
+                exit(1);
+            }
+            for (int i = instance->field_count; i < field_count; i++)
+                instance->fields[i] = (Value){VAL_VOID};
+            instance->field_count = field_count;
+        }
+        instance->fields[slot] = val;
+    }
+    else
+    {
+        report_error(line, "Cannot assign to a field on a value of type '%s'.",
+                     get_value_type_name(object.type));
+    }
+}
+
+/**
+ * @brief Finds the entry of an inline cache for a class.
+ * @return The entry, or NULL if the class has none.
+ */
+static FieldCacheEntry *find_cache_entry(FieldCache *cache, PithClass *pith_class)
+{
+    for (int i = 0; i < cache->count; i++)
+    {
+        if (cache->entries[i].class_id == pith_class->id)
+            return &cache->entries[i];
+    }
+    return NULL;
+}
+
+/**
+ * @brief Returns the entry to fill for a class: its existing one, a free one, or NULL if the
+ *        cache is full.
+ */
+static FieldCacheEntry *claim_cache_entry(FieldCache *cache, PithClass *pith_class)
+{
+    FieldCacheEntry *entry = find_cache_entry(cache, pith_class);
+    if (!entry && cache->count < FIELD_CACHE_SIZE)
+        entry = &cache->entries[cache->count++];
+    if (entry)
+        entry->class_id = pith_class->id;
+    return entry;
+}
+
+/**
+ * @brief Looks up a member like find_member, through the inline cache of the access site.
+ */
+static Value find_member_cached(Value object, ObjString *name, FieldCache *cache, int line, int *is_method)
+{
+    if (object.type != VAL_INSTANCE)
+        return find_member(object, name, line, is_method);
+
+    PithInstance *instance = object.instance;
+    PithClass *pith_class = instance->pith_class;
+    FieldCacheEntry *entry = find_cache_entry(cache, pith_class);
+    if (entry)
+    {
+        if (entry->slot >= 0)
+        {
+            if (entry->slot < instance->field_count && instance->fields[entry->slot].type != VAL_VOID)
+            {
+#ifdef DEBUG_FIELD_CACHE_STATS
+                field_cache_hits++;
+#endif
+                *is_method = 0;
+                return instance->fields[entry->slot];
+            }
+        }
+        else if (entry->field_count == pith_class->field_count)
+        {
+#ifdef DEBUG_FIELD_CACHE_STATS
+            field_cache_hits++;
+#endif
+            *is_method = 1;
+            return entry->method;
+        }
+    }
+
+#ifdef DEBUG_FIELD_CACHE_STATS
+    field_cache_misses++;
+#endif
+    // An unset field falls back on the class's methods, so only cache what find_member would find.
+    int slot = class_field_slot(pith_class, name);
+    Value method_val = hashmap_get(pith_class->methods, name);
+    if (slot >= 0 && (slot >= instance->field_count || instance->fields[slot].type == VAL_VOID))
+        return find_member(object, name, line, is_method);
+    if (slot < 0 && method_val.type == VAL_VOID)
+        return find_member(object, name, line, is_method);
+
+    entry = claim_cache_entry(cache, pith_class);
+    if (entry)
+    {
+        entry->slot = slot;
+        entry->field_count = pith_class->field_count;
+        entry->method = method_val;
+    }
+    *is_method = slot < 0;
+    return slot >= 0 ? instance->fields[slot] : method_val;
+}
+
+Value get_field_cached(Value object, ObjString *name, FieldCache *cache, int line)
+{
+    int is_method;
+    Value member = find_member_cached(object, name, cache, line, &is_method);
+    return is_method ? bind_method(object, member) : member;
+}
+
+void set_field_cached(Value object, ObjString *name, Value val, FieldCache *cache, int line)
+{
+    if (object.type == VAL_INSTANCE)
+    {
+        PithInstance *instance = object.instance;
+        FieldCacheEntry *entry = find_cache_entry(cache, instance->pith_class);
+        if (entry && entry->slot >= 0 && entry->slot < instance->field_count)
+        {
+#ifdef DEBUG_FIELD_CACHE_STATS
+            field_cache_hits++;
+#endif
+            instance->fields[entry->slot] = val;
+            return;
+        }
+#ifdef DEBUG_FIELD_CACHE_STATS
+        field_cache_misses++;
+#endif
+        set_field(object, name, val, line);
+        entry = claim_cache_entry(cache, instance->pith_class);
+        if (entry)
+        {
+            entry->slot = class_field_slot(instance->pith_class, name);
+            entry->field_count = instance->pith_class->field_count;
+            entry->method = (Value){VAL_VOID};
+        }
+        return;
+    }
+    set_field(object, name, val, line);
+}
+
+/**
+ * @brief Reads an element from a list or hashmap (`collection[index]`).
+ *
+ * @param collection The list or hashmap.
+ * @param index_val The index (int for lists, string for hashmaps).
+ * @param line The line number for error reporting.
+ * @return The element value.
+ */
+Value get_index(Value collection, Value index_val, int line)
+{
+    if (collection.type == VAL_LIST)
+    {
+        if (index_val.type != VAL_INT)
+            report_error(line, "List index must be an integer.");
+        int index = index_val.int_val;
+        if (index < 0 || index >= collection.list->count)
+            report_error(line, "Index out of bounds.");
+        return collection.list->items[index];
+    }
+    else if (collection.type == VAL_HASHMAP)
+    {
+        if (index_val.type != VAL_STRING)
+            report_error(line, "Hashmap index must be a string.");
+        return hashmap_get(collection.hashmap, index_val.string);
+    }
+    report_error(line, "Not an indexable type.");
+    return (Value){VAL_VOID};
+}
+
+/**
+ * @brief Writes an element of a list or hashmap (`collection[index] = val`).
+ *
+ * @param collection The list or hashmap.
+ * @param index_val The index (int for lists, string for hashmaps).
+ * @param val The value to store.
+ * @param line The line number for error reporting.
+ */
+void set_index(Value collection, Value index_val, Value val, int line)
+{
+    if (collection.type == VAL_HASHMAP)
+    {
+        if (index_val.type != VAL_STRING)
+            report_error(line, "Hashmap index must be a string.");
+        hashmap_set(collection.hashmap, index_val.string, val, line);
+    }
+    else if (collection.type == VAL_LIST)
+    {
+        if (index_val.type != VAL_INT)
+            report_error(line, "List or array index must be an integer.");
+        int index = index_val.int_val;
+        if (index < 0 || index >= collection.list->count)
+            report_error(line, "Index out of bounds.");
+        collection.list->items[index] = val;
+    }
+    else
+    {
+        report_error(line, "Index assignment is only supported for lists, arrays, and hashmaps.");
+    }
+}
+
+/**
+ * @brief Runs the body of a user-defined function in a prepared environment.
+ *
+ * Dispatches to the engine selected by `execution_engine`, so functions defined by either
+ * engine can be called from the other.
+ *
+ * @param func The function to run.
+ * @param env The frame holding the parameters, linked to the function's defining frame.
+ * @return The function's return value.
+ */
+static Value run_function_body(Func *func, Env *env)
+{
+    if (execution_engine == ENGINE_VM)
+    {
+        return vm_run_function(func, env);
+    }
+    return exec_block(func->body->children[0], env);
+}
+
+/**
+ * @brief Allocates the frame of a call, linked to the frame the function was defined in, and
+ * binds `this` (for methods) and the parameters to their slots.
+ */
+static Env *new_call_frame(Func *func, Value *this_val, int arg_count, Value *args)
+{
+    ASTNode *def = func->body;
+    // Only a frame that a nested definition may capture has to outlive the call.
+    Env *frame = def->frame_captured ? env_new(def->slot_count, func->env)
+                                     : stack_env_new(def->slot_count, func->env);
+
+    // Methods receive their instance in slot 0, ahead of the parameters (see resolver.c).
+    int first_param = 0;
+    if (func->owner_class)
+    {
+        frame->slots[0] = this_val ? *this_val : (Value){VAL_VOID};
+        first_param = 1;
+    }
+    int bound = arg_count < def->arg_count ? arg_count : def->arg_count;
+    for (int i = 0; i < bound; i++)
+    {
+        frame->slots[first_param + i] = args[i];
+    }
+    return frame;
+}
+
+/**
+ * @brief Calls a user-defined function.
+ *
+ * Runs the body in a new frame. When the body ends with a call in tail position, that call
+ * is made here, in a frame that replaces the finished one (see `tail_call`). With `--jit`, a
+ * hot function runs as machine code instead (see jit.h).
+ *
+ * @param func The function to call.
+ * @param this_val The receiver for method calls, or NULL for plain functions.
+ * @param arg_count Number of arguments.
+ * @param args The argument values.
+ * @param line The line of the call, for a stack overflow error.
+ * @return The function's return value.
+ */
+Value call_function(Func *func, Value *this_val, int arg_count, Value *args, int line)
+{
+    check_c_stack(line);
+    Value result;
+    if (jit_enabled && jit_call(func, arg_count, args, &result))
+        return result;
+
+    Env *frame = new_call_frame(func, this_val, arg_count, args);
+    push_frame(frame);
+    result = run_function_body(func, frame);
+    while (result.type == VAL_TAIL_CALL)
+    {
+        pop_frame();
+        if (!func->body->frame_captured)
+            frame_stack_release(frame);
+        func = tail_call.func;
+        if (jit_enabled && jit_call(func, tail_call.arg_count, tail_call.args, &result))
+        {
+            tail_call.func = NULL;
+            return result;
         }
-        case AST_BOOL_LITERAL:
+        frame = new_call_frame(func, &tail_call.this_val, tail_call.arg_count, tail_call.args);
+        tail_call.func = NULL;
+        push_frame(frame);
+        result = run_function_body(func, frame);
+    }
+    pop_frame();
+    if (!func->body->frame_captured)
+        frame_stack_release(frame);
+    return result;
+}
+
+/**
+ * @brief Records a call to a user-defined function for the running `call_function` to make.
+ * @return VAL_TAIL_CALL, to be returned by the calling function.
+ */
+static Value defer_tail_call(Func *func, Value *this_val, int arg_count, Value *args)
+{
+    if (arg_count > tail_call.capacity)
+    {
+        tail_call.capacity = arg_count < 8 ? 8 : arg_count;
+        tail_call.args = realloc(tail_call.args, tail_call.capacity * sizeof(Value));
+        if (!tail_call.args)
         {
-            result.type = VAL_BOOL;
-            result.int_val = (strcmp(node->value, "true") == 0);
-            break;
+            fprintf(stderr, "Fatal: Memory allocation failed for tail call.\n");
+            exit(1);
+        }
+    }
+    for (int i = 0; i < arg_count; i++)
+        tail_call.args[i] = args[i];
+    tail_call.arg_count = arg_count;
+    tail_call.this_val = this_val ? *this_val : (Value){VAL_VOID};
+    tail_call.func = func;
+    return (Value){VAL_TAIL_CALL};
+}
+
+Value tail_call_value(Value callee, int arg_count, Value *args, int line)
+{
+    // Unbound method calls (`Parent.init(this, ...)`) and everything that is not a user-defined
+    // function take the ordinary path.
+    if (callee.type == VAL_FUNC && callee.func->owner_class == NULL)
+        return defer_tail_call(callee.func, NULL, arg_count, args);
+    if (callee.type == VAL_BOUND_METHOD && callee.bound_method->method.type == VAL_FUNC)
+        return defer_tail_call(callee.bound_method->method.func, &callee.bound_method->receiver, arg_count, args);
+    return call_value(callee, arg_count, args, line);
+}
+
+Value tail_call_method(ObjString *name, FieldCache *cache, int arg_count, Value *args, int line)
+{
+    int is_method;
+    Value member = find_member_cached(args[0], name, cache, line, &is_method);
+    if (!is_method)
+        return tail_call_value(member, arg_count, args + 1, line);
+
+    if (member.type == VAL_NATIVE_FN)
+    {
+        set_exec_error_line(line);
+        return member.native_fn(arg_count + 1, args);
+    }
+    return defer_tail_call(member.func, &args[0], arg_count, args + 1);
+}
+
+/**
+ * @brief Creates a new instance of a class and runs its `init` method, if any.
+ *
+ * @param pclass The class to instantiate.
+ * @param arg_count Number of constructor arguments.
+ * @param args The constructor arguments.
+ * @param line The line number for error reporting.
+ * @return The new instance.
+ */
+Value instantiate_class(PithClass *pclass, int arg_count, Value *args, int line)
+{
+    // Use GC allocator for PithInstance
+    PithInstance *instance = (PithInstance *) allocate_obj(sizeof(PithInstance), OBJ_INSTANCE);
+
+    // Protect instance while initializing fields and running init
+    gc_push_root((ObjHeader *) instance);
+
+    instance->pith_class = pclass;
+    instance->field_count = pclass->field_count;
+    instance->fields = NULL;
+    if (pclass->field_count > 0)
+    {
+        instance->fields = malloc(sizeof(Value) * pclass->field_count);
+        if (!instance->fields)
+        {
+            fprintf(stderr, "Fatal: Memory allocation failed for instance fields.\n");
+            exit(1);
+        }
+        for (int i = 0; i < pclass->field_count; i++)
+            instance->fields[i] = (Value){VAL_VOID};
+    }
+
+    Value instance_val;
+    instance_val.type = VAL_INSTANCE;
+    instance_val.instance = instance;
+
+    if (!init_string)
+        init_string = copy_string("init", 4);
+    Value init_method_val = hashmap_get(pclass->methods, init_string);
+    if (init_method_val.type != VAL_VOID)
+    {
+        call_function(init_method_val.func, &instance_val, arg_count, args, line);
+    }
+
+    gc_pop_root();
+    return instance_val;
+}
+
+/**
+ * @brief Calls any callable value with already-evaluated arguments.
+ *
+ * Handles class construction (`MyClass(...)`), unbound method calls (`Parent.init(this, ...)`),
+ * bound methods (user-defined and native), plain functions and native functions.
+ *
+ * @param callee The value being called.
+ * @param arg_count Number of arguments.
+ * @param args The argument values.
+ * @param line The line number for error reporting.
+ * @return The result of the call.
+ */
+Value call_value(Value callee, int arg_count, Value *args, int line)
+{
+    switch (callee.type)
+    {
+        case VAL_CLASS:
+            // `MyClass(...)` is a shortcut for `new MyClass(...)`.
+            return instantiate_class(callee.pith_class, arg_count, args, line);
+        case VAL_FUNC:
+        {
+            Func *func = callee.func;
+            if (func->owner_class != NULL)
+            {
+                // This is an unbound method call, like Animal.init(this, ...)
+                if (arg_count < 1)
+                {
+                    report_error(line, "Unbound method call requires at least one argument for 'this'.");
+                }
+                // TODO: Add type checking to ensure args[0] is an instance of func->owner_class or a subclass
+                return call_function(func, &args[0], arg_count - 1, args + 1, line);
+            }
+            return call_function(func, NULL, arg_count, args, line);
+        }
+        case VAL_BOUND_METHOD:
+        {
+            BoundMethod *bound = callee.bound_method;
+            if (bound->method.type == VAL_NATIVE_FN)
+            {
+                // Native methods receive the receiver as their first argument.
+                Value *native_args = frame_stack_alloc((arg_count + 1) * sizeof(Value));
+                native_args[0] = bound->receiver;
+                for (int i = 0; i < arg_count; i++)
+                {
+                    native_args[i + 1] = args[i];
+                }
+                set_exec_error_line(line);
+                Value result = bound->method.native_fn(arg_count + 1, native_args);
+                frame_stack_release(native_args);
+                return result;
+            }
+            return call_function(bound->method.func, &bound->receiver, arg_count, args, line);
+        }
+        case VAL_NATIVE_FN:
+            set_exec_error_line(line);
+            return callee.native_fn(arg_count, args);
+        default:
+            report_error(line, "Expression is not callable.");
+            return (Value){VAL_VOID};
+    }
+}
+
+Value call_method(ObjString *name, FieldCache *cache, int arg_count, Value *args, int line)
+{
+    int is_method;
+    Value member = find_member_cached(args[0], name, cache, line, &is_method);
+    if (!is_method)
+        return call_value(member, arg_count, args + 1, line);
+
+    if (member.type == VAL_NATIVE_FN)
+    {
+        // Native methods take the receiver as their first argument, which is where it already is.
+        set_exec_error_line(line);
+        return member.native_fn(arg_count + 1, args);
+    }
+    return call_function(member.func, &args[0], arg_count, args + 1, line);
+}
+
+/**
+ * @brief Applies a declared `list<T>` type to the initializer of a variable declaration.
+ *
+ * Sets the list's element type and validates the existing elements.
+ *
+ * @param decl The AST_VAR_DECL node carrying the declared type name.
+ * @param val The initializer value.
+ */
+void apply_declared_list_type(ASTNode *decl, Value val)
+{
+    if (!decl->type_name || strncmp(decl->type_name, "list<", 5) != 0)
+        return;
+
+    char inner[32];
+    sscanf(decl->type_name, "list<%31[^>]>", inner);
+    ValueType declared = get_type_from_name(inner);
+    if (val.type == VAL_LIST)
+    {
+        // Set element_type on the created list and validate
+        val.list->element_type = declared;
+        for (int i = 0; i < val.list->count; i++)
+        {
+            if (declared != VAL_VOID && val.list->items[i].type != declared)
+            {
+                report_error(decl->line_num,
+                             "Type mismatch in list literal: expected elements of type '%s'.",
+                             get_value_type_name(declared));
+            }
         }
+    }
+    else if (val.type == VAL_VOID)
+    {
+        // Nothing to do: already handled above for empty list creation
+    }
+    else
+    {
+        // If initializer is not a list, it's a type error
+        report_error(decl->line_num, "Type mismatch: declared '%s' but initializer is '%s'.",
+                     decl->type_name, get_value_type_name(val.type));
+    }
+}
+
+/**
+ * @brief Evaluates an AST_FUNC_CALL node.
+ *
+ * A member call (`obj.m(x)`) keeps the receiver in args[0] and calls the method directly, so
+ * no bound method is created. The callee (or receiver) and the arguments are rooted until the
+ * call returns.
+ *
+ * @param node The call node.
+ * @param env The current frame.
+ * @param is_tail_call Whether the call is returned by a `return` marked by the resolver.
+ * @return The result of the call, or VAL_TAIL_CALL for a tail call left to `call_function`.
+ */
+static Value eval_call(ASTNode *node, Env *env, int is_tail_call)
+{
+    ASTNode *callee_node = node->children[0];
+    int is_member_call = callee_node->type == AST_FIELD_ACCESS;
+    int arg_count = node->children_count - 1;
+    Value *args = frame_stack_alloc((arg_count + 1) * sizeof(Value));
+    args[0] = eval(is_member_call ? callee_node->children[0] : callee_node, env);
+    gc_push_value(args[0]);
+    for (int i = 1; i <= arg_count; i++)
+    {
+        args[i] = eval(node->children[i], env);
+        gc_push_value(args[i]);
+    }
+    Value result;
+    if (is_member_call && is_tail_call)
+        result = tail_call_method(MEMBER_NAME(callee_node), callee_node->cache, arg_count, args, node->line_num);
+    else if (is_member_call)
+        result = call_method(MEMBER_NAME(callee_node), callee_node->cache, arg_count, args, node->line_num);
+    else if (is_tail_call)
+        result = tail_call_value(args[0], arg_count, args + 1, node->line_num);
+    else
+        result = call_value(args[0], arg_count, args + 1, node->line_num);
+    gc_pop_roots(arg_count + 1);
+    frame_stack_release(args);
+    return result;
+}
+
+Value eval(ASTNode *node, Env *env)
+{
+    if (!node)
+        return (Value){VAL_VOID};
+#ifdef DEBUG_NO_CLOSURE_COMPILER
+    return eval_node(node, env);
+#else
+    ClosureNode *closure = node->closure ? node->closure : compile_expression_closure(node);
+    return closure->fn(closure, env);
+#endif
+}
+
+/**
+ * @brief Evaluates an expression AST node by switching on its type.
+ *
+ * Handles literals, variable references, operations, function calls, etc. Nodes run through
+ * their closures, which only come back here for shapes without a specialisation.
+ *
+ * @param node The expression node.
+ * @param env The current environment.
+ * @return The result of the evaluation.
+ */
+Value eval_node(ASTNode *node, Env *env)
+{
+    if (!node)
+        return (Value){VAL_VOID};
+
+#ifdef DEBUG_TRACE_EXECUTION
+    printf("[EXEC] Evaluating expression node type %d\n", node->type);
+#endif
+#ifdef DEBUG_DEEP_DIVE_INTERP
+    printf("[DDI_EVAL] Evaluating node type %d\n", node->type);
+#endif
+
+    Value result;
+
+    switch (node->type)
+    {
+        case AST_INT_LITERAL:
+        case AST_FLOAT_LITERAL:
+        case AST_STRING_LITERAL:
+        case AST_BOOL_LITERAL:
+            // Decoded by the parser; string constants are shared, never copied.
+            result = LITERAL_VALUE(node);
+            break;
         case AST_LIST_LITERAL:
         {
             // Use GC allocator for List
@@ -1419,10 +3363,12 @@ Value eval(ASTNode *node, Env *env)
             for (int i = 0; i < node->children_count; i += 2)
             {
                 Value key = eval(node->children[i], env);
+                gc_push_value(key);
                 Value val = eval(node->children[i + 1], env);
+                gc_pop_root();
                 if (key.type != VAL_STRING)
                     report_error(node->children[i]->line_num, "Hashmap keys must be strings.");
-                hashmap_set(map, key.str_val, val, node->line_num);
+                hashmap_set(map, key.string, val, node->line_num);
             }
 
             gc_pop_root();
@@ -1432,565 +3378,91 @@ Value eval(ASTNode *node, Env *env)
             break;
         }
         case AST_VAR_REF:
-            result = value_copy(env_get(env, node->value, node->line_num));
-            break;
-        case AST_UNARY_OP:
-        {
-#ifdef DEBUG_DEEP_DIVE_INTERP
-            printf("[DDI_UNARY_OP] Unary op '%s'\n", node->value);
-#endif
-            Value operand = eval(node->children[0], env);
-            if (strcmp(node->value, "-") == 0)
-            {
-                if (operand.type == VAL_INT)
-                {
-                    result.type = VAL_INT;
-                    result.int_val = -operand.int_val;
-                }
-                else if (operand.type == VAL_FLOAT)
-                {
-                    result.type = VAL_FLOAT;
-                    result.float_val = -operand.float_val;
-                }
-                else
-                {
-                    report_error(node->line_num, "Operand for unary '-' must be a number.");
-                }
-            }
-            else if (strcmp(node->value, "!") == 0)
-            {
-                if (operand.type == VAL_BOOL)
-                {
-                    result.type = VAL_BOOL;
-                    result.int_val = !operand.int_val;
-                }
-                else
-                {
-                    report_error(node->line_num, "Operand for '!' must be a boolean.");
-                }
-            }
-            break;
-        }
-        case AST_NEW_EXPR:
-        {
-            ASTNode *call_node = node->children[0];
-            Value class_val = eval(call_node->children[0], env);
-            if (class_val.type != VAL_CLASS)
-            {
-                report_error(node->line_num, "Cannot instantiate non-class type.");
-            }
-
-            // Use GC allocator for PithInstance
-            PithInstance *instance = (PithInstance *) allocate_obj(sizeof(PithInstance), OBJ_INSTANCE);
-
-            // Protect instance while initializing fields and evaluating args
-            gc_push_root((ObjHeader *) instance);
-
-            instance->pith_class = class_val.pith_class;
-            instance->fields = hashmap_create(VAL_STRING, VAL_VOID);
-
-            for (int i = 0; i < instance->pith_class->field_count; i++)
-            {
-                hashmap_set(instance->fields, instance->pith_class->fields[i], (Value){VAL_VOID}, node->line_num);
-            }
-
-            Value instance_val;
-            instance_val.type = VAL_INSTANCE;
-            instance_val.instance = instance;
-
-            Value init_method_val = hashmap_get(instance->pith_class->methods, "init");
-            if (init_method_val.type != VAL_VOID)
-            {
-                Func *init_method = init_method_val.func;
-                int arg_count = call_node->children_count - 1;
-                Value *args = malloc(arg_count * sizeof(Value));
-                for (int i = 0; i < arg_count; i++)
-                {
-                    args[i] = eval(call_node->children[i + 1], env);
-                }
-
-                Env *arg_env = NULL;
-                env_define(&arg_env, "this", instance_val);
-                for (int i = 0; i < arg_count; i++)
-                {
-                    env_define(&arg_env, init_method->body->args[i], args[i]);
-                }
-
-                Env *exec_env = arg_env;
-                if (exec_env)
-                {
-                    Env *tail = exec_env;
-                    while (tail->next != NULL)
-                        tail = tail->next;
-                    tail->next = init_method->env;
-                }
-                else
-                {
-                    exec_env = init_method->env;
-                }
-
-                exec_block(init_method->body->children[0], &exec_env);
-                free(args);
-            }
-
-            gc_pop_root();
-
-            result = instance_val;
-            break;
-        }
-        case AST_FIELD_ACCESS:
-        {
-            Value object = eval(node->children[0], env);
-            if (object.type == VAL_INSTANCE)
-            {
-                Value field = hashmap_get(object.instance->fields, node->value);
-                if (field.type != VAL_VOID)
-                    return field;
-
-                Value method_val = hashmap_get(object.instance->pith_class->methods, node->value);
-                if (method_val.type != VAL_VOID)
-                {
-                    // Use GC allocator for BoundMethod
-                    BoundMethod *bound = (BoundMethod *) allocate_obj(sizeof(BoundMethod), OBJ_BOUND_METHOD);
-                    bound->receiver = object;
-                    bound->method = method_val;
-                    result.type = VAL_BOUND_METHOD;
-                    result.bound_method = bound;
-                    return result;
-                }
-            }
-            else if (object.type == VAL_CLASS)
-            {
-                // This is for C++ style parent calls: ClassName.method(...)
-                Value method_val = hashmap_get(object.pith_class->methods, node->value);
-                if (method_val.type == VAL_FUNC)
-                {
-                    return method_val; // Return the raw, unbound Func
-                }
-            }
-            else if (object.type == VAL_MODULE)
-            {
-#ifdef DEBUG_TRACE_IMPORT
-                printf("[IMPORT] Accessing member '%s' of module '%s'\n", node->value, object.module->name);
-#endif
+            result = env_get(env, node);
+            break;
+        case AST_UNARY_OP:
+        {
 #ifdef DEBUG_DEEP_DIVE_INTERP
-                printf("[DDI_MODULE_ACCESS] Accessing member '%s' of module '%s'\n", node->value, object.module->name);
+            printf("[DDI_UNARY_OP] Unary op '%s'\n", node->value);
 #endif
-                return hashmap_get(object.module->members, node->value);
-            }
-            else if (object.type == VAL_STRING)
+            Value operand = eval(node->children[0], env);
+            result = eval_unary_op(node->op, operand, node->line_num);
+            break;
+        }
+        case AST_NEW_EXPR:
+        {
+            ASTNode *call_node = node->children[0];
+            Value class_val = eval(call_node->children[0], env);
+            if (class_val.type != VAL_CLASS)
             {
-                Value method_val = hashmap_get(native_string_methods, node->value);
-                if (method_val.type != VAL_VOID)
-                {
-                    // Use GC allocator for BoundMethod
-                    BoundMethod *bound = (BoundMethod *) allocate_obj(sizeof(BoundMethod), OBJ_BOUND_METHOD);
-                    bound->receiver = object;
-                    bound->method = method_val;
-                    result.type = VAL_BOUND_METHOD;
-                    result.bound_method = bound;
-                    return result;
-                }
+                report_error(node->line_num, "Cannot instantiate non-class type.");
             }
-            else if (object.type == VAL_LIST)
+
+            // The arguments are rooted until the constructor has run.
+            int arg_count = call_node->children_count - 1;
+            Value *args = frame_stack_alloc(arg_count * sizeof(Value));
+            for (int i = 0; i < arg_count; i++)
             {
-                Value method_val = hashmap_get(native_list_methods, node->value);
-                if (method_val.type != VAL_VOID)
-                {
-                    // Use GC allocator for BoundMethod
-                    BoundMethod *bound = (BoundMethod *) allocate_obj(sizeof(BoundMethod), OBJ_BOUND_METHOD);
-                    bound->receiver = object;
-                    bound->method = method_val;
-                    result.type = VAL_BOUND_METHOD;
-                    result.bound_method = bound;
-                    return result;
-                }
+                args[i] = eval(call_node->children[i + 1], env);
+                gc_push_value(args[i]);
             }
-            report_error(node->line_num, "Value of type '%s' has no field or method named '%s'.",
-                         get_value_type_name(object.type), node->value);
+            result = instantiate_class(class_val.pith_class, arg_count, args, node->line_num);
+            gc_pop_roots(arg_count);
+            frame_stack_release(args);
+            break;
+        }
+        case AST_FIELD_ACCESS:
+        {
+            Value object = eval(node->children[0], env);
+            gc_push_value(object);
+            result = get_field_cached(object, MEMBER_NAME(node), node->cache, node->line_num);
+            gc_pop_root();
             break;
         }
         case AST_INDEX_ACCESS:
         {
             Value collection = eval(node->children[0], env);
+            gc_push_value(collection);
             Value index_val = eval(node->children[1], env);
-            if (collection.type == VAL_LIST)
-            {
-                if (index_val.type != VAL_INT)
-                    report_error(node->line_num, "List index must be an integer.");
-                int index = index_val.int_val;
-                if (index < 0 || index >= collection.list->count)
-                    report_error(node->line_num, "Index out of bounds.");
-                result = collection.list->items[index];
-                break;
-            }
-            else if (collection.type == VAL_HASHMAP)
-            {
-                if (index_val.type != VAL_STRING)
-                    report_error(node->line_num, "Hashmap index must be a string.");
-                result = hashmap_get(collection.hashmap, index_val.str_val);
-                break;
-            }
-            report_error(node->line_num, "Not an indexable type.");
+            gc_pop_root();
+            result = get_index(collection, index_val, node->line_num);
             break;
         }
         case AST_BINARY_OP:
         {
+            // Both operands stay rooted until the operator has produced its result.
             Value left = eval(node->children[0], env);
+            gc_push_value(left);
             Value right = eval(node->children[1], env);
+            gc_push_value(right);
 
 #ifdef DEBUG_DEEP_DIVE_INTERP
             printf("[DDI_BINOP] %s %s %s\n", get_value_type_name(left.type), node->value,
                    get_value_type_name(right.type));
 #endif
 
-            Value res = {VAL_VOID};
-
-            if (left.type == VAL_INT && right.type == VAL_INT)
-            {
-                if (strcmp(node->value, "+") == 0)
-                {
-                    res.type = VAL_INT;
-                    res.int_val = left.int_val + right.int_val;
-                }
-                else if (strcmp(node->value, "-") == 0)
-                {
-                    res.type = VAL_INT;
-                    res.int_val = left.int_val - right.int_val;
-                }
-                else if (strcmp(node->value, "*") == 0)
-                {
-                    res.type = VAL_INT;
-                    res.int_val = left.int_val * right.int_val;
-                }
-                else if (strcmp(node->value, "/") == 0)
-                {
-                    res.type = VAL_INT;
-                    res.int_val = left.int_val / right.int_val;
-                }
-                else if (strcmp(node->value, "%") == 0)
-                {
-                    res.type = VAL_INT;
-                    res.int_val = left.int_val % right.int_val;
-                }
-                else if (strcmp(node->value, "^") == 0)
-                {
-                    res.type = VAL_INT;
-                    res.int_val = (int) pow(left.int_val, right.int_val);
-                }
-                else if (strcmp(node->value, "<") == 0)
-                {
-                    res.type = VAL_BOOL;
-                    res.int_val = left.int_val < right.int_val;
-                }
-                else if (strcmp(node->value, ">") == 0)
-                {
-                    res.type = VAL_BOOL;
-                    res.int_val = left.int_val > right.int_val;
-                }
-                else if (strcmp(node->value, "<=") == 0)
-                {
-                    res.type = VAL_BOOL;
-                    res.int_val = left.int_val <= right.int_val;
-                }
-                else if (strcmp(node->value, ">=") == 0)
-                {
-                    res.type = VAL_BOOL;
-                    res.int_val = left.int_val >= right.int_val;
-                }
-                else if (strcmp(node->value, "==") == 0)
-                {
-                    res.type = VAL_BOOL;
-                    res.int_val = left.int_val == right.int_val;
-                }
-                else if (strcmp(node->value, "!=") == 0)
-                {
-                    res.type = VAL_BOOL;
-                    res.int_val = left.int_val != right.int_val;
-                }
-            }
-            else if ((left.type == VAL_FLOAT || left.type == VAL_INT) && (
-                         right.type == VAL_FLOAT || right.type == VAL_INT))
-            {
-                double left_d = (left.type == VAL_INT) ? left.int_val : left.float_val;
-                double right_d = (right.type == VAL_INT) ? right.int_val : right.float_val;
-                if (strcmp(node->value, "+") == 0)
-                {
-                    res.type = VAL_FLOAT;
-                    res.float_val = left_d + right_d;
-                }
-                else if (strcmp(node->value, "-") == 0)
-                {
-                    res.type = VAL_FLOAT;
-                    res.float_val = left_d - right_d;
-                }
-                else if (strcmp(node->value, "*") == 0)
-                {
-                    res.type = VAL_FLOAT;
-                    res.float_val = left_d * right_d;
-                }
-                else if (strcmp(node->value, "/") == 0)
-                {
-                    res.type = VAL_FLOAT;
-                    res.float_val = left_d / right_d;
-                }
-                else if (strcmp(node->value, "^") == 0)
-                {
-                    res.type = VAL_FLOAT;
-                    res.float_val = pow(left_d, right_d);
-                }
-                else if (strcmp(node->value, "<") == 0)
-                {
-                    res.type = VAL_BOOL;
-                    res.int_val = left_d < right_d;
-                }
-                else if (strcmp(node->value, ">") == 0)
-                {
-                    res.type = VAL_BOOL;
-                    res.int_val = left_d > right_d;
-                }
-                else if (strcmp(node->value, "<=") == 0)
-                {
-                    res.type = VAL_BOOL;
-                    res.int_val = left_d <= right_d;
-                }
-                else if (strcmp(node->value, ">=") == 0)
-                {
-                    res.type = VAL_BOOL;
-                    res.int_val = left_d >= right_d;
-                }
-                else if (strcmp(node->value, "==") == 0)
-                {
-                    res.type = VAL_BOOL;
-                    res.int_val = left_d == right_d;
-                }
-                else if (strcmp(node->value, "!=") == 0)
-                {
-                    res.type = VAL_BOOL;
-                    res.int_val = left_d != right_d;
-                }
-            }
-            else if (left.type == VAL_STRING && right.type == VAL_STRING)
-            {
-                if (strcmp(node->value, "+") == 0)
-                {
-                    char *new_str = malloc(strlen(left.str_val) + strlen(right.str_val) + 1);
-                    strcpy(new_str, left.str_val);
-                    strcat(new_str, right.str_val);
-                    res.type = VAL_STRING;
-                    res.str_val = new_str;
-                }
-                else if (strcmp(node->value, "==") == 0)
-                {
-                    res.type = VAL_BOOL;
-                    res.int_val = strcmp(left.str_val, right.str_val) == 0;
-                }
-                else if (strcmp(node->value, "!=") == 0)
-                {
-                    res.type = VAL_BOOL;
-                    res.int_val = strcmp(left.str_val, right.str_val) != 0;
-                }
-            }
-            else if (left.type == VAL_BOOL && right.type == VAL_BOOL)
-            {
-                if (strcmp(node->value, "and") == 0)
-                {
-                    res.type = VAL_BOOL;
-                    res.int_val = left.int_val && right.int_val;
-                }
-                else if (strcmp(node->value, "or") == 0)
-                {
-                    res.type = VAL_BOOL;
-                    res.int_val = left.int_val || right.int_val;
-                }
-            }
-
-            result = res;
+            result = eval_binary_op(node->op, left, right);
+            gc_pop_roots(2);
             break;
         }
-        case AST_FUNC_CALL:
+        case AST_LOGICAL_OP:
         {
-            Value callee = eval(node->children[0], env);
-
-            // If the callee is a class value, treat `MyClass(...)` as construction (shortcut for `new MyClass(...)`).
-            if (callee.type == VAL_CLASS)
+            Value left = eval(node->children[0], env);
+            // A false `and` or a true `or` decides the result without the right operand.
+            if (left.type == VAL_BOOL && left.int_val == (node->op == OPER_OR))
             {
-                PithClass *pclass = callee.pith_class;
-                // Use GC allocator for PithInstance
-                PithInstance *instance = (PithInstance *) allocate_obj(sizeof(PithInstance), OBJ_INSTANCE);
-                gc_push_root((ObjHeader *) instance);
-                instance->pith_class = pclass;
-                instance->fields = hashmap_create(VAL_STRING, VAL_VOID);
-                for (int i = 0; i < pclass->field_count; i++)
-                {
-                    hashmap_set(instance->fields, pclass->fields[i], (Value){VAL_VOID}, node->line_num);
-                }
-
-                Value instance_val;
-                instance_val.type = VAL_INSTANCE;
-                instance_val.instance = instance;
-
-                // Call init if present
-                Value init_method_val = hashmap_get(pclass->methods, "init");
-                if (init_method_val.type != VAL_VOID)
-                {
-                    Func *init_method = init_method_val.func;
-                    int arg_count = node->children_count - 1;
-                    Value *args = malloc(arg_count * sizeof(Value));
-                    for (int i = 0; i < arg_count; i++)
-                        args[i] = eval(node->children[i + 1], env);
-
-                    Env *arg_env = NULL;
-                    env_define(&arg_env, "this", instance_val);
-                    for (int i = 0; i < arg_count; i++)
-                        env_define(&arg_env, init_method->body->args[i], args[i]);
-
-                    Env *exec_env = arg_env;
-                    if (exec_env)
-                    {
-                        Env *tail = exec_env;
-                        while (tail->next != NULL)
-                            tail = tail->next;
-                        tail->next = init_method->env;
-                    }
-                    else
-                    {
-                        exec_env = init_method->env;
-                    }
-                    exec_block(init_method->body->children[0], &exec_env);
-                    free(args);
-                }
-
-                gc_pop_root();
-                result = instance_val;
+                result = left;
                 break;
             }
-
-            if (callee.type == VAL_FUNC && callee.func->owner_class != NULL)
-            {
-                // This is an unbound method call, like Animal.init(this, ...)
-                Func *func = callee.func;
-                int arg_count = node->children_count - 1;
-                if (arg_count < 1)
-                {
-                    report_error(node->line_num, "Unbound method call requires at least one argument for 'this'.");
-                }
-
-                Value *args = malloc(arg_count * sizeof(Value));
-                for (int i = 0; i < arg_count; i++)
-                {
-                    args[i] = eval(node->children[i + 1], env);
-                }
-
-                Value this_val = args[0];
-                // TODO: Add type checking to ensure this_val is an instance of func->owner_class or a subclass
-
-                Env *arg_env = NULL;
-                env_define(&arg_env, "this", this_val);
-                for (int i = 1; i < arg_count; i++)
-                {
-                    env_define(&arg_env, func->body->args[i - 1], args[i]);
-                }
-
-                Env *exec_env = arg_env;
-                if (exec_env)
-                {
-                    Env *tail = exec_env;
-                    while (tail->next != NULL)
-                        tail = tail->next;
-                    tail->next = func->env;
-                }
-                else
-                {
-                    exec_env = func->env;
-                }
-                result = exec_block(func->body->children[0], &exec_env);
-                free(args);
-            }
-            else
-            {
-                // Standard function call or bound method call
-                int arg_offset = (callee.type == VAL_BOUND_METHOD) ? 1 : 0;
-                int arg_count = (node->children_count - 1) + arg_offset;
-                Value *args = malloc(arg_count * sizeof(Value));
-
-                if (callee.type == VAL_BOUND_METHOD)
-                {
-                    args[0] = callee.bound_method->receiver;
-                }
-                for (int i = 1; i < node->children_count; i++)
-                {
-                    args[i - 1 + arg_offset] = eval(node->children[i], env);
-                }
-
-                if (callee.type == VAL_BOUND_METHOD)
-                {
-                    if (callee.bound_method->method.type == VAL_NATIVE_FN)
-                    {
-                        set_exec_error_line(node->line_num);
-                        result = callee.bound_method->method.native_fn(arg_count, args);
-                    }
-                    else
-                    {
-                        Func *method = callee.bound_method->method.func;
-                        Env *arg_env = NULL;
-                        env_define(&arg_env, "this", callee.bound_method->receiver);
-                        for (int i = 0; i < (arg_count - arg_offset); i++)
-                        {
-                            env_define(&arg_env, method->body->args[i], args[i + arg_offset]);
-                        }
-                        Env *exec_env = arg_env;
-                        if (exec_env)
-                        {
-                            Env *tail = exec_env;
-                            while (tail->next != NULL)
-                                tail = tail->next;
-                            tail->next = method->env;
-                        }
-                        else
-                        {
-                            exec_env = method->env;
-                        }
-                        result = exec_block(method->body->children[0], &exec_env);
-                    }
-                    free(args);
-                }
-                else if (callee.type == VAL_FUNC)
-                {
-                    Func *func = callee.func;
-                    Env *arg_env = NULL;
-                    for (int i = 0; i < arg_count; i++)
-                    {
-                        env_define(&arg_env, func->body->args[i], args[i]);
-                    }
-                    Env *exec_env = arg_env;
-                    if (exec_env)
-                    {
-                        Env *tail = exec_env;
-                        while (tail->next != NULL)
-                            tail = tail->next;
-                        tail->next = func->env;
-                    }
-                    else
-                    {
-                        exec_env = func->env;
-                    }
-                    result = exec_block(func->body->children[0], &exec_env);
-                    free(args);
-                }
-                else if (callee.type == VAL_NATIVE_FN)
-                {
-                    set_exec_error_line(node->line_num);
-                    result = callee.native_fn(arg_count, args);
-                    free(args);
-                }
-                else
-                {
-                    report_error(node->line_num, "Expression is not callable.");
-                }
-            }
+            gc_push_value(left);
+            Value right = eval(node->children[1], env);
+            gc_pop_root();
+            result = eval_binary_op(node->op, left, right);
             break;
         }
+        case AST_FUNC_CALL:
+            result = eval_call(node, env, 0);
+            break;
         default:
             result = (Value){VAL_VOID};
             break;
@@ -1999,24 +3471,37 @@ Value eval(ASTNode *node, Env *env)
     return result;
 }
 
-void exec_module(ASTNode *root, Env **env_ptr)
+void exec_module(ASTNode *root, Env *env)
 {
     for (int i = 0; i < root->children_count; i++)
     {
-        exec(root->children[i], env_ptr);
+        exec(root->children[i], env);
     }
 }
 
+Value exec(ASTNode *node, Env *env)
+{
+    if (!node)
+        return (Value){VAL_VOID};
+#ifdef DEBUG_NO_CLOSURE_COMPILER
+    return exec_node(node, env);
+#else
+    ClosureNode *closure = node->closure ? node->closure : compile_statement_closure(node);
+    return closure->fn(closure, env);
+#endif
+}
+
 /**
- * @brief Executes a statement AST node.
+ * @brief Executes a statement AST node by switching on its type.
  *
- * Handles variable declarations, control flow (if, while, for), class definitions, etc.
+ * Handles variable declarations, control flow (if, while, for), class definitions, etc. Nodes
+ * run through their closures, which only come back here for shapes without a specialisation.
  *
  * @param node The statement node.
- * @param env_ptr Pointer to the current environment pointer.
+ * @param env The current frame.
  * @return The result of the execution (e.g., return value, break/continue signal).
  */
-Value exec(ASTNode *node, Env **env_ptr)
+Value exec_node(ASTNode *node, Env *env)
 {
     if (!node)
         return (Value){VAL_VOID};
@@ -2032,15 +3517,18 @@ Value exec(ASTNode *node, Env **env_ptr)
         case AST_CLASS_DEF:
         {
             PithClass *pith_class = (PithClass *) allocate_obj(sizeof(PithClass), OBJ_CLASS);
+            pith_class->id = next_class_id++;
             pith_class->name = strdup(node->value);
-            pith_class->methods = hashmap_create(VAL_STRING, VAL_FUNC);
+            pith_class->methods = NULL;
             pith_class->fields = NULL;
             pith_class->field_count = 0;
             pith_class->parent = NULL;
+            gc_push_root((ObjHeader *) pith_class);
+            pith_class->methods = hashmap_create(VAL_STRING, VAL_FUNC);
 
             if (node->parent_class_name)
             {
-                Value parent_val = env_get(*env_ptr, node->parent_class_name, node->line_num);
+                Value parent_val = eval(node->children[0], env); // Resolved reference to the parent
                 if (parent_val.type != VAL_CLASS)
                 {
                     report_error(node->line_num, "Parent '%s' is not a class.", node->parent_class_name);
@@ -2049,21 +3537,17 @@ Value exec(ASTNode *node, Env **env_ptr)
                 pith_class->parent = parent_class;
 
                 // Copy parent methods
-                for (int i = 0; i < parent_class->methods->bucket_count; i++)
+                for (int i = 0; i < parent_class->methods->capacity; i++)
                 {
-                    for (MapEntry *entry = parent_class->methods->buckets[i]; entry != NULL; entry = entry->next)
-                    {
+                    MapEntry *entry = &parent_class->methods->entries[i];
+                    if (entry->key)
                         hashmap_set(pith_class->methods, entry->key, entry->value, node->line_num);
-                    }
                 }
                 // Copy parent fields
                 if (parent_class->field_count > 0)
                 {
-                    pith_class->fields = malloc(sizeof(char *) * parent_class->field_count);
-                    for (int i = 0; i < parent_class->field_count; i++)
-                    {
-                        pith_class->fields[i] = strdup(parent_class->fields[i]);
-                    }
+                    pith_class->fields = malloc(sizeof(ObjString *) * parent_class->field_count);
+                    memcpy(pith_class->fields, parent_class->fields, sizeof(ObjString *) * parent_class->field_count);
                     pith_class->field_count = parent_class->field_count;
                 }
             }
@@ -2078,7 +3562,8 @@ Value exec(ASTNode *node, Env **env_ptr)
             Value class_val;
             class_val.type = VAL_CLASS;
             class_val.pith_class = pith_class;
-            env_define(env_ptr, pith_class->name, class_val);
+            env_define(env, node, class_val);
+            gc_pop_root();
 
             // Process the body of the class for inline definitions
             for (int i = 0; i < node->children_count; i++)
@@ -2086,16 +3571,14 @@ Value exec(ASTNode *node, Env **env_ptr)
                 ASTNode *child = node->children[i];
                 if (child->type == AST_FIELD_DECL)
                 {
-                    pith_class->field_count++;
-                    pith_class->fields = realloc(pith_class->fields, sizeof(char *) * pith_class->field_count);
-                    pith_class->fields[pith_class->field_count - 1] = strdup(child->value);
+                    add_class_field(pith_class, copy_string(child->value, (int) strlen(child->value)));
                 }
                 else if (child->type == AST_FUNC_DEF)
                 {
                     Func *func = (Func *) allocate_obj(sizeof(Func), OBJ_FUNC);
                     func->name = strdup(child->value);
                     func->body = child;
-                    func->env = *env_ptr;
+                    func->env = env;
                     func->owner_class = pith_class;
 
                     Value func_val;
@@ -2105,7 +3588,10 @@ Value exec(ASTNode *node, Env **env_ptr)
 #ifdef DEBUG_TRACE_FUNCTION_DEFINING
                     printf("[FUNC_DEF] Attaching method '%s' to class '%s'\n", func->name, pith_class->name);
 #endif
-                    hashmap_set(pith_class->methods, func->name, func_val, child->line_num);
+                    gc_push_root((ObjHeader *) func);
+                    ObjString *method_name = copy_string(func->name, (int) strlen(func->name));
+                    gc_pop_root();
+                    hashmap_set(pith_class->methods, method_name, func_val, child->line_num);
                 }
             }
             break;
@@ -2122,7 +3608,7 @@ Value exec(ASTNode *node, Env **env_ptr)
             Func *func = (Func *) allocate_obj(sizeof(Func), OBJ_FUNC);
             func->name = strdup(node->value);
             func->body = node;
-            func->env = *env_ptr;
+            func->env = env;
             func->owner_class = NULL; // Not owned by a class
 
             Value func_val;
@@ -2132,14 +3618,14 @@ Value exec(ASTNode *node, Env **env_ptr)
 #ifdef DEBUG_TRACE_FUNCTION_DEFINING
             printf("[FUNC_DEF] Defining global function '%s'\n", func->name);
 #endif
-            env_define(env_ptr, func->name, func_val);
+            env_define(env, node, func_val);
             break;
         }
         case AST_PRINT:
         {
             for (int i = 0; i < node->children_count; i++)
             {
-                Value val = eval(node->children[i], *env_ptr);
+                Value val = eval(node->children[i], env);
                 print_value(val);
                 if (i < node->children_count - 1)
                     printf(" ");
@@ -2169,11 +3655,11 @@ Value exec(ASTNode *node, Env **env_ptr)
                         sscanf(node->type_name, "list<%31[^>]>", inner);
                         list->element_type = get_type_from_name(inner);
                     }
-                    env_define(env_ptr, node->value, (Value){.type = VAL_LIST, .list = list});
+                    env_define(env, node, (Value){.type = VAL_LIST, .list = list});
                 }
                 else
                 {
-                    Value size_val = eval(array_spec->children[0], *env_ptr);
+                    Value size_val = eval(array_spec->children[0], env);
                     int size = size_val.int_val;
 
 #ifdef DEBUG_TRACE_MEMORY
@@ -2192,7 +3678,7 @@ Value exec(ASTNode *node, Env **env_ptr)
                     Value list_val;
                     list_val.type = VAL_LIST;
                     list_val.list = list;
-                    env_define(env_ptr, node->value, list_val);
+                    env_define(env, node, list_val);
                 }
             }
             else if (strncmp(node->type_name, "map<", 4) == 0)
@@ -2215,132 +3701,83 @@ Value exec(ASTNode *node, Env **env_ptr)
 
                     for (int i = 0; i < literal->children_count; i += 2)
                     {
-                        Value key = eval(literal->children[i], *env_ptr);
-                        Value val = eval(literal->children[i + 1], *env_ptr);
-                        hashmap_set(map_val.hashmap, key.str_val, val, literal->line_num);
+                        Value key = eval(literal->children[i], env);
+                        gc_push_value(key);
+                        Value val = eval(literal->children[i + 1], env);
+                        gc_pop_root();
+                        hashmap_set(map_val.hashmap, key.string, val, literal->line_num);
                     }
 
                     gc_pop_root();
                 }
-                env_define(env_ptr, node->value, map_val);
+                env_define(env, node, map_val);
             }
             else
             {
-                Value val = (node->children_count > 0) ? eval(node->children[0], *env_ptr) : (Value){VAL_VOID};
+                Value val = (node->children_count > 0) ? eval(node->children[0], env) : (Value){VAL_VOID};
                 // If a declared list type is provided, enforce element types when initializer is a list
-                if (node->type_name && strncmp(node->type_name, "list<", 5) == 0)
-                {
-                    char inner[32];
-                    sscanf(node->type_name, "list<%31[^>]>", inner);
-                    ValueType declared = get_type_from_name(inner);
-                    if (val.type == VAL_LIST)
-                    {
-                        // Set element_type on the created list and validate
-                        val.list->element_type = declared;
-                        for (int i = 0; i < val.list->count; i++)
-                        {
-                            if (declared != VAL_VOID && val.list->items[i].type != declared)
-                            {
-                                report_error(node->line_num,
-                                             "Type mismatch in list literal: expected elements of type '%s'.",
-                                             get_value_type_name(declared));
-                            }
-                        }
-                    }
-                    else if (val.type == VAL_VOID)
-                    {
-                        // Nothing to do: already handled above for empty list creation
-                    }
-                    else
-                    {
-                        // If initializer is not a list, it's a type error
-                        report_error(node->line_num, "Type mismatch: declared '%s' but initializer is '%s'.",
-                                     node->type_name, get_value_type_name(val.type));
-                    }
-                }
-                env_define(env_ptr, node->value, val);
+                apply_declared_list_type(node, val);
+                env_define(env, node, val);
             }
             break;
         }
         case AST_ASSIGNMENT:
         {
             ASTNode *target = node->children[0];
-            Value val_to_assign = eval(node->children[1], *env_ptr);
+            Value val_to_assign = eval(node->children[1], env);
             if (target->type == AST_VAR_REF)
             {
-                env_assign(*env_ptr, target->value, val_to_assign, target->line_num);
+                env_assign(env, target, val_to_assign);
             }
             else if (target->type == AST_FIELD_ACCESS)
             {
-                Value object = eval(target->children[0], *env_ptr);
-                if (object.type == VAL_INSTANCE)
-                {
-                    hashmap_set(object.instance->fields, target->value, val_to_assign, target->line_num);
-                }
-                else
-                {
-                    report_error(target->line_num, "Cannot assign to a field on a value of type '%s'.",
-                                 get_value_type_name(object.type));
-                }
+                gc_push_value(val_to_assign);
+                Value object = eval(target->children[0], env);
+                set_field_cached(object, MEMBER_NAME(target), val_to_assign, target->cache, target->line_num);
+                gc_pop_root();
             }
             else if (target->type == AST_INDEX_ACCESS)
             {
-                Value collection = eval(target->children[0], *env_ptr);
-                Value index_val = eval(target->children[1], *env_ptr);
+                gc_push_value(val_to_assign);
+                Value collection = eval(target->children[0], env);
+                gc_push_value(collection);
+                Value index_val = eval(target->children[1], env);
 
 #ifdef DEBUG_DEEP_DIVE_INTERP
                 printf("[DDI_ASSIGN_INDEX] Assigning to index\n");
 #endif
 
-                if (collection.type == VAL_HASHMAP)
-                {
-                    if (index_val.type != VAL_STRING)
-                        report_error(target->line_num, "Hashmap index must be a string.");
-                    hashmap_set(collection.hashmap, index_val.str_val, val_to_assign, target->line_num);
-                }
-                else if (collection.type == VAL_LIST)
-                {
-                    if (index_val.type != VAL_INT)
-                        report_error(target->line_num, "List or array index must be an integer.");
-                    int index = index_val.int_val;
-                    if (index < 0 || index >= collection.list->count)
-                        report_error(target->line_num, "Index out of bounds.");
-                    collection.list->items[index] = val_to_assign;
-                }
-                else
-                {
-                    report_error(target->line_num,
-                                 "Index assignment is only supported for lists, arrays, and hashmaps.");
-                }
+                set_index(collection, index_val, val_to_assign, target->line_num);
+                gc_pop_roots(2);
             }
             break;
         }
         case AST_IF:
         {
-            Value cond = eval(node->children[0], *env_ptr);
+            Value cond = eval(node->children[0], env);
             if (cond.int_val)
             {
-                return exec_block(node->children[1], env_ptr);
+                return exec_block(node->children[1], env);
             }
             else if (node->children_count > 2)
             {
                 ASTNode *else_node = node->children[2];
                 if (else_node->type == AST_IF)
                 {
-                    return exec(else_node, env_ptr);
+                    return exec(else_node, env);
                 }
                 else
                 {
-                    return exec_block(else_node, env_ptr);
+                    return exec_block(else_node, env);
                 }
             }
             break;
         }
         case AST_WHILE:
         {
-            while (eval(node->children[0], *env_ptr).int_val)
+            while (eval(get_child(node, 0), env).int_val)
             {
-                Value result = exec_block(node->children[1], env_ptr);
+                Value result = exec_loop_body(node, get_child(node, 1), env, NULL);
                 if (result.type == VAL_BREAK)
                     break;
                 if (result.type == VAL_CONTINUE)
@@ -2352,18 +3789,18 @@ Value exec(ASTNode *node, Env **env_ptr)
         }
         case AST_FOREACH:
         {
-            Value collection = eval(node->children[0], *env_ptr);
+            Value collection = eval(get_child(node, 0), env);
             if (collection.type != VAL_LIST)
             {
                 report_error(node->line_num, "foreach loop can only iterate over a list or array.");
             }
 
+            // The list may be a temporary, so it stays rooted for the whole loop.
+            gc_push_value(collection);
             List *list = collection.list;
+            Value loop_result = {VAL_VOID};
             for (int i = 0; i < list->count; i++)
             {
-                Env *loop_env = *env_ptr;
-                env_define(&loop_env, node->value, list->items[i]);
-
 #ifdef DEBUG_TRACE_EXECUTION
                 printf("[EXEC] foreach loop iteration %d: defining '%s'\n", i, node->value);
 #endif
@@ -2371,26 +3808,31 @@ Value exec(ASTNode *node, Env **env_ptr)
                 printf("[DDI_FOREACH_LOOP] Iteration %d: defining '%s'\n", i, node->value);
 #endif
 
-                Value result = exec_block(node->children[1], &loop_env);
+                Value result = exec_loop_body(node, get_child(node, 1), env, &list->items[i]);
                 if (result.type == VAL_BREAK)
                     break;
                 if (result.type == VAL_CONTINUE)
                     continue;
                 if (result.type != VAL_VOID)
-                    return result;
+                {
+                    loop_result = result;
+                    break;
+                }
             }
+            gc_pop_root();
+            if (loop_result.type != VAL_VOID)
+                return loop_result;
             break;
         }
         case AST_FOR:
         {
-            Env *for_env = *env_ptr;
 #ifdef DEBUG_TRACE_EXECUTION
             printf("[EXEC] for loop initializer\n");
 #endif
 #ifdef DEBUG_DEEP_DIVE_INTERP
             printf("[DDI_FOR_LOOP] Initializer\n");
 #endif
-            exec(node->children[0], &for_env);
+            exec(get_child(node, 0), env);
 
             while (1)
             {
@@ -2400,11 +3842,11 @@ Value exec(ASTNode *node, Env **env_ptr)
 #ifdef DEBUG_DEEP_DIVE_INTERP
                 printf("[DDI_FOR_LOOP] Condition check\n");
 #endif
-                Value condition = eval(node->children[1], for_env);
+                Value condition = eval(get_child(node, 1), env);
                 if (!condition.int_val)
                     break;
 
-                Value result = exec_block(node->children[3], &for_env);
+                Value result = exec_loop_body(node, get_child(node, 3), env, NULL);
                 if (result.type == VAL_BREAK)
                     break;
                 if (result.type == VAL_CONTINUE)
@@ -2415,7 +3857,7 @@ Value exec(ASTNode *node, Env **env_ptr)
 #ifdef DEBUG_DEEP_DIVE_INTERP
                     printf("[DDI_FOR_LOOP] Increment\n");
 #endif
-                    exec(node->children[2], &for_env);
+                    exec(get_child(node, 2), env);
                     continue;
                 }
                 if (result.type != VAL_VOID)
@@ -2427,7 +3869,7 @@ Value exec(ASTNode *node, Env **env_ptr)
 #ifdef DEBUG_DEEP_DIVE_INTERP
                 printf("[DDI_FOR_LOOP] Increment\n");
 #endif
-                exec(node->children[2], &for_env);
+                exec(get_child(node, 2), env);
             }
             break;
         }
@@ -2435,7 +3877,7 @@ Value exec(ASTNode *node, Env **env_ptr)
         {
             do
             {
-                Value result = exec_block(node->children[0], env_ptr);
+                Value result = exec_loop_body(node, get_child(node, 0), env, NULL);
                 if (result.type == VAL_BREAK)
                     break;
                 if (result.type == VAL_CONTINUE)
@@ -2443,12 +3885,13 @@ Value exec(ASTNode *node, Env **env_ptr)
                 if (result.type != VAL_VOID)
                     return result;
             }
-            while (eval(node->children[1], *env_ptr).int_val);
+            while (eval(get_child(node, 1), env).int_val);
             break;
         }
         case AST_SWITCH:
         {
-            Value expr_val = eval(node->children[0], *env_ptr);
+            Value expr_val = eval(node->children[0], env);
+            gc_push_value(expr_val);
             int matched = 0;
 
             for (int i = 1; i < node->children_count; i++)
@@ -2456,20 +3899,21 @@ Value exec(ASTNode *node, Env **env_ptr)
                 ASTNode *case_node = node->children[i];
                 if (case_node->type == AST_CASE)
                 {
-                    Value case_val = eval(case_node->children[0], *env_ptr);
+                    Value case_val = eval(case_node->children[0], env);
 
                     if (matched || (expr_val.type == case_val.type &&
                                     ((expr_val.type == VAL_INT && expr_val.int_val == case_val.int_val) ||
-                                     (expr_val.type == VAL_STRING && strcmp(expr_val.str_val, case_val.str_val) == 0))))
+                                     (expr_val.type == VAL_STRING && expr_val.string == case_val.string))))
                     {
                         matched = 1;
                         if (case_node->children_count > 1)
                         {
-                            Value result = exec_block(case_node->children[1], env_ptr);
-                            if (result.type == VAL_BREAK)
-                                return (Value){VAL_VOID};
+                            Value result = exec_block(case_node->children[1], env);
                             if (result.type != VAL_VOID)
-                                return result;
+                            {
+                                gc_pop_root();
+                                return result.type == VAL_BREAK ? (Value){VAL_VOID} : result;
+                            }
                         }
                     }
                 }
@@ -2479,11 +3923,12 @@ Value exec(ASTNode *node, Env **env_ptr)
                     {
                         if (case_node->children_count > 0)
                         {
-                            Value result = exec_block(case_node->children[0], env_ptr);
-                            if (result.type == VAL_BREAK)
-                                return (Value){VAL_VOID};
+                            Value result = exec_block(case_node->children[0], env);
                             if (result.type != VAL_VOID)
-                                return result;
+                            {
+                                gc_pop_root();
+                                return result.type == VAL_BREAK ? (Value){VAL_VOID} : result;
+                            }
                         }
                     }
                 }
@@ -2498,15 +3943,17 @@ Value exec(ASTNode *node, Env **env_ptr)
                         ASTNode *default_node = node->children[i];
                         if (default_node->children_count > 0)
                         {
-                            Value result = exec_block(default_node->children[0], env_ptr);
-                            if (result.type == VAL_BREAK)
-                                return (Value){VAL_VOID};
+                            Value result = exec_block(default_node->children[0], env);
                             if (result.type != VAL_VOID)
-                                return result;
+                            {
+                                gc_pop_root();
+                                return result.type == VAL_BREAK ? (Value){VAL_VOID} : result;
+                            }
                         }
                     }
                 }
             }
+            gc_pop_root();
             break;
         }
         case AST_BREAK:
@@ -2531,50 +3978,93 @@ Value exec(ASTNode *node, Env **env_ptr)
                 source = read_file_content(module_name);
             }
 
-            Env *module_env = NULL;
-            Value native_mod_val = hashmap_get(native_module_funcs, node->value);
+            // The functions of a native module are predeclared in the module's frame, so its
+            // Pith code can call them by name.
+            int native_count = 0;
+            const char **native_names = NULL;
+            Value *native_values = NULL;
+            Value native_mod_val = hashmap_get(native_module_funcs, copy_string(node->value, (int) strlen(node->value)));
             if (native_mod_val.type == VAL_HASHMAP)
             {
                 HashMap *funcs = native_mod_val.hashmap;
-                for (int i = 0; i < funcs->bucket_count; i++)
+                int capacity = funcs->count > 0 ? funcs->count : 1;
+                native_names = malloc(capacity * sizeof(const char *));
+                native_values = malloc(capacity * sizeof(Value));
+                for (int i = 0; i < funcs->capacity; i++)
                 {
-                    for (MapEntry *entry = funcs->buckets[i]; entry != NULL; entry = entry->next)
-                    {
-                        env_define(&module_env, entry->key, entry->value);
-                    }
+                    MapEntry *entry = &funcs->entries[i];
+                    if (!entry->key)
+                        continue;
+                    native_names[native_count] = entry->key->chars;
+                    native_values[native_count] = entry->value;
+                    native_count++;
                 }
             }
 
+            ASTNode *module_ast = NULL;
+            int slot_count = native_count;
             if (source)
             {
                 TokenizerState t_state;
                 tokenize(source, &t_state);
                 ParserState p_state = {&t_state, 0};
-                ASTNode *module_ast = parse_program(&p_state);
-                exec_module(module_ast, &module_env);
+                module_ast = parse_program(&p_state);
+                resolve_module(module_ast, native_names, native_count);
+                slot_count = module_ast->slot_count;
                 free(source);
             }
 
+            Env *module_env = env_new(slot_count, NULL);
+            for (int i = 0; i < native_count; i++)
+            {
+                module_env->slots[i] = native_values[i];
+            }
+            push_frame(module_env);
+            if (module_ast)
+            {
+                exec_module(module_ast, module_env);
+            }
+
             Module *module = (Module *) allocate_obj(sizeof(Module), OBJ_MODULE);
+            gc_push_root((ObjHeader *) module);
             module->name = strdup(node->value);
+            module->members = NULL; // Keep the module markable if hashmap_create triggers a collection
             module->members = hashmap_create(VAL_STRING, VAL_VOID);
 
-            for (Env *e = module_env; e != NULL; e = e->next)
+            for (int i = 0; i < native_count; i++)
+            {
+                ObjString *name = copy_string(native_names[i], (int) strlen(native_names[i]));
+                hashmap_set(module->members, name, native_values[i], node->line_num);
+            }
+            // Every top-level declaration of the module becomes a member.
+            for (int i = 0; module_ast && i < module_ast->children_count; i++)
             {
-                hashmap_set(module->members, e->name, e->val, node->line_num);
+                ASTNode *decl = module_ast->children[i];
+                if (decl->type == AST_VAR_DECL || decl->type == AST_FUNC_DEF || decl->type == AST_CLASS_DEF ||
+                    decl->type == AST_IMPORT)
+                {
+                    ObjString *name = copy_string(decl->value, (int) strlen(decl->value));
+                    hashmap_set(module->members, name, module_env->slots[decl->slot], node->line_num);
+                }
             }
+            gc_pop_root();
+            pop_frame();
+            free(native_names);
+            free(native_values);
 
             Value module_val;
             module_val.type = VAL_MODULE;
             module_val.module = module;
 
-            env_define(env_ptr, node->value, module_val);
+            env_define(env, node, module_val);
             break;
         }
         case AST_RETURN:
-            return eval(node->children[0], *env_ptr);
+            if (node->tail_call)
+                return eval_call(node->children[0], env, 1);
+            return eval(node->children[0], env);
         default:
-            eval(node, *env_ptr);
+            eval(node, env);
             break;
     }
 
@@ -2584,7 +4074,8 @@ Value exec(ASTNode *node, Env **env_ptr)
 /**
  * @brief Entry point for interpreting an AST.
  *
- * Initializes the global environment with native functions and executes the program.
+ * Defines the native globals and executes the program, already annotated by `resolve_program`,
+ * with the engine selected by `execution_engine`.
  *
  * @param root The root AST node of the program.
  */
@@ -2595,38 +4086,59 @@ void interpret(ASTNode *root)
         printf("AST root is NULL!\n");
         return;
     }
-    define_all_natives_in_env(&global_env);
+    define_all_natives();
     register_all_native_methods();
     register_all_native_modules();
 
-    for (int i = 0; i < root->children_count; i++)
+    // Frame for variables declared inside top-level blocks; top-level declarations are globals.
+    Env *frame = env_new(root->slot_count, NULL);
+    push_frame(frame);
+    if (execution_engine == ENGINE_VM)
     {
-        exec(root->children[i], &global_env);
+        vm_run_program(root, frame);
     }
+    else
+    {
+        exec_module(root, frame);
+    }
+    pop_frame();
 }
 
 /**
- * @brief Reads the entire content of a file into a string.
+ * @brief Reads the entire content of a file, which may contain NUL bytes.
  *
  * @param filename The path to the file.
- * @return A dynamically allocated string containing the file content, or NULL on failure.
+ * @param length Receives the number of bytes read.
+ * @return A dynamically allocated, NUL-terminated buffer with the content, or NULL on failure.
  */
-char *read_file_content(const char *filename)
+static char *read_file_bytes(const char *filename, long *length)
 {
     FILE *file = fopen(filename, "rb");
     if (file == NULL)
         return NULL;
     fseek(file, 0, SEEK_END);
-    long length = ftell(file);
+    long size = ftell(file);
     fseek(file, 0, SEEK_SET);
-    char *buffer = malloc(length + 1);
+    char *buffer = malloc(size + 1);
     if (buffer == NULL)
     {
         fclose(file);
         return NULL;
     }
-    fread(buffer, 1, length, file);
-    buffer[length] = '\0';
+    *length = (long) fread(buffer, 1, size, file);
+    buffer[*length] = '\0';
     fclose(file);
     return buffer;
 }
+
+/**
+ * @brief Reads the entire content of a file into a string.
+ *
+ * @param filename The path to the file.
+ * @return A dynamically allocated string containing the file content, or NULL on failure.
+ */
+char *read_file_content(const char *filename)
+{
+    long length;
+    return read_file_bytes(filename, &length);
+}
@@ -12,6 +12,7 @@
 #include "parser.h"
 #include "value.h"
 #include "common.h" // Include the new common header for error reporting
+#include <stddef.h>
 
 /**
  * @brief Interprets and executes the given Abstract Syntax Tree (AST).
@@ -33,9 +34,18 @@ char *read_file_content(const char *filename);
 // --- Global State ---
 
 /**
- * @brief The global environment containing global variables and functions.
+ * @brief The engines available for executing a parsed program.
  */
-extern Env *global_env;
+typedef enum
+{
+    ENGINE_TREE_WALKER, // Recursive eval()/exec() over the AST (default)
+    ENGINE_VM // Bytecode compiler plus stack VM (see compiler.h / vm.h)
+} ExecutionEngine;
+
+/**
+ * @brief The engine used by `interpret` and for running user function bodies.
+ */
+extern ExecutionEngine execution_engine;
 
 /**
  * @brief Registry for native string methods (e.g., split, trim).
@@ -47,6 +57,16 @@ extern HashMap *native_string_methods;
  */
 extern HashMap *native_list_methods;
 
+/**
+ * @brief Registry for native StringBuilder methods (e.g., append, build).
+ */
+extern HashMap *native_string_builder_methods;
+
+/**
+ * @brief Registry for native hashmap methods (e.g., remove).
+ */
+extern HashMap *native_map_methods;
+
 /**
  * @brief Registry for native module functions (e.g., math.sqrt, io.read_file).
  */
@@ -55,10 +75,9 @@ extern HashMap *native_module_funcs;
 // --- Initialization Functions ---
 
 /**
- * @brief Defines all built-in native functions (clock, input, etc.) in the given environment.
- * @param env_ptr Pointer to the environment pointer.
+ * @brief Defines all built-in native functions (clock, input, etc.) as globals.
  */
-void define_all_natives_in_env(Env **env_ptr);
+void define_all_natives();
 
 /**
  * @brief Registers all native methods for built-in types (string, list).
@@ -73,35 +92,456 @@ void register_all_native_modules();
 // --- Interpreter Core Functions ---
 
 /**
- * @brief Evaluates an expression node.
+ * @brief Evaluates an expression node, through its closure (see closure.h).
  * @param node The AST node to evaluate.
- * @param env The current environment.
+ * @param env The current frame.
  * @return The result of the evaluation.
  */
 Value eval(ASTNode *node, Env *env);
 
 /**
- * @brief Executes a statement node.
+ * @brief Executes a statement node, through its closure (see closure.h).
  * @param node The AST node to execute.
- * @param env_ptr Pointer to the current environment pointer (may be modified).
+ * @param env The current frame.
  * @return The result of execution (e.g., return value, break signal).
  */
-Value exec(ASTNode *node, Env **env_ptr);
+Value exec(ASTNode *node, Env *env);
+
+/**
+ * @brief Evaluates an expression node by switching on its type (used for uncompiled shapes).
+ */
+Value eval_node(ASTNode *node, Env *env);
 
 /**
- * @brief Executes a block of statements in a new scope.
+ * @brief Executes a statement node by switching on its type (used for uncompiled shapes).
+ */
+Value exec_node(ASTNode *node, Env *env);
+
+/**
+ * @brief Executes a block of statements.
  * @param node The block AST node.
- * @param env_ptr Pointer to the current environment pointer.
+ * @param env The current frame.
  * @return The result of the block execution.
  */
-Value exec_block(ASTNode *node, Env **env_ptr);
+Value exec_block(ASTNode *node, Env *env);
+
+/**
+ * @brief Executes a module (a list of statements) in a given frame.
+ * @param root The root AST node of the module, annotated by the resolver.
+ * @param env The module's frame.
+ */
+void exec_module(ASTNode *root, Env *env);
+
+// --- Frames and Variables ---
+// Variables are addressed by the resolver (see resolver.h); nothing is looked up by name at run time.
+
+/**
+ * @brief Allocates a frame whose slots are all initialized to void.
+ * @param slot_count Number of variable slots (see `ASTNode.slot_count`).
+ * @param enclosing The frame the running code was defined in.
+ * @return The new frame.
+ */
+Env *env_new(int slot_count, Env *enclosing);
+
+/**
+ * @brief Runs one iteration of a loop body.
+ *
+ * A loop whose body defines a function or class (`ASTNode.frame_captured`) runs each iteration
+ * in a new frame enclosed by the loop's, so the closures made in it keep their own variables.
+ *
+ * @param loop The loop node.
+ * @param body The body block.
+ * @param env The loop's frame.
+ * @param variable The value of a foreach loop's variable for this iteration, or NULL.
+ * @return The result of the block (e.g., a break signal or return value).
+ */
+Value exec_loop_body(ASTNode *loop, ASTNode *body, Env *env, const Value *variable);
+
+/**
+ * @brief Registers a frame as running, protecting it from the GC until `pop_frame`.
+ * @param env The frame being entered.
+ */
+void push_frame(Env *env);
+
+/**
+ * @brief Unregisters the most recently entered frame.
+ */
+void pop_frame();
+
+/**
+ * @brief Abandons every running frame and temporary GC root, in both engines (used after the REPL recovers from an error).
+ */
+void reset_call_stack();
+
+/**
+ * @brief Allocates memory on top of the frame stack, which holds short-lived call frames and
+ * argument arrays.
+ * @param size Number of bytes.
+ * @return The memory, valid until it is passed to `frame_stack_release`.
+ */
+void *frame_stack_alloc(size_t size);
+
+/**
+ * @brief Releases an allocation of the frame stack and everything allocated after it.
+ * @param memory The most recent live allocation.
+ */
+void frame_stack_release(void *memory);
+
+/**
+ * @brief Defines the variable introduced by a declaration node.
+ * @param env The current frame.
+ * @param decl The declaring node (variable, function, class, import or foreach loop).
+ * @param val The initial value.
+ */
+void env_define(Env *env, ASTNode *decl, Value val);
+
+/**
+ * @brief Assigns to an existing variable.
+ * @param env The current frame.
+ * @param ref The AST_VAR_REF node being assigned to.
+ * @param val The new value.
+ */
+void env_assign(Env *env, ASTNode *ref, Value val);
+
+/**
+ * @brief Reads a variable.
+ * @param env The current frame.
+ * @param ref The AST_VAR_REF node being read.
+ * @return The value of the variable.
+ */
+Value env_get(Env *env, ASTNode *ref);
+
+/**
+ * @brief Returns the global table index for a name, creating an undefined entry if needed.
+ * @param name The variable name.
+ * @return The index of the entry.
+ */
+int global_slot(const char *name);
+
+/**
+ * @brief Defines (or redefines) a global.
+ * @param slot The global table index.
+ * @param val The value.
+ */
+void global_define(int slot, Value val);
+
+/**
+ * @brief Defines a global by name (used for native functions).
+ * @param name The variable name.
+ * @param val The value.
+ */
+void define_global(const char *name, Value val);
+
+/**
+ * @brief Reads a global, reporting an error if it has not been defined yet.
+ * @param slot The global table index.
+ * @param line The line number for error reporting.
+ * @return The value of the global.
+ */
+Value global_get(int slot, int line);
+
+/**
+ * @brief Reads a global without reporting an error.
+ * @param slot The global table index.
+ * @return The value of the global, or void if it has not been defined yet.
+ */
+Value global_peek(int slot);
+
+/**
+ * @brief Assigns to a global, reporting an error if it has not been defined yet.
+ * @param slot The global table index.
+ * @param val The new value.
+ * @param line The line number for error reporting.
+ */
+void global_assign(int slot, Value val, int line);
+
+/**
+ * @brief Marks the global table and the running frames (called by the GC).
+ */
+void mark_interpreter_roots();
+
+// --- Operations Shared by the Execution Engines ---
+
+/**
+ * @brief Applies a binary operator to two evaluated operands.
+ * @param op The binary operator (OPER_ADD to OPER_OR).
+ * @param left The left operand.
+ * @param right The right operand.
+ * @return The result, or void for unsupported operand types.
+ */
+Value eval_binary_op(Operator op, Value left, Value right);
+
+/**
+ * @brief Most operands of a `+` chain evaluated as one concatenation (see `concat_operands`).
+ */
+#define MAX_CONCAT_OPERANDS 32
+
+/**
+ * @brief Finds the operands of a left-nested `+` chain that builds a string, such as
+ *        `"x = " + x + ", y = " + y`.
+ *
+ * A chain longer than MAX_CONCAT_OPERANDS keeps its innermost additions in its first operand.
+ *
+ * @param node An expression node.
+ * @param operands Receives the operands, left to right (room for MAX_CONCAT_OPERANDS).
+ * @return The number of operands, or 0 unless the node is a chain of at least three operands
+ *         with a string literal among them or a result the checker proved to be a string.
+ */
+int concat_operands(ASTNode *node, ASTNode **operands);
+
+/**
+ * @brief Adds evaluated operands left to right, as a chain of `+` would.
+ *
+ * When every operand is a string, the result is built in one allocation; otherwise the
+ * operands are added pairwise with `eval_binary_op`. The caller keeps the operands rooted.
+ *
+ * @param count Number of operands.
+ * @param operands The operands.
+ * @return The sum or concatenation.
+ */
+Value concat_values(int count, Value *operands);
+
+/**
+ * @brief Applies a unary operator (OPER_NEGATE or OPER_NOT) to an evaluated operand.
+ * @param op The unary operator.
+ * @param operand The operand.
+ * @param line The line number for error reporting.
+ * @return The result of the operation.
+ */
+Value eval_unary_op(Operator op, Value operand, int line);
+
+/**
+ * @brief Finds the slot of a field in a class's instance layout.
+ * @param pith_class The class.
+ * @param name The interned field name.
+ * @return The slot, or -1 if the class has no such field.
+ */
+int class_field_slot(PithClass *pith_class, ObjString *name);
+
+/**
+ * @brief Reads a field, method or module member (`object.name`).
+ * @param object The receiver.
+ * @param name The member name.
+ * @param line The line number for error reporting.
+ * @return The member value.
+ */
+Value get_field(Value object, ObjString *name, int line);
+
+/**
+ * @brief Writes an instance field (`object.name = val`).
+ * @param object The receiver.
+ * @param name The field name.
+ * @param val The value to store.
+ * @param line The line number for error reporting.
+ */
+void set_field(Value object, ObjString *name, Value val, int line);
+
+/**
+ * @brief Reads a member like get_field, through the inline cache of the access site.
+ * @param object The receiver.
+ * @param name The member name.
+ * @param cache The site's cache.
+ * @param line The line number for error reporting.
+ * @return The member value.
+ */
+Value get_field_cached(Value object, ObjString *name, FieldCache *cache, int line);
+
+/**
+ * @brief Writes a field like set_field, through the inline cache of the assignment site.
+ * @param object The receiver.
+ * @param name The field name.
+ * @param val The value to store.
+ * @param cache The site's cache.
+ * @param line The line number for error reporting.
+ */
+void set_field_cached(Value object, ObjString *name, Value val, FieldCache *cache, int line);
+
+/**
+ * @brief Prints the inline cache hit and miss counts (only built with DEBUG_FIELD_CACHE_STATS).
+ */
+void print_field_cache_stats();
+
+/**
+ * @brief Reads a list or hashmap element (`collection[index]`).
+ * @param collection The collection.
+ * @param index_val The index or key.
+ * @param line The line number for error reporting.
+ * @return The element value.
+ */
+Value get_index(Value collection, Value index_val, int line);
+
+/**
+ * @brief Writes a list or hashmap element (`collection[index] = val`).
+ * @param collection The collection.
+ * @param index_val The index or key.
+ * @param val The value to store.
+ * @param line The line number for error reporting.
+ */
+void set_index(Value collection, Value index_val, Value val, int line);
+
+/**
+ * @brief Calls any callable value (function, method, native, or class) with evaluated arguments.
+ * @param callee The value being called.
+ * @param arg_count Number of arguments.
+ * @param args The argument values.
+ * @param line The line number for error reporting.
+ * @return The result of the call.
+ */
+Value call_value(Value callee, int arg_count, Value *args, int line);
+
+/**
+ * @brief Calls a member of a value (`object.name(args)`) without creating a bound method.
+ * @param name The member name.
+ * @param cache The inline cache of the member access.
+ * @param arg_count Number of arguments, not counting the receiver.
+ * @param args The receiver followed by the argument values.
+ * @param line The line number for error reporting.
+ * @return The result of the call.
+ */
+Value call_method(ObjString *name, FieldCache *cache, int arg_count, Value *args, int line);
+
+/**
+ * @brief Makes a call in tail position (`return f(args)`), like `call_value`.
+ *
+ * A call to a user-defined function is not run here: it is recorded and VAL_TAIL_CALL is
+ * returned, which the caller returns in turn so that `call_function` runs the call in place
+ * of the returning one. Other callees are called directly.
+ */
+Value tail_call_value(Value callee, int arg_count, Value *args, int line);
+
+/**
+ * @brief Makes a member call in tail position (`return object.name(args)`), like `call_method`.
+ * @see tail_call_value
+ */
+Value tail_call_method(ObjString *name, FieldCache *cache, int arg_count, Value *args, int line);
+
+/**
+ * @brief Calls a user-defined function, binding `this` when a receiver is given.
+ * @param func The function.
+ * @param this_val The receiver, or NULL.
+ * @param arg_count Number of arguments.
+ * @param args The argument values.
+ * @param line The line of the call, for a stack overflow error.
+ * @return The function's return value.
+ */
+Value call_function(Func *func, Value *this_val, int arg_count, Value *args, int line);
+
+/**
+ * @brief Creates an instance of a class and runs its `init` method.
+ * @param pclass The class.
+ * @param arg_count Number of constructor arguments.
+ * @param args The constructor arguments.
+ * @param line The line number for error reporting.
+ * @return The new instance.
+ */
+Value instantiate_class(PithClass *pclass, int arg_count, Value *args, int line);
+
+/**
+ * @brief Appends an item to a list, growing it if needed.
+ * @param list The list.
+ * @param item The item to append.
+ */
+void list_add(List *list, Value item);
+
+/**
+ * @brief Computes the hash of `length` characters (djb2).
+ * @param chars The characters.
+ * @param length The number of characters.
+ * @return The hash.
+ */
+unsigned long hash_string(const char *chars, int length);
+
+/**
+ * @brief Returns the interned string holding `length` characters, creating it if needed.
+ * @param chars The characters (need not be NUL-terminated).
+ * @param length The number of characters.
+ * @return The interned string.
+ */
+ObjString *copy_string(const char *chars, int length);
+
+/**
+ * @brief Returns the interned string holding part of another string.
+ *
+ * A substring of at least 16 characters (MIN_VIEW_LENGTH) that is not interned yet is made a view:
+ * it shares the characters of the string it was taken from instead of copying them.
+ *
+ * @param source The string to take the characters from.
+ * @param start Index of the first character.
+ * @param length The number of characters.
+ * @return The interned string.
+ */
+ObjString *copy_substring(ObjString *source, int start, int length);
+
+/**
+ * @brief Gives a view its own copy of its characters, so it no longer needs its parent.
+ */
+void materialise_string(ObjString *string);
+
+/**
+ * @brief Returns the characters of a string as a NUL-terminated C string.
+ *
+ * A view is not terminated where it ends, so it is first given its own copy of its characters.
+ */
+const char *string_chars(ObjString *string);
+
+/**
+ * @brief Like copy_string, for a malloc'd C string, which is freed.
+ * @param chars The NUL-terminated C string.
+ * @return The interned string.
+ */
+ObjString *take_string(char *chars);
+
+/**
+ * @brief Drops the strings the GC has not marked from the intern table (called by the GC).
+ */
+void remove_unmarked_strings();
+
+/**
+ * @brief Creates an empty, GC-managed hashmap.
+ * @param key_type The key type (always VAL_STRING at present).
+ * @param value_type The enforced value type, or VAL_VOID for any.
+ * @return The new hashmap.
+ */
+HashMap *hashmap_create(ValueType key_type, ValueType value_type);
+
+/**
+ * @brief Inserts or updates a hashmap entry, enforcing the map's value type.
+ * @param map The hashmap.
+ * @param key The key.
+ * @param value The value.
+ * @param line_num The line number for error reporting.
+ */
+void hashmap_set(HashMap *map, ObjString *key, Value value, int line_num);
+
+/**
+ * @brief Looks up a hashmap entry.
+ * @param map The hashmap.
+ * @param key The key.
+ * @return The value, or void if absent.
+ */
+Value hashmap_get(HashMap *map, ObjString *key);
+
+/**
+ * @brief Removes a hashmap entry, leaving a tombstone in its slot.
+ * @param map The hashmap.
+ * @param key The key.
+ * @return 1 if the key was present, 0 otherwise.
+ */
+int hashmap_delete(HashMap *map, ObjString *key);
+
+/**
+ * @brief Applies a declared `list<T>` type to a variable declaration's initializer.
+ * @param decl The AST_VAR_DECL node.
+ * @param val The initializer value.
+ */
+void apply_declared_list_type(ASTNode *decl, Value val);
 
 /**
- * @brief Executes a module (a list of statements) in a given environment.
- * @param root The root AST node of the module.
- * @param env_ptr Pointer to the module's environment pointer.
+ * @brief Returns a user-facing name for a value type.
+ * @param type The value type.
+ * @return The type name.
  */
-void exec_module(ASTNode *root, Env **env_ptr);
+const char *get_value_type_name(ValueType type);
 
 // --- Error Context ---
 
@@ -0,0 +1,820 @@
+/**
+ * @file jit.c
+ * @brief Implementation of the Pith baseline JIT compiler.
+ *
+ * Generated functions follow the System V AMD64 calling convention: up to six int arguments
+ * arrive in edi, esi, edx, ecx, r8d and r9d and the result is returned in eax, so `jit_call`
+ * calls them as plain C functions and compiled functions call each other directly. Every
+ * variable of the function has a 4-byte slot below rbp. Ints use 32-bit machine arithmetic,
+ * which wraps around exactly like the engines' C `int` operations.
+ */
+
+#include "jit.h"
+#include "interpreter.h"
+#include "constants.h"
+#include "resolver.h"
+#include "checker.h"
+#include "debug.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) && !defined(_WIN32)
+#define JIT_SUPPORTED 1
+#include <sys/mman.h>
+#include <unistd.h>
+#else
+#define JIT_SUPPORTED 0
+#endif
+
+/**
+ * @brief Calls a function takes on its engine before it is compiled.
+ */
+#define JIT_THRESHOLD 100
+
+/**
+ * @brief Condition code of `emit_jump` for an unconditional jump.
+ */
+#define JUMP_ALWAYS (-1)
+
+typedef enum
+{
+    JIT_COUNTING, // Running on the engine until it is hot
+    JIT_COMPILING, // Being compiled (calls to it cannot be bound yet)
+    JIT_COMPILED, // Running as machine code
+    JIT_FAILED // Uses something the JIT does not compile; stays on the engine
+} JitState;
+
+struct JitFunction
+{
+    JitState state;
+    int calls; // Calls counted while JIT_COUNTING
+    JitEntry entry; // The native code; compiled callers call through this field
+    ValueType return_type; // VAL_INT or VAL_BOOL
+};
+
+int jit_enabled = 0;
+
+int jit_is_supported()
+{
+    return JIT_SUPPORTED;
+}
+
+void free_jit_function(JitFunction *jit)
+{
+    free(jit);
+}
+
+static JitFunction *jit_function_of(ASTNode *def)
+{
+    if (!def->jit)
+    {
+        def->jit = malloc(sizeof(JitFunction));
+        if (!def->jit)
+        {
+            fprintf(stderr, "Fatal: Memory allocation failed for JIT function.\n");
+            exit(1);
+        }
+        def->jit->state = JIT_SUPPORTED ? JIT_COUNTING : JIT_FAILED;
+        def->jit->calls = 0;
+        def->jit->entry = NULL;
+        def->jit->return_type = VAL_VOID;
+    }
+    return def->jit;
+}
+
+#if JIT_SUPPORTED
+
+// --- Emitter ---
+
+/**
+ * @brief Register numbers as encoded in instructions.
+ */
+enum
+{
+    REG_EAX = 0,
+    REG_ECX = 1,
+    REG_EDX = 2,
+    REG_ESI = 6,
+    REG_EDI = 7,
+    REG_R8D = 8,
+    REG_R9D = 9
+};
+
+static const int argument_registers[JIT_MAX_PARAMS] = {REG_EDI, REG_ESI, REG_EDX, REG_ECX, REG_R8D, REG_R9D};
+
+/**
+ * @brief A `break` or `continue` jump waiting for the end of its loop.
+ */
+typedef struct
+{
+    int offset; // Offset of the jump's rel32 field
+    int loop; // Loop depth of the loop it leaves or continues
+    int is_continue;
+} PendingJump;
+
+typedef struct
+{
+    Func *func; // The function being compiled
+    ASTNode *def;
+    unsigned char *code;
+    int count;
+    int capacity;
+    int pushes; // Temporaries on the machine stack, to keep calls 16-byte aligned
+    int loop_depth;
+    PendingJump *jumps;
+    int jump_count;
+    int jump_capacity;
+    int return_type; // Type of the values returned so far, or TYPE_UNPROVEN before the first return
+    ASTNode *rejected; // The first node the JIT could not compile
+} Emitter;
+
+static void emit_byte(Emitter *e, int byte)
+{
+    if (e->count >= e->capacity)
+    {
+        e->capacity = e->capacity < 256 ? 256 : e->capacity * 2;
+        e->code = realloc(e->code, e->capacity);
+        if (!e->code)
+        {
+            fprintf(stderr, "Fatal: Memory allocation failed for JIT code.\n");
+            exit(1);
+        }
+    }
+    e->code[e->count++] = (unsigned char) byte;
+}
+
+static void emit_int32(Emitter *e, int value)
+{
+    unsigned int bits = (unsigned int) value;
+    for (int i = 0; i < 4; i++)
+        emit_byte(e, (bits >> (8 * i)) & 0xFF);
+}
+
+static void emit_pointer(Emitter *e, const void *pointer)
+{
+    unsigned long long bits = (unsigned long long) (size_t) pointer;
+    for (int i = 0; i < 8; i++)
+        emit_byte(e, (bits >> (8 * i)) & 0xFF);
+}
+
+/**
+ * @brief Emits a jump with a 32-bit displacement to be patched.
+ * @param condition A condition code (the low nibble of Jcc), or JUMP_ALWAYS.
+ * @return The offset of the displacement.
+ */
+static int emit_jump(Emitter *e, int condition)
+{
+    if (condition == JUMP_ALWAYS)
+    {
+        emit_byte(e, 0xE9);
+    }
+    else
+    {
+        emit_byte(e, 0x0F);
+        emit_byte(e, 0x80 | condition);
+    }
+    emit_int32(e, 0);
+    return e->count - 4;
+}
+
+static void patch_jump(Emitter *e, int offset, int target)
+{
+    int displacement = target - (offset + 4);
+    unsigned int bits = (unsigned int) displacement;
+    for (int i = 0; i < 4; i++)
+        e->code[offset + i] = (bits >> (8 * i)) & 0xFF;
+}
+
+static void emit_jump_to(Emitter *e, int condition, int target)
+{
+    patch_jump(e, emit_jump(e, condition), target);
+}
+
+/**
+ * @brief Emits `op [rbp - 4 * (slot + 1)], reg` (0x89, a store) or `op reg, [...]` (0x8B, a load).
+ */
+static void emit_slot_access(Emitter *e, int opcode, int reg, int slot)
+{
+    if (reg >= 8)
+        emit_byte(e, 0x44); // REX.R
+    emit_byte(e, opcode);
+    emit_byte(e, 0x80 | ((reg & 7) << 3) | 5); // [rbp + disp32]
+    emit_int32(e, -4 * (slot + 1));
+}
+
+static void emit_push_eax(Emitter *e)
+{
+    emit_byte(e, 0x50); // push rax
+    e->pushes++;
+}
+
+static void emit_pop(Emitter *e, int reg)
+{
+    if (reg >= 8)
+        emit_byte(e, 0x41); // REX.B
+    emit_byte(e, 0x58 | (reg & 7)); // pop
+    e->pushes--;
+}
+
+static void emit_test_eax(Emitter *e)
+{
+    emit_byte(e, 0x85); // test eax, eax
+    emit_byte(e, 0xC0);
+}
+
+static void emit_leave(Emitter *e)
+{
+    emit_byte(e, 0xC9); // leave
+}
+
+/**
+ * @brief Records the first node the function cannot be compiled past.
+ * @return 0, for the caller to return.
+ */
+static int reject(Emitter *e, ASTNode *node)
+{
+    if (!e->rejected)
+        e->rejected = node;
+    return 0;
+}
+
+// --- Expressions ---
+
+static int is_machine_type(int type)
+{
+    return type == VAL_INT || type == VAL_BOOL;
+}
+
+/**
+ * @brief Returns the condition code under which a comparison holds, or -1 for other operators.
+ */
+static int condition_code(Operator op)
+{
+    switch (op)
+    {
+        case OPER_LESS:
+            return 0xC;
+        case OPER_GREATER:
+            return 0xF;
+        case OPER_LESS_EQUAL:
+            return 0xE;
+        case OPER_GREATER_EQUAL:
+            return 0xD;
+        case OPER_EQUAL:
+            return 0x4;
+        case OPER_NOT_EQUAL:
+            return 0x5;
+        default:
+            return -1;
+    }
+}
+
+static int compile_function(Func *func);
+static int emit_expression(Emitter *e, ASTNode *node);
+
+/**
+ * @brief Emits the operands of an int operation: the left one ends in eax, the right one in ecx.
+ */
+static int emit_operands(Emitter *e, ASTNode *node)
+{
+    ASTNode *left = node->children[0];
+    ASTNode *right = node->children[1];
+    if (left->static_type != VAL_INT || right->static_type != VAL_INT)
+        return reject(e, node);
+    if (!emit_expression(e, left))
+        return 0;
+    if (right->type == AST_INT_LITERAL)
+    {
+        emit_byte(e, 0xB9); // mov ecx, imm32
+        emit_int32(e, LITERAL_VALUE(right).int_val);
+        return 1;
+    }
+    emit_push_eax(e);
+    if (!emit_expression(e, right))
+        return 0;
+    emit_byte(e, 0x89); // mov ecx, eax
+    emit_byte(e, 0xC1);
+    emit_pop(e, REG_EAX);
+    return 1;
+}
+
+/**
+ * @brief Finds the compiled code a call binds to.
+ *
+ * A call is bound to the function its callee variable holds now. The checker proved the call's
+ * type only if that variable is bound to one definition for good, so it holds the same function
+ * on every later run. Only the function itself and global functions are bound, since a variable
+ * of an enclosing frame may hold another closure of the definition in another call.
+ *
+ * @return The callee's JIT state, or NULL if the call cannot be compiled.
+ */
+static JitFunction *bind_callee(Emitter *e, ASTNode *callee, int arg_count)
+{
+    Value value = {VAL_VOID};
+    if (callee->depth == SCOPE_GLOBAL)
+    {
+        value = global_peek(callee->slot);
+    }
+    else if (callee->depth > 0)
+    {
+        Env *env = e->func->env;
+        for (int depth = 1; env && depth < callee->depth; depth++)
+            env = env->enclosing;
+        if (env && callee->slot < env->slot_count)
+            value = env->slots[callee->slot];
+    }
+    if (value.type != VAL_FUNC || value.func->owner_class || value.func->body->arg_count != arg_count)
+        return NULL;
+
+    ASTNode *def = value.func->body;
+    if (def == e->def)
+        return def->jit;
+    if (callee->depth != SCOPE_GLOBAL)
+        return NULL;
+    // A callee is compiled with its first compiled caller, hot or not. One that is still being
+    // compiled (mutual recursion) has no code to call yet.
+    JitFunction *jit = jit_function_of(def);
+    if (jit->state == JIT_COUNTING)
+        compile_function(value.func);
+    return jit->state == JIT_COMPILED ? jit : NULL;
+}
+
+/**
+ * @brief Emits a call to a compiled function, or a jump to it for a call in tail position.
+ */
+static int emit_call(Emitter *e, ASTNode *call, int is_tail_call)
+{
+    ASTNode *callee = call->children[0];
+    int arg_count = call->children_count - 1;
+    if (!callee || callee->type != AST_VAR_REF || arg_count > JIT_MAX_PARAMS)
+        return reject(e, call);
+    JitFunction *target = bind_callee(e, callee, arg_count);
+    if (!target)
+        return reject(e, call);
+
+    for (int i = 0; i < arg_count; i++)
+    {
+        if (!emit_expression(e, call->children[i + 1]))
+            return 0;
+        emit_push_eax(e);
+    }
+    for (int i = arg_count - 1; i >= 0; i--)
+        emit_pop(e, argument_registers[i]);
+
+    if (is_tail_call)
+        emit_leave(e);
+    emit_byte(e, 0x48); // mov rax, imm64
+    emit_byte(e, 0xB8);
+    emit_pointer(e, &target->entry);
+    if (is_tail_call)
+    {
+        emit_byte(e, 0xFF); // jmp [rax]
+        emit_byte(e, 0x20);
+        return 1;
+    }
+
+    int misaligned = e->pushes % 2;
+    if (misaligned)
+    {
+        emit_byte(e, 0x48); // sub rsp, 8
+        emit_byte(e, 0x83);
+        emit_byte(e, 0xEC);
+        emit_byte(e, 0x08);
+    }
+    emit_byte(e, 0xFF); // call [rax]
+    emit_byte(e, 0x10);
+    if (misaligned)
+    {
+        emit_byte(e, 0x48); // add rsp, 8
+        emit_byte(e, 0x83);
+        emit_byte(e, 0xC4);
+        emit_byte(e, 0x08);
+    }
+    return 1;
+}
+
+/**
+ * @brief Emits an expression, leaving its value in eax.
+ */
+static int emit_expression(Emitter *e, ASTNode *node)
+{
+    if (!node || !is_machine_type(node->static_type))
+        return reject(e, node);
+
+    switch (node->type)
+    {
+        case AST_INT_LITERAL:
+        case AST_BOOL_LITERAL:
+            emit_byte(e, 0xB8); // mov eax, imm32
+            emit_int32(e, LITERAL_VALUE(node).int_val);
+            return 1;
+        case AST_VAR_REF:
+            if (node->depth != 0 || node->slot >= e->def->slot_count)
+                return reject(e, node);
+            emit_slot_access(e, 0x8B, REG_EAX, node->slot);
+            return 1;
+        case AST_BINARY_OP:
+        {
+            if (node->children_count != 2)
+                return reject(e, node);
+            int condition = condition_code(node->op);
+            if (condition < 0 && node->op != OPER_ADD && node->op != OPER_SUBTRACT && node->op != OPER_MULTIPLY)
+                return reject(e, node); // `/`, `%` and `^` can fail or leave ints
+            if (!emit_operands(e, node))
+                return 0;
+            if (condition >= 0)
+            {
+                emit_byte(e, 0x39); // cmp eax, ecx
+                emit_byte(e, 0xC8);
+                emit_byte(e, 0x0F); // setcc al
+                emit_byte(e, 0x90 | condition);
+                emit_byte(e, 0xC0);
+                emit_byte(e, 0x0F); // movzx eax, al
+                emit_byte(e, 0xB6);
+                emit_byte(e, 0xC0);
+            }
+            else if (node->op == OPER_MULTIPLY)
+            {
+                emit_byte(e, 0x0F); // imul eax, ecx
+                emit_byte(e, 0xAF);
+                emit_byte(e, 0xC1);
+            }
+            else
+            {
+                emit_byte(e, node->op == OPER_ADD ? 0x01 : 0x29); // add/sub eax, ecx
+                emit_byte(e, 0xC8);
+            }
+            return 1;
+        }
+        case AST_LOGICAL_OP:
+        {
+            if (node->children_count != 2 || node->children[0]->static_type != VAL_BOOL ||
+                node->children[1]->static_type != VAL_BOOL)
+                return reject(e, node);
+            if (!emit_expression(e, node->children[0]))
+                return 0;
+            // A false `and` or a true `or` is already the result in eax.
+            emit_test_eax(e);
+            int skip = emit_jump(e, node->op == OPER_AND ? 0x4 : 0x5);
+            if (!emit_expression(e, node->children[1]))
+                return 0;
+            patch_jump(e, skip, e->count);
+            return 1;
+        }
+        case AST_UNARY_OP:
+        {
+            if (node->children_count != 1)
+                return reject(e, node);
+            ASTNode *operand = node->children[0];
+            int expected = node->op == OPER_NEGATE ? VAL_INT : VAL_BOOL;
+            if (operand->static_type != expected || !emit_expression(e, operand))
+                return reject(e, node);
+            emit_byte(e, node->op == OPER_NEGATE ? 0xF7 : 0x83); // neg eax / xor eax, 1
+            emit_byte(e, node->op == OPER_NEGATE ? 0xD8 : 0xF0);
+            if (node->op == OPER_NOT)
+                emit_byte(e, 0x01);
+            return 1;
+        }
+        case AST_FUNC_CALL:
+            if (node->children_count == 0)
+                return reject(e, node);
+            return emit_call(e, node, 0);
+        default:
+            return reject(e, node);
+    }
+}
+
+/**
+ * @brief Emits a condition and a jump taken when it is false.
+ * @param jump Receives the offset of the jump's displacement.
+ */
+static int emit_branch_if_false(Emitter *e, ASTNode *condition, int *jump)
+{
+    if (!condition || !is_machine_type(condition->static_type))
+        return reject(e, condition);
+    int code = condition->type == AST_BINARY_OP ? condition_code(condition->op) : -1;
+    if (code >= 0 && condition->children_count == 2)
+    {
+        // A comparison branches on the flags it sets.
+        if (!emit_operands(e, condition))
+            return 0;
+        emit_byte(e, 0x39); // cmp eax, ecx
+        emit_byte(e, 0xC8);
+        *jump = emit_jump(e, code ^ 1);
+        return 1;
+    }
+    if (!emit_expression(e, condition))
+        return 0;
+    emit_test_eax(e);
+    *jump = emit_jump(e, 0x4);
+    return 1;
+}
+
+// --- Statements ---
+
+static int emit_statement(Emitter *e, ASTNode *node);
+
+static void emit_pending_jump(Emitter *e, int is_continue)
+{
+    if (e->jump_count >= e->jump_capacity)
+    {
+        e->jump_capacity = e->jump_capacity < 8 ? 8 : e->jump_capacity * 2;
+        e->jumps = realloc(e->jumps, e->jump_capacity * sizeof(PendingJump));
+        if (!e->jumps)
+        {
+            fprintf(stderr, "Fatal: Memory allocation failed for JIT jumps.\n");
+            exit(1);
+        }
+    }
+    e->jumps[e->jump_count++] = (PendingJump){emit_jump(e, JUMP_ALWAYS), e->loop_depth, is_continue};
+}
+
+/**
+ * @brief Emits the body of a loop, whose `break` and `continue` jumps are patched by `close_loop`.
+ */
+static int emit_loop_body(Emitter *e, ASTNode *body)
+{
+    e->loop_depth++;
+    int ok = emit_statement(e, body);
+    e->loop_depth--;
+    return ok;
+}
+
+/**
+ * @brief Patches the `break` and `continue` jumps of the loop just emitted.
+ */
+static void close_loop(Emitter *e, int continue_target, int break_target)
+{
+    // Inner loops are closed first, so this loop's jumps are the last ones recorded.
+    while (e->jump_count > 0 && e->jumps[e->jump_count - 1].loop > e->loop_depth)
+    {
+        PendingJump *jump = &e->jumps[--e->jump_count];
+        patch_jump(e, jump->offset, jump->is_continue ? continue_target : break_target);
+    }
+}
+
+static int emit_local_store(Emitter *e, ASTNode *node, ASTNode *value)
+{
+    if (node->depth != 0 || node->slot >= e->def->slot_count || !emit_expression(e, value))
+        return reject(e, node);
+    emit_slot_access(e, 0x89, REG_EAX, node->slot);
+    return 1;
+}
+
+static int emit_return(Emitter *e, ASTNode *node)
+{
+    ASTNode *value = node->children_count > 0 ? node->children[0] : NULL;
+    if (!value || !is_machine_type(value->static_type))
+        return reject(e, node);
+    if (e->return_type == TYPE_UNPROVEN)
+        e->return_type = value->static_type;
+    else if (e->return_type != value->static_type)
+        return reject(e, node);
+
+    if (node->tail_call && value->type == AST_FUNC_CALL && value->children_count > 0 &&
+        is_machine_type(value->static_type))
+        return emit_call(e, value, 1);
+    if (!emit_expression(e, value))
+        return 0;
+    emit_leave(e);
+    emit_byte(e, 0xC3); // ret
+    return 1;
+}
+
+/**
+ * @brief Emits a statement of a function body.
+ */
+static int emit_statement(Emitter *e, ASTNode *node)
+{
+    if (!node)
+        return 1;
+
+    switch (node->type)
+    {
+        case AST_BLOCK:
+            for (int i = 0; i < node->children_count; i++)
+            {
+                if (!emit_statement(e, node->children[i]))
+                    return 0;
+            }
+            return 1;
+        case AST_VAR_DECL:
+            if (node->children_count != 1 || node->children[0]->type == AST_ARRAY_SPECIFIER ||
+                strncmp(node->type_name, "map<", 4) == 0)
+                return reject(e, node);
+            return emit_local_store(e, node, node->children[0]);
+        case AST_ASSIGNMENT:
+            if (node->children_count != 2 || node->children[0]->type != AST_VAR_REF)
+                return reject(e, node);
+            return emit_local_store(e, node->children[0], node->children[1]);
+        case AST_IF:
+        {
+            int else_jump;
+            if (!emit_branch_if_false(e, node->children[0], &else_jump) || !emit_statement(e, node->children[1]))
+                return 0;
+            if (node->children_count > 2)
+            {
+                int end_jump = emit_jump(e, JUMP_ALWAYS);
+                patch_jump(e, else_jump, e->count);
+                if (!emit_statement(e, node->children[2]))
+                    return 0;
+                patch_jump(e, end_jump, e->count);
+            }
+            else
+            {
+                patch_jump(e, else_jump, e->count);
+            }
+            return 1;
+        }
+        case AST_WHILE:
+        {
+            int top = e->count;
+            int exit_jump;
+            if (!emit_branch_if_false(e, node->children[0], &exit_jump) || !emit_loop_body(e, node->children[1]))
+                return 0;
+            emit_jump_to(e, JUMP_ALWAYS, top);
+            patch_jump(e, exit_jump, e->count);
+            close_loop(e, top, e->count);
+            return 1;
+        }
+        case AST_DO_WHILE:
+        {
+            int top = e->count;
+            if (!emit_loop_body(e, node->children[0]))
+                return 0;
+            int condition = e->count;
+            int exit_jump;
+            if (!emit_branch_if_false(e, node->children[1], &exit_jump))
+                return 0;
+            emit_jump_to(e, JUMP_ALWAYS, top);
+            patch_jump(e, exit_jump, e->count);
+            close_loop(e, condition, e->count);
+            return 1;
+        }
+        case AST_FOR:
+        {
+            if (!emit_statement(e, node->children[0]))
+                return 0;
+            int top = e->count;
+            int exit_jump;
+            if (!emit_branch_if_false(e, node->children[1], &exit_jump) || !emit_loop_body(e, node->children[3]))
+                return 0;
+            int increment = e->count;
+            if (!emit_statement(e, node->children[2]))
+                return 0;
+            emit_jump_to(e, JUMP_ALWAYS, top);
+            patch_jump(e, exit_jump, e->count);
+            close_loop(e, increment, e->count);
+            return 1;
+        }
+        case AST_BREAK:
+        case AST_CONTINUE:
+            // Outside of a loop, the signal would end the function without a value.
+            if (e->loop_depth == 0)
+                return reject(e, node);
+            emit_pending_jump(e, node->type == AST_CONTINUE);
+            return 1;
+        case AST_RETURN:
+            return emit_return(e, node);
+        default:
+            // An expression statement: its value is dropped.
+            return emit_expression(e, node);
+    }
+}
+
+// --- Functions ---
+
+/**
+ * @brief Copies finished code into pages of its own and makes them executable.
+ * @return The entry point, or NULL if the pages could not be mapped.
+ */
+static JitEntry install_code(Emitter *e)
+{
+    long page_size = sysconf(_SC_PAGESIZE);
+    size_t size = ((size_t) e->count + page_size - 1) / page_size * page_size;
+    void *pages = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (pages == MAP_FAILED)
+        return NULL;
+    memcpy(pages, e->code, e->count);
+    // Never writable and executable at once.
+    if (mprotect(pages, size, PROT_READ | PROT_EXEC) != 0)
+    {
+        munmap(pages, size);
+        return NULL;
+    }
+    return (JitEntry) pages;
+}
+
+static void emit_prologue(Emitter *e)
+{
+    emit_byte(e, 0x55); // push rbp
+    emit_byte(e, 0x48); // mov rbp, rsp
+    emit_byte(e, 0x89);
+    emit_byte(e, 0xE5);
+    // A multiple of 16 keeps rsp aligned for calls.
+    int frame_size = (e->def->slot_count * 4 + 15) / 16 * 16;
+    emit_byte(e, 0x48); // sub rsp, imm32
+    emit_byte(e, 0x81);
+    emit_byte(e, 0xEC);
+    emit_int32(e, frame_size);
+    for (int i = 0; i < e->def->arg_count; i++)
+        emit_slot_access(e, 0x89, argument_registers[i], i);
+}
+
+/**
+ * @brief Compiles a function, or marks it as staying on the engine.
+ * @return Whether the function was compiled.
+ */
+static int compile_function(Func *func)
+{
+    ASTNode *def = func->body;
+    JitFunction *jit = jit_function_of(def);
+    jit->state = JIT_COMPILING;
+
+    Emitter e;
+    memset(&e, 0, sizeof(Emitter));
+    e.func = func;
+    e.def = def;
+    e.return_type = TYPE_UNPROVEN;
+
+    int ok = 0;
+    if (func->owner_class || def->frame_captured || def->arg_count > JIT_MAX_PARAMS || def->children_count == 0)
+    {
+        reject(&e, def);
+    }
+    else if (!always_returns(def->children[0]))
+    {
+        reject(&e, def); // Falling off the end returns void
+    }
+    else
+    {
+        emit_prologue(&e);
+        ok = emit_statement(&e, def->children[0]);
+    }
+    if (ok)
+        jit->entry = install_code(&e);
+    if (ok && jit->entry)
+    {
+        jit->state = JIT_COMPILED;
+        jit->return_type = e.return_type;
+    }
+    else
+    {
+        jit->state = JIT_FAILED;
+    }
+
+#ifdef DEBUG_TRACE_JIT
+    if (jit->state == JIT_COMPILED)
+        printf("[JIT] Compiled '%s' to %d bytes\n", def->value, e.count);
+    else
+        printf("[JIT] '%s' stays on the engine (line %d)\n", def->value,
+               e.rejected ? e.rejected->line_num : def->line_num);
+#endif
+
+    free(e.code);
+    free(e.jumps);
+    return jit->state == JIT_COMPILED;
+}
+
+#else
+
+static int compile_function(Func *func)
+{
+    func->body->jit->state = JIT_FAILED;
+    return 0;
+}
+
+#endif
+
+void jit_install(ASTNode *def, JitEntry entry, ValueType return_type)
+{
+    JitFunction *jit = jit_function_of(def);
+    jit->state = JIT_COMPILED;
+    jit->entry = entry;
+    jit->return_type = return_type;
+}
+
+int jit_call(Func *func, int arg_count, Value *args, Value *result)
+{
+    ASTNode *def = func->body;
+    JitFunction *jit = jit_function_of(def);
+    if (jit->state != JIT_COMPILED)
+    {
+        if (jit->state != JIT_COUNTING || ++jit->calls < JIT_THRESHOLD || !compile_function(func))
+            return 0;
+    }
+    if (arg_count != def->arg_count)
+        return 0;
+
+    int raw[JIT_MAX_PARAMS] = {0};
+    for (int i = 0; i < arg_count; i++)
+    {
+        if (args[i].type != VAL_INT && args[i].type != VAL_BOOL)
+            return 0;
+        raw[i] = args[i].int_val;
+    }
+    result->type = jit->return_type;
+    result->int_val = jit->entry(raw[0], raw[1], raw[2], raw[3], raw[4], raw[5]);
+    return 1;
+}
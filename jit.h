@@ -0,0 +1,73 @@
+/**
+ * @file jit.h
+ * @brief Header file for the Pith baseline JIT compiler.
+ *
+ * With `--jit`, a user function that has been called JIT_THRESHOLD times is compiled to x86-64
+ * machine code, and later calls run that code instead of the selected engine. The compiler is a
+ * single pass over the function's AST with no register allocation: every expression leaves its
+ * result in a register, temporaries go on the machine stack and variables live in the native frame.
+ *
+ * Only functions the checker has proven to compute on ints and bools alone are compiled: every
+ * expression must have a proven int or bool type (see checker.h), the body may only declare and
+ * assign locals, branch, loop, return and call other such functions, and every path must end in a
+ * return. Anything else (a method, an operation on another type, a division that could fail at
+ * run time, a read of an enclosing frame) keeps the function on the engine. A call whose
+ * arguments are not ints or bools also takes the engine's path.
+ *
+ * A JitFunction belongs to the AST node of the function definition (`ASTNode.jit`) and is freed
+ * with it; the machine code itself stays mapped until the process exits.
+ */
+
+#ifndef PITH_JIT_H
+#define PITH_JIT_H
+
+#include "value.h"
+#include "parser.h"
+
+/**
+ * @brief Most parameters a compiled function can have (the argument registers of the ABI).
+ */
+#define JIT_MAX_PARAMS 6
+
+typedef struct JitFunction JitFunction;
+
+/**
+ * @brief Native code of a function: its int or bool arguments in order, unused ones 0.
+ */
+typedef int (*JitEntry)(int, int, int, int, int, int);
+
+/**
+ * @brief Whether `call_function` runs hot functions as machine code (set by `--jit`).
+ */
+extern int jit_enabled;
+
+/**
+ * @brief Returns whether the JIT can generate code for the machine it runs on.
+ */
+int jit_is_supported();
+
+/**
+ * @brief Counts a call to a user function and, once the function is compiled, makes it.
+ *
+ * @param func The function being called.
+ * @param arg_count Number of arguments.
+ * @param args The argument values.
+ * @param result Receives the return value when the call is made.
+ * @return Whether the call was made; if not, the caller runs the function on its engine.
+ */
+int jit_call(Func *func, int arg_count, Value *args, Value *result);
+
+/**
+ * @brief Makes calls to a function run code compiled ahead of time (see aot.h).
+ * @param def The function definition.
+ * @param entry The function's native code.
+ * @param return_type The type of the values it returns (VAL_INT or VAL_BOOL).
+ */
+void jit_install(ASTNode *def, JitEntry entry, ValueType return_type);
+
+/**
+ * @brief Frees the JIT state of a function definition (called by `free_ast`).
+ */
+void free_jit_function(JitFunction *jit);
+
+#endif //PITH_JIT_H
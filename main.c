@@ -12,9 +12,13 @@
 #include <string.h>
 #include "tokenizer.h"
 #include "parser.h"
+#include "resolver.h"
+#include "checker.h"
 #include "interpreter.h"
 #include "debug.h"
 #include "repl.h"
+#include "jit.h"
+#include "aot.h"
 #include "gc.h" // Include GC
 
 // To enable debug traces, uncomment the desired flags in debug.h
@@ -27,6 +31,9 @@
  *   pith              - Start REPL
  *   pith script.pith  - Execute script
  *   pith -i script.pith - Execute script and then drop into REPL
+ *   pith --vm script.pith - Execute script with the bytecode VM instead of the tree-walker
+ *   pith --jit script.pith - Also compile hot int and bool functions to machine code (x86-64)
+ *   pith --emit-c script.pith - Print the script as a C program to link against pith_runtime
  *
  * @param argc Argument count.
  * @param argv Argument vector.
@@ -43,6 +50,7 @@ int main(int argc, char *argv[])
     }
 
     int interactive = 0;
+    int emit_c = 0;
     char *filename = NULL;
 
     // Parse arguments
@@ -52,6 +60,21 @@ int main(int argc, char *argv[])
         {
             interactive = 1;
         }
+        else if (strcmp(argv[i], "--vm") == 0)
+        {
+            execution_engine = ENGINE_VM;
+        }
+        else if (strcmp(argv[i], "--emit-c") == 0)
+        {
+            emit_c = 1;
+        }
+        else if (strcmp(argv[i], "--jit") == 0)
+        {
+            if (jit_is_supported())
+                jit_enabled = 1;
+            else
+                fprintf(stderr, "Warning: --jit is not supported on this platform; running without it.\n");
+        }
         else
         {
             filename = argv[i];
@@ -67,7 +90,7 @@ int main(int argc, char *argv[])
             free_all_objects();
             return 0;
         }
-        fprintf(stderr, "Usage: %s [-i] [filename]\n", argv[0]);
+        fprintf(stderr, "Usage: %s [-i] [--vm] [--jit] [--emit-c] [filename]\n", argv[0]);
         return 1;
     }
 
@@ -89,13 +112,32 @@ int main(int argc, char *argv[])
     ParserState parser_state = {&tokenizer_state, 0};
     ASTNode *ast_root = parse_program(&parser_state);
 
+    // Resolve variables to frame slots and globals
+    resolve_program(ast_root);
+
+    // Prove expression types; the REPL started by -i may reassign the script's globals
+    check_program(ast_root, !interactive, 0);
+
+    if (emit_c)
+    {
+        emit_c_program(ast_root, source, filename, stdout);
+        free(source);
+        free_tokens(&tokenizer_state);
+        free_ast(ast_root);
+        free_all_objects();
+        return 0;
+    }
+
     // Interpret
     interpret(ast_root);
 
+#ifdef DEBUG_FIELD_CACHE_STATS
+    print_field_cache_stats();
+#endif
+
     // Free resources
     free(source);
     free_tokens(&tokenizer_state);
-    free_ast(ast_root);
 
     // If interactive mode was requested, start REPL after script execution
     if (interactive)
@@ -104,6 +146,9 @@ int main(int argc, char *argv[])
         start_repl(1);
     }
 
+    // Functions and classes defined by the script point into its tree, so it outlives the REPL.
+    free_ast(ast_root);
+
     // Final cleanup
     free_all_objects(); // Clean up GC objects
 
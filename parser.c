@@ -9,6 +9,11 @@
  */
 
 #include "parser.h"
+#include "compiler.h"
+#include "constants.h"
+#include "closure.h"
+#include "jit.h"
+#include "switch_table.h"
 #include "debug.h"
 #include "common.h"
 #include <stdlib.h>
@@ -51,8 +56,22 @@ ASTNode *create_node(ASTNodeType type, const char *value, int line_num)
     node->children = NULL;
     node->children_count = 0;
     node->args = NULL;
+    node->arg_types = NULL;
     node->arg_count = 0;
     node->line_num = line_num;
+    node->constant = -1;
+    node->op = OPER_NONE;
+    node->depth = 0;
+    node->slot = -1;
+    node->slot_count = 0;
+    node->frame_captured = 0;
+    node->tail_call = 0;
+    node->static_type = TYPE_UNPROVEN;
+    node->chunk = NULL;
+    node->cache = NULL;
+    node->closure = NULL;
+    node->jit = NULL;
+    node->switch_table = NULL;
 
     // DO NOT DISCARD DEBUG CODE
 #ifdef DEBUG_DEEP_DIVE_PARSER
@@ -94,13 +113,19 @@ void add_child(ASTNode *parent, ASTNode *child)
     parent->children[parent->children_count - 1] = child;
 }
 
+ASTNode *get_child(ASTNode *node, int index)
+{
+    return index < node->children_count ? node->children[index] : NULL;
+}
+
 /**
- * @brief Adds an argument name to a function or struct definition node.
+ * @brief Adds an argument to a function or struct definition node.
  *
  * @param func_node The AST node representing the function or struct.
+ * @param arg_type The declared type of the argument, or NULL if none is given.
  * @param arg_name The name of the argument to add.
  */
-void add_arg(ASTNode *func_node, const char *arg_name)
+void add_arg(ASTNode *func_node, const char *arg_type, const char *arg_name)
 {
     if (!func_node || !arg_name)
         return;
@@ -109,12 +134,14 @@ void add_arg(ASTNode *func_node, const char *arg_name)
 #endif
     func_node->arg_count++;
     func_node->args = realloc(func_node->args, func_node->arg_count * sizeof(char *));
-    if (!func_node->args)
+    func_node->arg_types = realloc(func_node->arg_types, func_node->arg_count * sizeof(char *));
+    if (!func_node->args || !func_node->arg_types)
     {
         fprintf(stderr, "Fatal: Memory reallocation failed for function arguments.\n");
         exit(1);
     }
     func_node->args[func_node->arg_count - 1] = strdup(arg_name);
+    func_node->arg_types[func_node->arg_count - 1] = arg_type ? strdup(arg_type) : NULL;
 }
 
 /**
@@ -127,6 +154,11 @@ void free_ast(ASTNode *node)
     if (!node)
         return;
 
+    // A closure checks which of its operands it owns, so it goes before the children's closures.
+    free_closure(node->closure);
+    free_jit_function(node->jit);
+    free_switch_table(node->switch_table);
+
     if (node->value)
         free(node->value);
     if (node->type_name)
@@ -148,10 +180,14 @@ void free_ast(ASTNode *node)
         for (int i = 0; i < node->arg_count; i++)
         {
             free(node->args[i]);
+            free(node->arg_types[i]);
         }
         free(node->args);
+        free(node->arg_types);
     }
 
+    free_chunk(node->chunk);
+    free(node->cache);
     free(node);
 }
 
@@ -201,6 +237,16 @@ int match(ParserState *state, TokenType type)
 // --- Expression Parsers (Pratt Parser) ---
 ASTNode *parse_call(ParserState *state);
 
+/**
+ * @brief Creates a literal node and decodes its value into the constant pool.
+ */
+static ASTNode *create_literal_node(ASTNodeType type, Token t)
+{
+    ASTNode *node = create_node(type, t.value, t.line_num);
+    node->constant = make_literal_constant(type, t.value);
+    return node;
+}
+
 /**
  * @brief Parses primary expressions.
  *
@@ -231,22 +277,22 @@ ASTNode *parse_primary(ParserState *state)
     if (t.type == TOKEN_NUMBER)
     {
         advance(state);
-        return create_node(AST_INT_LITERAL, t.value, t.line_num);
+        return create_literal_node(AST_INT_LITERAL, t);
     }
     if (t.type == TOKEN_FLOAT_LITERAL)
     {
         advance(state);
-        return create_node(AST_FLOAT_LITERAL, t.value, t.line_num);
+        return create_literal_node(AST_FLOAT_LITERAL, t);
     }
     if (t.type == TOKEN_STRING)
     {
         advance(state);
-        return create_node(AST_STRING_LITERAL, t.value, t.line_num);
+        return create_literal_node(AST_STRING_LITERAL, t);
     }
     if (t.type == TOKEN_KEYWORD && (strcmp(t.value, "true") == 0 || strcmp(t.value, "false") == 0))
     {
         advance(state);
-        return create_node(AST_BOOL_LITERAL, t.value, t.line_num);
+        return create_literal_node(AST_BOOL_LITERAL, t);
     }
 
     // Handle variable references
@@ -342,6 +388,13 @@ ASTNode *parse_call(ParserState *state)
             Token t = advance(state);
             Token member_name = advance(state);
             ASTNode *access = create_node(AST_FIELD_ACCESS, member_name.value, t.line_num);
+            access->constant = make_literal_constant(AST_STRING_LITERAL, member_name.value); // See MEMBER_NAME
+            access->cache = calloc(1, sizeof(FieldCache));
+            if (!access->cache)
+            {
+                fprintf(stderr, "Fatal: Memory allocation failed for field cache.\n");
+                exit(1);
+            }
             add_child(access, expr);
             expr = access;
         }
@@ -364,6 +417,58 @@ ASTNode *parse_call(ParserState *state)
     return expr;
 }
 
+/**
+ * @brief Decodes an operator token into its Operator.
+ *
+ * @param op The operator token (a symbol, or the `and`/`or` keyword).
+ * @param unary Whether the operator is used as a prefix operator.
+ * @return The decoded operator.
+ */
+static Operator decode_operator(Token op, int unary)
+{
+    switch (op.type)
+    {
+        case TOKEN_PLUS:
+            return OPER_ADD;
+        case TOKEN_MINUS:
+            return unary ? OPER_NEGATE : OPER_SUBTRACT;
+        case TOKEN_STAR:
+            return OPER_MULTIPLY;
+        case TOKEN_SLASH:
+            return OPER_DIVIDE;
+        case TOKEN_PERCENT:
+            return OPER_MODULO;
+        case TOKEN_CARET:
+            return OPER_POWER;
+        case TOKEN_BANG:
+            return OPER_NOT;
+        case TOKEN_LT:
+            return OPER_LESS;
+        case TOKEN_GT:
+            return OPER_GREATER;
+        case TOKEN_LTE:
+            return OPER_LESS_EQUAL;
+        case TOKEN_GTE:
+            return OPER_GREATER_EQUAL;
+        case TOKEN_EQ:
+            return OPER_EQUAL;
+        case TOKEN_NEQ:
+            return OPER_NOT_EQUAL;
+        default:
+            return strcmp(op.value, "and") == 0 ? OPER_AND : OPER_OR;
+    }
+}
+
+/**
+ * @brief Creates an operator node (binary, logical or unary) for an operator token.
+ */
+static ASTNode *create_operator_node(ASTNodeType type, Token op)
+{
+    ASTNode *node = create_node(type, op.value, op.line_num);
+    node->op = decode_operator(op, type == AST_UNARY_OP);
+    return node;
+}
+
 /**
  * @brief Parses unary operations.
  *
@@ -378,7 +483,7 @@ ASTNode *parse_unary(ParserState *state)
     {
         Token op = advance(state);
         ASTNode *operand = parse_unary(state);
-        ASTNode *node = create_node(AST_UNARY_OP, op.value, op.line_num);
+        ASTNode *node = create_operator_node(AST_UNARY_OP, op);
         add_child(node, operand);
         return node;
     }
@@ -400,7 +505,7 @@ ASTNode *parse_power(ParserState *state)
     {
         Token op = advance(state);
         ASTNode *right = parse_unary(state);
-        ASTNode *node = create_node(AST_BINARY_OP, op.value, op.line_num);
+        ASTNode *node = create_operator_node(AST_BINARY_OP, op);
         add_child(node, left);
         add_child(node, right);
         left = node;
@@ -423,7 +528,7 @@ ASTNode *parse_factor(ParserState *state)
     {
         Token op = advance(state);
         ASTNode *right = parse_power(state);
-        ASTNode *node = create_node(AST_BINARY_OP, op.value, op.line_num);
+        ASTNode *node = create_operator_node(AST_BINARY_OP, op);
         add_child(node, left);
         add_child(node, right);
         left = node;
@@ -446,7 +551,7 @@ ASTNode *parse_term(ParserState *state)
     {
         Token op = advance(state);
         ASTNode *right = parse_factor(state);
-        ASTNode *node = create_node(AST_BINARY_OP, op.value, op.line_num);
+        ASTNode *node = create_operator_node(AST_BINARY_OP, op);
         add_child(node, left);
         add_child(node, right);
         left = node;
@@ -470,7 +575,7 @@ ASTNode *parse_comparison(ParserState *state)
     {
         Token op = advance(state);
         ASTNode *right = parse_term(state);
-        ASTNode *node = create_node(AST_BINARY_OP, op.value, op.line_num);
+        ASTNode *node = create_operator_node(AST_BINARY_OP, op);
         add_child(node, left);
         add_child(node, right);
         left = node;
@@ -493,7 +598,7 @@ ASTNode *parse_equality(ParserState *state)
     {
         Token op = advance(state);
         ASTNode *right = parse_comparison(state);
-        ASTNode *node = create_node(AST_BINARY_OP, op.value, op.line_num);
+        ASTNode *node = create_operator_node(AST_BINARY_OP, op);
         add_child(node, left);
         add_child(node, right);
         left = node;
@@ -504,7 +609,7 @@ ASTNode *parse_equality(ParserState *state)
 /**
  * @brief Parses logical AND operations.
  *
- * Handles the `and` keyword.
+ * Handles the `and` keyword. The right operand is skipped when the left one is false.
  *
  * @param state The current parser state.
  * @return The AST node representing the logical AND.
@@ -516,7 +621,7 @@ ASTNode *parse_logic_and(ParserState *state)
     {
         Token op = advance(state);
         ASTNode *right = parse_equality(state);
-        ASTNode *node = create_node(AST_BINARY_OP, "and", op.line_num);
+        ASTNode *node = create_operator_node(AST_LOGICAL_OP, op);
         add_child(node, left);
         add_child(node, right);
         left = node;
@@ -528,6 +633,7 @@ ASTNode *parse_logic_and(ParserState *state)
  * @brief Parses logical OR operations.
  *
  * Handles the `or` keyword. This is the lowest precedence expression parser.
+ * The right operand is skipped when the left one is true.
  *
  * @param state The current parser state.
  * @return The AST node representing the logical OR.
@@ -539,7 +645,7 @@ ASTNode *parse_logic_or(ParserState *state)
     {
         Token op = advance(state);
         ASTNode *right = parse_logic_and(state);
-        ASTNode *node = create_node(AST_BINARY_OP, "or", op.line_num);
+        ASTNode *node = create_operator_node(AST_LOGICAL_OP, op);
         add_child(node, left);
         add_child(node, right);
         left = node;
@@ -617,13 +723,14 @@ ASTNode *parse_function_definition(ParserState *state)
     Token name;
 
     // Check if return type is specified
+    const char *return_type = NULL;
     if (state->tokenizer_state->tokens[state->current_token + 1].type == TOKEN_LPAREN)
     {
         name = advance(state);
     }
     else
     {
-        advance(state); // consume return type (ignored for now in AST construction)
+        return_type = advance(state).value; // consume return type, kept for the static checker
         // Handle generic return types like list[int]
         if (peek(state).type == TOKEN_LBRACKET)
         {
@@ -635,18 +742,21 @@ ASTNode *parse_function_definition(ParserState *state)
 
     match(state, TOKEN_LPAREN);
     ASTNode *func = create_node(AST_FUNC_DEF, name.value, name.line_num);
+    if (return_type)
+        func->type_name = strdup(return_type);
 
     // Parse arguments
     if (peek(state).type != TOKEN_RPAREN)
     {
         do
         {
+            const char *arg_type = NULL;
             if (state->tokenizer_state->tokens[state->current_token + 1].type == TOKEN_IDENTIFIER)
             {
-                advance(state); // consume type (ignored for now)
+                arg_type = advance(state).value; // consume type
             }
             Token arg_name = advance(state);
-            add_arg(func, arg_name.value);
+            add_arg(func, arg_type, arg_name.value);
         }
         while (match(state, TOKEN_COMMA));
     }
@@ -686,6 +796,8 @@ ASTNode *parse_statement(ParserState *state)
             advance(state); // consume 'extends'
             Token parent_name = advance(state);
             class_node->parent_class_name = strdup(parent_name.value);
+            // The parent is looked up like any other variable, so keep a reference node for the resolver
+            add_child(class_node, create_node(AST_VAR_REF, parent_name.value, parent_name.line_num));
         }
 
         // Parse class body
@@ -855,7 +967,7 @@ ASTNode *parse_statement(ParserState *state)
             if (peek(state).type == TOKEN_NUMBER)
             {
                 Token size_token = advance(state);
-                add_child(array_spec, create_node(AST_INT_LITERAL, size_token.value, size_token.line_num));
+                add_child(array_spec, create_literal_node(AST_INT_LITERAL, size_token));
             }
             match(state, TOKEN_RBRACKET);
         }
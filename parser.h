@@ -26,6 +26,7 @@ typedef enum
     AST_VAR_REF, // Variable reference (e.g., x)
     AST_BINARY_OP, // Binary operation (e.g., a + b)
     AST_UNARY_OP, // Unary operation (e.g., -a, !b)
+    AST_LOGICAL_OP, // Short-circuit logical operation (a and b, a or b)
     AST_IF, // If statement
     AST_WHILE, // While loop
     AST_BLOCK, // Block of statements
@@ -52,6 +53,47 @@ typedef enum
     AST_HASHMAP_LITERAL // Hashmap literal ({ "a": 1 })
 } ASTNodeType;
 
+/**
+ * @brief Operators of AST_BINARY_OP, AST_LOGICAL_OP and AST_UNARY_OP nodes, decoded once by the parser.
+ *
+ * The binary operators come first so that they can index the interpreter's operator table.
+ */
+typedef enum
+{
+    OPER_ADD, // +
+    OPER_SUBTRACT, // -
+    OPER_MULTIPLY, // *
+    OPER_DIVIDE, // /
+    OPER_MODULO, // %
+    OPER_POWER, // ^
+    OPER_LESS, // <
+    OPER_GREATER, // >
+    OPER_LESS_EQUAL, // <=
+    OPER_GREATER_EQUAL, // >=
+    OPER_EQUAL, // ==
+    OPER_NOT_EQUAL, // !=
+    OPER_AND, // and
+    OPER_OR, // or
+    OPER_NEGATE, // Unary -
+    OPER_NOT, // Unary !
+    OPER_NONE // Not an operator node
+} Operator;
+
+/**
+ * @brief Number of binary operators (OPER_ADD to OPER_OR).
+ */
+#define BINARY_OPERATOR_COUNT (OPER_OR + 1)
+
+/**
+ * @brief `ASTNode.depth` of a variable that lives in the global table instead of a frame.
+ */
+#define SCOPE_GLOBAL (-1)
+
+/**
+ * @brief `ASTNode.static_type` of an expression whose type the checker could not prove.
+ */
+#define TYPE_UNPROVEN (-1)
+
 /**
  * @brief Structure representing a node in the Abstract Syntax Tree.
  */
@@ -64,8 +106,23 @@ typedef struct ASTNode
     struct ASTNode **children; // Array of child nodes
     int children_count; // Number of children
     char **args; // Array of argument names (for functions)
+    char **arg_types; // Declared type of each argument, or NULL where none is given (for functions)
     int arg_count; // Number of arguments
     int line_num; // Source line number
+    int constant; // Index of a literal's decoded value in the constant pool (-1 otherwise)
+    Operator op; // Decoded operator of a binary or unary operation (OPER_NONE otherwise)
+    int depth; // Variable address set by the resolver: frames to walk up, or SCOPE_GLOBAL
+    int slot; // Variable address set by the resolver: slot in the frame or global table
+    int slot_count; // Frame size of a program, module, function body or loop iteration (set by the resolver)
+    int frame_captured; // Function definitions: a nested definition keeps the frame alive. Loops: each
+                        // iteration runs in a new frame of `slot_count` slots (set by the resolver)
+    int tail_call; // Return statements: the returned call runs in place of the returning one (set by the resolver)
+    int static_type; // Expressions: the ValueType every evaluation yields, or TYPE_UNPROVEN (set by the checker)
+    struct Chunk *chunk; // Cached bytecode for function definitions (VM only)
+    struct FieldCache *cache; // Inline cache of a field access (see get_field_cached)
+    struct ClosureNode *closure; // Compiled form run by the tree-walker (see closure.h)
+    struct JitFunction *jit; // Function definitions: call count and machine code (see jit.h)
+    struct SwitchTable *switch_table; // Switch statements: clause of each case label (see switch_table.h)
 } ASTNode;
 
 /**
@@ -84,6 +141,35 @@ typedef struct
  */
 ASTNode *parse_program(ParserState *state);
 
+/**
+ * @brief Creates a new AST node.
+ * @param type The type of the node.
+ * @param value The node's string value (copied), or NULL.
+ * @param line_num The source line number.
+ * @return The new node, with no children.
+ */
+ASTNode *create_node(ASTNodeType type, const char *value, int line_num);
+
+/**
+ * @brief Appends a child to a node (does nothing for a NULL child).
+ */
+void add_child(ASTNode *parent, ASTNode *child);
+
+/**
+ * @brief Returns child `index` of a node, or NULL if the node has fewer children.
+ *
+ * add_child skips the parts a parse error left out, so a malformed node can be short.
+ */
+ASTNode *get_child(ASTNode *node, int index);
+
+/**
+ * @brief Appends an argument to a function definition node.
+ * @param func_node The function definition.
+ * @param arg_type The declared type of the argument (copied), or NULL if none is given.
+ * @param arg_name The argument name (copied).
+ */
+void add_arg(ASTNode *func_node, const char *arg_type, const char *arg_name);
+
 /**
  * @brief Frees the memory associated with an AST.
  * @param node The root node of the AST to free.
@@ -0,0 +1,76 @@
+/**
+ * @file pithc.c
+ * @brief Entry point for the Pith static type checker.
+ *
+ * Checks script files without running them and reports the type errors it finds
+ * (see checker.h).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "tokenizer.h"
+#include "parser.h"
+#include "resolver.h"
+#include "checker.h"
+#include "interpreter.h"
+#include "gc.h"
+
+/**
+ * @brief Checks one script file.
+ * @return The number of type errors found, or -1 if the file could not be read.
+ */
+static int check_file(const char *filename)
+{
+    char *source = read_file_content(filename);
+    if (!source)
+    {
+        fprintf(stderr, "Error: Could not read file '%s'.\n", filename);
+        return -1;
+    }
+
+    TokenizerState tokenizer_state;
+    set_error_context(source, filename);
+    tokenize(source, &tokenizer_state);
+
+    ParserState parser_state = {&tokenizer_state, 0};
+    ASTNode *ast_root = parse_program(&parser_state);
+    resolve_program(ast_root);
+    int error_count = check_program(ast_root, 1, 1);
+
+    free(source);
+    free_tokens(&tokenizer_state);
+    free_ast(ast_root);
+    return error_count;
+}
+
+/**
+ * @brief Main entry point.
+ *
+ * Usage:
+ *   pithc script.pith...  - Check scripts; exits with 1 if any has a type error
+ *
+ * @param argc Argument count.
+ * @param argv Argument vector.
+ * @return Exit code (0 if every script checks, 1 otherwise).
+ */
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "Usage: %s script.pith...\n", argv[0]);
+        return 1;
+    }
+
+    int failed = 0;
+    for (int i = 1; i < argc; i++)
+    {
+        int error_count = check_file(argv[i]);
+        if (error_count > 0)
+            fprintf(stderr, "%s: %d type error(s)\n", argv[i], error_count);
+        if (error_count != 0)
+            failed = 1;
+    }
+
+    free_all_objects();
+    return failed;
+}
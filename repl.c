@@ -11,6 +11,8 @@
 #include "repl.h"
 #include "interpreter.h"
 #include "parser.h"
+#include "resolver.h"
+#include "checker.h"
 #include "tokenizer.h"
 #include "debug.h"
 #include <stdio.h>
@@ -31,6 +33,31 @@ static TokenizerState *current_tokenizer_state = NULL;
 static ASTNode *current_ast_root = NULL;
 static char *current_code_buffer = NULL;
 
+// Trees of the inputs run so far: functions and classes defined by an input keep pointing
+// into its tree, so the trees are only freed when the REPL exits.
+static ASTNode **entry_trees = NULL;
+static int entry_tree_count = 0;
+static int entry_tree_capacity = 0;
+
+/**
+ * @brief Keeps the tree of an input until the REPL exits.
+ * @param root The AST_PROGRAM node of the input.
+ */
+static void retain_entry_tree(ASTNode *root)
+{
+    if (entry_tree_count >= entry_tree_capacity)
+    {
+        entry_tree_capacity = entry_tree_capacity == 0 ? 16 : entry_tree_capacity * 2;
+        entry_trees = realloc(entry_trees, entry_tree_capacity * sizeof(ASTNode *));
+        if (!entry_trees)
+        {
+            fprintf(stderr, "Fatal: Memory allocation failed for REPL input trees.\n");
+            exit(1);
+        }
+    }
+    entry_trees[entry_tree_count++] = root;
+}
+
 /**
  * @brief Custom error reporting function for the REPL.
  *
@@ -60,7 +87,7 @@ void repl_report_error(int line, const char *format, ...)
     }
     if (current_ast_root)
     {
-        free_ast(current_ast_root);
+        retain_entry_tree(current_ast_root);
         current_ast_root = NULL;
     }
 
@@ -187,6 +214,7 @@ int is_expression_node(ASTNodeType type)
         case AST_BOOL_LITERAL:
         case AST_VAR_REF:
         case AST_BINARY_OP:
+        case AST_LOGICAL_OP:
         case AST_UNARY_OP:
         case AST_FUNC_CALL:
         case AST_NEW_EXPR:
@@ -210,10 +238,10 @@ void start_repl(int interactive_mode)
     printf("Pith REPL v0.2\n");
     printf("Type 'exit' to quit.\n");
 
-    // Initialize global environment if not already done
-    if (!global_env)
+    // Initialize the globals if a script has not already done so
+    if (!native_module_funcs)
     {
-        define_all_natives_in_env(&global_env);
+        define_all_natives();
         register_all_native_methods();
         register_all_native_modules();
     }
@@ -237,6 +265,7 @@ void start_repl(int interactive_mode)
                 current_code_buffer = NULL;
             }
             code_buffer_size = 0;
+            reset_call_stack(); // Drop the frames of the code that failed
             printf("\n");
             sigint_flag = 0; // Reset flag
             continue;
@@ -315,10 +344,16 @@ void start_repl(int interactive_mode)
         ParserState p_state = {&t_state, 0};
         ASTNode *root = parse_program(&p_state);
         current_ast_root = root;
+        resolve_program(root);
+        // Later inputs share the globals, so only the types of this input's locals are proven.
+        check_program(root, 0, 0);
 
         // Execute
         if (root->children_count > 0)
         {
+            // Globals persist between inputs; the frame only holds this input's block variables.
+            Env *frame = env_new(root->slot_count, NULL);
+            push_frame(frame);
             ASTNode *first_statement = root->children[0];
             // If it's a single expression, evaluate and print the result
             if (root->children_count == 1 && is_expression_node(first_statement->type))
@@ -326,7 +361,7 @@ void start_repl(int interactive_mode)
 #ifdef DEBUG_DEEP_DIVE_INTERP
                 printf("[DDI_REPL] Evaluating as expression.\n");
 #endif
-                Value result = eval(first_statement, global_env);
+                Value result = eval(first_statement, frame);
                 if (result.type != VAL_VOID)
                 {
                     print_value(result);
@@ -339,18 +374,24 @@ void start_repl(int interactive_mode)
 #ifdef DEBUG_DEEP_DIVE_INTERP
                 printf("[DDI_REPL] Executing as statement(s).\n");
 #endif
-                exec_module(root, &global_env);
+                exec_module(root, frame);
             }
+            pop_frame();
         }
 
         // Cleanup for next iteration
         free_tokens(&t_state);
         current_tokenizer_state = NULL;
-        free_ast(root);
+        retain_entry_tree(root);
         current_ast_root = NULL;
     }
 
     if (current_code_buffer)
         free(current_code_buffer);
+    for (int i = 0; i < entry_tree_count; i++)
+        free_ast(entry_trees[i]);
+    free(entry_trees);
+    entry_trees = NULL;
+    entry_tree_count = entry_tree_capacity = 0;
     printf("Exiting REPL.\n");
 }
@@ -0,0 +1,357 @@
+/**
+ * @file resolver.c
+ * @brief Implementation of the Pith variable resolver.
+ *
+ * This file walks the AST once, tracking the block scopes of each function, and annotates
+ * variable references, assignment targets and declarations with their (depth, slot) address.
+ * Slots are never reused within a frame, so a closure keeps seeing the variable it captured.
+ *
+ * A loop whose body defines a function or class runs each iteration of the body in a frame of
+ * its own, so that every closure made in the loop keeps its own copy of the body's variables
+ * (and of a foreach loop's variable) instead of sharing one slot that later iterations write.
+ */
+
+#include "resolver.h"
+#include "interpreter.h"
+#include "debug.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief The names declared in one block scope.
+ */
+typedef struct BlockScope
+{
+    struct BlockScope *enclosing;
+    const char **names;
+    int *slots;
+    int count;
+    int capacity;
+} BlockScope;
+
+/**
+ * @brief The scopes of one frame (a function body, a module or a program).
+ */
+typedef struct FunctionScope
+{
+    struct FunctionScope *enclosing;
+    BlockScope *block; // Innermost open block, or NULL at the top level of a program
+    int slot_count; // Slots handed out so far
+    int captured; // A function or class defined in this frame keeps it as its environment
+    int is_iteration; // The frame of one iteration of a loop body, inside its loop's frame
+} FunctionScope;
+
+typedef struct
+{
+    FunctionScope *function;
+} Resolver;
+
+static void resolve_node(Resolver *resolver, ASTNode *node);
+
+// --- Scopes ---
+
+static void begin_scope(Resolver *resolver, BlockScope *scope)
+{
+    memset(scope, 0, sizeof(BlockScope));
+    scope->enclosing = resolver->function->block;
+    resolver->function->block = scope;
+}
+
+static void end_scope(Resolver *resolver)
+{
+    BlockScope *scope = resolver->function->block;
+    resolver->function->block = scope->enclosing;
+    free(scope->names);
+    free(scope->slots);
+}
+
+/**
+ * @brief Declares a name in the innermost scope and stores its address in `node`.
+ *
+ * At the top level of a program (no open block) the name becomes a global instead.
+ */
+static void declare(Resolver *resolver, ASTNode *node, const char *name)
+{
+    FunctionScope *function = resolver->function;
+    BlockScope *scope = function->block;
+    if (!scope)
+    {
+        node->depth = SCOPE_GLOBAL;
+        node->slot = global_slot(name);
+        return;
+    }
+
+    if (scope->count >= scope->capacity)
+    {
+        scope->capacity = scope->capacity == 0 ? 8 : scope->capacity * 2;
+        scope->names = realloc(scope->names, scope->capacity * sizeof(const char *));
+        scope->slots = realloc(scope->slots, scope->capacity * sizeof(int));
+        if (!scope->names || !scope->slots)
+        {
+            fprintf(stderr, "Fatal: Memory allocation failed for resolver scope.\n");
+            exit(1);
+        }
+    }
+    scope->names[scope->count] = name;
+    scope->slots[scope->count] = function->slot_count++;
+    if (node)
+    {
+        node->depth = 0;
+        node->slot = scope->slots[scope->count];
+    }
+    scope->count++;
+}
+
+/**
+ * @brief Resolves a variable reference to the nearest declaration visible at this point.
+ */
+static void resolve_reference(Resolver *resolver, ASTNode *node)
+{
+    int depth = 0;
+    for (FunctionScope *function = resolver->function; function; function = function->enclosing, depth++)
+    {
+        for (BlockScope *scope = function->block; scope; scope = scope->enclosing)
+        {
+            for (int i = scope->count - 1; i >= 0; i--)
+            {
+                if (strcmp(scope->names[i], node->value) == 0)
+                {
+                    node->depth = depth;
+                    node->slot = scope->slots[i];
+                    return;
+                }
+            }
+        }
+    }
+    // Not declared in any enclosing scope: look it up in the global table at run time.
+    node->depth = SCOPE_GLOBAL;
+    node->slot = global_slot(node->value);
+}
+
+/**
+ * @brief Marks the running frame as kept by a nested definition.
+ *
+ * An iteration frame encloses its loop's frame, so every frame out to the function's own is kept.
+ */
+static void capture_frame(Resolver *resolver)
+{
+    FunctionScope *function = resolver->function;
+    function->captured = 1;
+    while (function->is_iteration)
+    {
+        function = function->enclosing;
+        function->captured = 1;
+    }
+}
+
+/**
+ * @brief Returns whether the code runs inside a function body (and not at a program's top level).
+ */
+static int in_function(Resolver *resolver)
+{
+    FunctionScope *function = resolver->function;
+    while (function->is_iteration)
+        function = function->enclosing;
+    return function->enclosing != NULL;
+}
+
+/**
+ * @brief Returns whether a function or class is defined anywhere in a subtree.
+ */
+static int defines_closure(ASTNode *node)
+{
+    if (!node)
+        return 0;
+    if (node->type == AST_FUNC_DEF || node->type == AST_CLASS_DEF)
+        return 1;
+    for (int i = 0; i < node->children_count; i++)
+    {
+        if (defines_closure(node->children[i]))
+            return 1;
+    }
+    return 0;
+}
+
+// --- Nodes ---
+
+static void resolve_block(Resolver *resolver, ASTNode *block)
+{
+    BlockScope scope;
+    begin_scope(resolver, &scope);
+    for (int i = 0; i < block->children_count; i++)
+        resolve_node(resolver, block->children[i]);
+    end_scope(resolver);
+}
+
+/**
+ * @brief Resolves the body of a loop, and the loop variable of a foreach loop.
+ *
+ * If the body defines a function or class, each iteration runs in its own frame, recorded on the
+ * loop node (`frame_captured`, `slot_count`); otherwise the body uses the loop's frame.
+ *
+ * @param loop The loop node.
+ * @param body The loop body.
+ * @param variable The node declaring the loop variable, or NULL.
+ */
+static void resolve_loop_body(Resolver *resolver, ASTNode *loop, ASTNode *body, ASTNode *variable)
+{
+    FunctionScope iteration = {resolver->function, NULL, 0, 0, 1};
+    int has_frame = defines_closure(body);
+    if (has_frame)
+        resolver->function = &iteration;
+
+    BlockScope scope;
+    begin_scope(resolver, &scope);
+    if (variable)
+        declare(resolver, variable, variable->value);
+    resolve_node(resolver, body);
+    end_scope(resolver);
+
+    if (has_frame)
+    {
+        loop->frame_captured = 1;
+        loop->slot_count = iteration.slot_count;
+        resolver->function = iteration.enclosing;
+    }
+}
+
+static void resolve_function(Resolver *resolver, ASTNode *func_def, int is_method)
+{
+    FunctionScope function = {resolver->function, NULL, 0, 0, 0};
+    BlockScope params;
+    resolver->function = &function;
+    begin_scope(resolver, &params);
+
+    // Methods receive their instance in slot 0, ahead of the parameters.
+    if (is_method)
+        declare(resolver, NULL, "this");
+    for (int i = 0; i < func_def->arg_count; i++)
+        declare(resolver, NULL, func_def->args[i]);
+
+    if (func_def->children_count > 0)
+        resolve_block(resolver, func_def->children[0]);
+
+    end_scope(resolver);
+    func_def->slot_count = function.slot_count;
+    func_def->frame_captured = function.captured;
+    resolver->function = function.enclosing;
+}
+
+static void resolve_node(Resolver *resolver, ASTNode *node)
+{
+    if (!node)
+        return;
+
+    switch (node->type)
+    {
+        case AST_VAR_REF:
+            resolve_reference(resolver, node);
+            break;
+        case AST_VAR_DECL:
+            // The initializer is resolved first, so `int x = x + 1` reads an outer `x`.
+            for (int i = 0; i < node->children_count; i++)
+                resolve_node(resolver, node->children[i]);
+            declare(resolver, node, node->value);
+            break;
+        case AST_FUNC_DEF:
+            // Declared before its body so that nested functions can recurse.
+            declare(resolver, node, node->value);
+            capture_frame(resolver);
+            resolve_function(resolver, node, 0);
+            break;
+        case AST_CLASS_DEF:
+        {
+            int first_member = 0;
+            if (node->parent_class_name)
+            {
+                resolve_node(resolver, node->children[0]);
+                first_member = 1;
+            }
+            declare(resolver, node, node->value);
+            capture_frame(resolver);
+            for (int i = first_member; i < node->children_count; i++)
+            {
+                if (node->children[i]->type == AST_FUNC_DEF)
+                    resolve_function(resolver, node->children[i], 1);
+            }
+            break;
+        }
+        case AST_IMPORT:
+            declare(resolver, node, node->value);
+            break;
+        case AST_FIELD_DECL:
+            break;
+        case AST_RETURN:
+            // Inside a function, `return f(...)` can run f in place of the returning call.
+            node->tail_call = in_function(resolver) && node->children_count > 0 &&
+                              node->children[0] && node->children[0]->type == AST_FUNC_CALL;
+            for (int i = 0; i < node->children_count; i++)
+                resolve_node(resolver, node->children[i]);
+            break;
+        case AST_BLOCK:
+            resolve_block(resolver, node);
+            break;
+        case AST_WHILE:
+            resolve_node(resolver, get_child(node, 0));
+            resolve_loop_body(resolver, node, get_child(node, 1), NULL);
+            break;
+        case AST_DO_WHILE:
+            resolve_loop_body(resolver, node, get_child(node, 0), NULL);
+            resolve_node(resolver, get_child(node, 1));
+            break;
+        case AST_IF:
+        case AST_SWITCH:
+        case AST_CASE:
+        case AST_DEFAULT:
+            // Conditions are plain expressions and every body is an AST_BLOCK with its own scope.
+            for (int i = 0; i < node->children_count; i++)
+                resolve_node(resolver, node->children[i]);
+            break;
+        case AST_FOR:
+        {
+            // The initializer's variables are scoped to the loop, and shared by its iterations.
+            BlockScope scope;
+            begin_scope(resolver, &scope);
+            for (int i = 0; i < 3; i++)
+                resolve_node(resolver, get_child(node, i));
+            resolve_loop_body(resolver, node, get_child(node, 3), NULL);
+            end_scope(resolver);
+            break;
+        }
+        case AST_FOREACH:
+            resolve_node(resolver, get_child(node, 0));
+            resolve_loop_body(resolver, node, get_child(node, 1), node);
+            break;
+        default:
+            // Expressions and the remaining statements only contain nested expressions.
+            for (int i = 0; i < node->children_count; i++)
+                resolve_node(resolver, node->children[i]);
+            break;
+    }
+}
+
+// --- Entry Points ---
+
+void resolve_program(ASTNode *root)
+{
+    FunctionScope program = {NULL, NULL, 0, 0, 0};
+    Resolver resolver = {&program};
+    for (int i = 0; i < root->children_count; i++)
+        resolve_node(&resolver, root->children[i]);
+    root->slot_count = program.slot_count;
+}
+
+void resolve_module(ASTNode *root, const char **predeclared, int predeclared_count)
+{
+    FunctionScope module = {NULL, NULL, 0, 0, 0};
+    Resolver resolver = {&module};
+    BlockScope top_level;
+    begin_scope(&resolver, &top_level);
+    for (int i = 0; i < predeclared_count; i++)
+        declare(&resolver, NULL, predeclared[i]);
+    for (int i = 0; i < root->children_count; i++)
+        resolve_node(&resolver, root->children[i]);
+    end_scope(&resolver);
+    root->slot_count = module.slot_count;
+}
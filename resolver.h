@@ -0,0 +1,40 @@
+/**
+ * @file resolver.h
+ * @brief Header file for the Pith variable resolver.
+ *
+ * The resolver runs after `parse_program` and assigns every variable a fixed address, so the
+ * engines never look names up at run time. Each function call (and each program or module) gets
+ * a frame with one slot per declaration in its body; a variable is addressed by how many frames
+ * to walk up (`ASTNode.depth`) and its slot there (`ASTNode.slot`). Names declared at the top
+ * level of a program, or not declared in any enclosing scope, live in the global table and are
+ * marked with `SCOPE_GLOBAL`.
+ */
+
+#ifndef PITH_RESOLVER_H
+#define PITH_RESOLVER_H
+
+#include "parser.h"
+
+/**
+ * @brief Resolves the variables of a program (a script file or a REPL entry).
+ *
+ * Top-level declarations become globals; `root->slot_count` is set to the size of the frame
+ * needed for variables declared inside top-level blocks.
+ *
+ * @param root The AST_PROGRAM node.
+ */
+void resolve_program(ASTNode *root);
+
+/**
+ * @brief Resolves the variables of an imported module.
+ *
+ * Top-level declarations live in the module's frame, after the predeclared names, which
+ * occupy slots 0 to `predeclared_count - 1` (used for the functions of native modules).
+ *
+ * @param root The AST_PROGRAM node of the module.
+ * @param predeclared Names bound before the module body runs.
+ * @param predeclared_count Number of predeclared names.
+ */
+void resolve_module(ASTNode *root, const char **predeclared, int predeclared_count);
+
+#endif //PITH_RESOLVER_H
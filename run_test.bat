@@ -3,9 +3,30 @@ SETLOCAL ENABLEDELAYEDEXPANSION
 
 REM --- Configuration ---
 SET EXECUTABLE=cmake-build-debug\pith_lang.exe
+REM Extra interpreter flags, e.g. "run_test.bat --vm" to run the suite on the bytecode VM.
+REM With --differential, every test also runs with --jit and fails if the two outputs differ.
+SET ENGINE_FLAGS=
+SET DIFFERENTIAL=0
+FOR %%A IN (%*) DO (
+    IF "%%A"=="--differential" (
+        SET DIFFERENTIAL=1
+    ) ELSE (
+        SET ENGINE_FLAGS=!ENGINE_FLAGS! %%A
+    )
+)
 SET TEST_DIR=tests
 SET PASS_COUNT=0
 SET FAIL_COUNT=0
+SET DIFF_COUNT=0
+
+REM Without a JIT the interpreter ignores --jit, and the comparison would always agree.
+IF !DIFFERENTIAL! EQU 1 (
+    !EXECUTABLE! --jit !TEST_DIR!\test_arithmetic.pith 2>&1 >nul | FINDSTR /C:"--jit is not supported" >nul
+    IF !ERRORLEVEL! EQU 0 (
+        ECHO --differential needs the JIT, which is not supported on this platform.
+        EXIT /B 1
+    )
+)
 
 SET TEST_NAMES=^
     test_arithmetic ^
@@ -33,7 +54,29 @@ SET TEST_NAMES=^
     super_call ^
     stdlib_string_list ^
     test_class_pass ^
-    test_integer
+    test_integer ^
+    test_short_circuit ^
+    test_string_interning ^
+    test_instance_fields ^
+    test_field_cache ^
+    test_method_calls ^
+    test_frames ^
+    test_tail_calls ^
+    test_quickening ^
+    test_static_types ^
+    test_jit ^
+    test_counted_loops ^
+    test_switch_table ^
+    test_string_concat ^
+    test_string_builder ^
+    test_substring_views ^
+    test_string_search ^
+    test_map_growth ^
+    test_deep_recursion ^
+    test_nul_bytes ^
+    test_loop_closures ^
+    test_malformed_loop ^
+    test_stack_overflow
 
 ECHO.
 ECHO ============================
@@ -50,7 +93,7 @@ FOR %%T IN (%TEST_NAMES%) DO (
     ECHO Running test: !TEST_NAME!
 
     REM Run the interpreter and save the output
-    !EXECUTABLE! !TEST_FILE! > !ACTUAL_FILE!
+    !EXECUTABLE! !ENGINE_FLAGS! !TEST_FILE! > !ACTUAL_FILE!
 
     REM Compare the actual output with the expected output
     FC "!ACTUAL_FILE!" "!EXPECTED_FILE!" > nul
@@ -68,6 +111,19 @@ FOR %%T IN (%TEST_NAMES%) DO (
         SET /A FAIL_COUNT+=1
     )
 
+    REM Run the test again with the JIT and compare the two outputs
+    IF !DIFFERENTIAL! EQU 1 (
+        SET JIT_FILE=!TEST_DIR!\!TEST_NAME!.jit
+        !EXECUTABLE! !ENGINE_FLAGS! --jit !TEST_FILE! > !JIT_FILE!
+        FC "!ACTUAL_FILE!" "!JIT_FILE!" > nul
+        IF !ERRORLEVEL! NEQ 0 (
+            ECHO   - DIFFERS WITH --jit
+            FC "!ACTUAL_FILE!" "!JIT_FILE!"
+            SET /A DIFF_COUNT+=1
+        )
+        DEL "!JIT_FILE!"
+    )
+
     REM Clean up the temporary actual file
     DEL "!ACTUAL_FILE!"
 )
@@ -78,8 +134,10 @@ ECHO        Test Summary
 ECHO ============================
 ECHO Passed: !PASS_COUNT!
 ECHO Failed: !FAIL_COUNT!
+IF !DIFFERENTIAL! EQU 1 ECHO Differing with --jit: !DIFF_COUNT!
 ECHO.
 
+SET /A FAIL_COUNT+=DIFF_COUNT
 IF !FAIL_COUNT! GTR 0 (
     EXIT /B 1
 ) ELSE (
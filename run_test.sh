@@ -0,0 +1,116 @@
+#!/bin/sh
+# Runs the Pith test suite on Linux and macOS; the counterpart of run_test.bat, whose TEST_NAMES
+# list it reads so that both runners run the same tests.
+#
+# Usage: ./run_test.sh [--differential] [--aot] [interpreter flags...]
+#   ./run_test.sh --vm              runs the suite on the bytecode VM.
+#   ./run_test.sh --differential    also runs every test with --jit and fails if the outputs differ.
+#   ./run_test.sh --aot             turns every test into a C program with --emit-c, compiles it
+#                                   against libpith_runtime.a and runs that instead.
+# Set PITH to use another interpreter binary, PITH_RUNTIME to the directory holding
+# libpith_runtime.a (by default the interpreter's) and CC to the C compiler for --aot.
+
+EXECUTABLE=${PITH:-cmake-build-debug/pith_lang}
+TEST_DIR=tests
+DIFFERENTIAL=0
+AOT=0
+ENGINE_FLAGS=
+for arg in "$@"; do
+    if [ "$arg" = "--differential" ]; then
+        DIFFERENTIAL=1
+    elif [ "$arg" = "--aot" ]; then
+        AOT=1
+    else
+        ENGINE_FLAGS="$ENGINE_FLAGS $arg"
+    fi
+done
+RUNTIME_DIR=${PITH_RUNTIME:-$(dirname "$EXECUTABLE")}
+
+cd "$(dirname "$0")" || exit 1
+TEST_NAMES=$(sed -n '/^SET TEST_NAMES=/,/^[[:space:]]*$/p' run_test.bat | sed -e 's/^SET TEST_NAMES=//' -e 's/\^//' -e 's/\r//')
+
+if [ ! -x "$EXECUTABLE" ]; then
+    echo "Interpreter not found at $EXECUTABLE (set PITH to its path)."
+    exit 1
+fi
+
+# Without a JIT the interpreter ignores --jit, and the comparison would always agree.
+if [ $DIFFERENTIAL -eq 1 ] &&
+    "$EXECUTABLE" --jit "$TEST_DIR/test_arithmetic.pith" 2>&1 >/dev/null | grep -q -- "--jit is not supported"; then
+    echo "--differential needs the JIT, which is not supported on this platform."
+    exit 1
+fi
+
+if [ $AOT -eq 1 ] && [ ! -f "$RUNTIME_DIR/libpith_runtime.a" ]; then
+    echo "libpith_runtime.a not found in $RUNTIME_DIR (set PITH_RUNTIME to its directory)."
+    exit 1
+fi
+
+PASS_COUNT=0
+FAIL_COUNT=0
+DIFF_COUNT=0
+echo "============================"
+echo "     Running Pith Tests"
+echo "============================"
+echo
+
+for TEST_NAME in $TEST_NAMES; do
+    TEST_FILE=$TEST_DIR/$TEST_NAME.pith
+    EXPECTED_FILE=$TEST_DIR/$TEST_NAME.expected
+    ACTUAL_FILE=$TEST_DIR/$TEST_NAME.actual
+
+    echo "Running test: $TEST_NAME"
+
+    # Run the interpreter, or the test's compiled C program, and save the output
+    if [ $AOT -eq 1 ]; then
+        PROGRAM=$TEST_DIR/$TEST_NAME.aot
+        if "$EXECUTABLE" --emit-c "$TEST_FILE" > "$PROGRAM.c" &&
+            ${CC:-cc} -std=gnu99 -O2 -I. -o "$PROGRAM" "$PROGRAM.c" -L"$RUNTIME_DIR" -lpith_runtime -lm; then
+            "./$PROGRAM" > "$ACTUAL_FILE"
+        else
+            echo "  - could not emit or compile the C program"
+            : > "$ACTUAL_FILE"
+        fi
+        rm -f "$PROGRAM" "$PROGRAM.c"
+    else
+        "$EXECUTABLE" $ENGINE_FLAGS "$TEST_FILE" > "$ACTUAL_FILE"
+    fi
+
+    # Compare the actual output with the expected output, line by line as FC does
+    if [ "$(cat "$ACTUAL_FILE")" = "$(cat "$EXPECTED_FILE")" ]; then
+        echo "  - PASS"
+        PASS_COUNT=$((PASS_COUNT + 1))
+    else
+        echo "  - FAIL"
+        diff "$EXPECTED_FILE" "$ACTUAL_FILE" | sed 's/^/    /'
+        FAIL_COUNT=$((FAIL_COUNT + 1))
+    fi
+
+    # Run the test again with the JIT and compare the two outputs
+    if [ $DIFFERENTIAL -eq 1 ]; then
+        JIT_FILE=$TEST_DIR/$TEST_NAME.jit
+        "$EXECUTABLE" $ENGINE_FLAGS --jit "$TEST_FILE" > "$JIT_FILE"
+        if ! cmp -s "$ACTUAL_FILE" "$JIT_FILE"; then
+            echo "  - DIFFERS WITH --jit"
+            diff "$ACTUAL_FILE" "$JIT_FILE" | sed 's/^/    /'
+            DIFF_COUNT=$((DIFF_COUNT + 1))
+        fi
+        rm -f "$JIT_FILE"
+    fi
+
+    # Clean up the temporary actual file
+    rm -f "$ACTUAL_FILE"
+done
+
+echo
+echo "============================"
+echo "       Test Summary"
+echo "============================"
+echo "Passed: $PASS_COUNT"
+echo "Failed: $FAIL_COUNT"
+if [ $DIFFERENTIAL -eq 1 ]; then
+    echo "Differing with --jit: $DIFF_COUNT"
+fi
+echo
+
+[ $((FAIL_COUNT + DIFF_COUNT)) -eq 0 ]
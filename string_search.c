@@ -0,0 +1,119 @@
+/**
+ * @file string_search.c
+ * @brief Implementation of the Pith substring search.
+ */
+
+#include "string_search.h"
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__)
+#define PITH_SEARCH_SIMD
+#include <immintrin.h>
+#endif
+
+/**
+ * @brief Finds a needle of two or more bytes by looking for its first byte with `memchr`.
+ */
+static const char *find_scalar(const char *haystack, int haystack_length, const char *needle, int needle_length)
+{
+    const char *last = haystack + haystack_length - needle_length;
+    for (const char *p = haystack; p <= last; p++)
+    {
+        p = memchr(p, needle[0], last - p + 1);
+        if (!p)
+            return NULL;
+        if (memcmp(p, needle, needle_length) == 0)
+            return p;
+    }
+    return NULL;
+}
+
+#ifdef PITH_SEARCH_SIMD
+
+/**
+ * @brief Checks the candidate positions of a block whose first and last bytes both matched.
+ * @param block The first candidate position of the block.
+ * @param mask Bit `i` is set if position `i` of the block is a candidate.
+ */
+static const char *check_candidates(const char *block, unsigned mask, const char *needle, int needle_length)
+{
+    while (mask)
+    {
+        const char *p = block + __builtin_ctz(mask);
+        // The first and last bytes already match.
+        if (memcmp(p + 1, needle + 1, needle_length - 2) == 0)
+            return p;
+        mask &= mask - 1;
+    }
+    return NULL;
+}
+
+static const char *find_sse2(const char *haystack, int haystack_length, const char *needle, int needle_length)
+{
+    const __m128i first = _mm_set1_epi8(needle[0]);
+    const __m128i last = _mm_set1_epi8(needle[needle_length - 1]);
+    int i = 0;
+    // A block is checked while the last byte of its last candidate is in the haystack.
+    for (; i + needle_length - 1 + 16 <= haystack_length; i += 16)
+    {
+        __m128i firsts = _mm_loadu_si128((const __m128i *) (haystack + i));
+        __m128i lasts = _mm_loadu_si128((const __m128i *) (haystack + i + needle_length - 1));
+        unsigned mask = (unsigned) _mm_movemask_epi8(
+            _mm_and_si128(_mm_cmpeq_epi8(firsts, first), _mm_cmpeq_epi8(lasts, last)));
+        const char *found = check_candidates(haystack + i, mask, needle, needle_length);
+        if (found)
+            return found;
+    }
+    return find_scalar(haystack + i, haystack_length - i, needle, needle_length);
+}
+
+__attribute__((target("avx2")))
+static const char *find_avx2(const char *haystack, int haystack_length, const char *needle, int needle_length)
+{
+    const __m256i first = _mm256_set1_epi8(needle[0]);
+    const __m256i last = _mm256_set1_epi8(needle[needle_length - 1]);
+    int i = 0;
+    for (; i + needle_length - 1 + 32 <= haystack_length; i += 32)
+    {
+        __m256i firsts = _mm256_loadu_si256((const __m256i *) (haystack + i));
+        __m256i lasts = _mm256_loadu_si256((const __m256i *) (haystack + i + needle_length - 1));
+        unsigned mask = (unsigned) _mm256_movemask_epi8(
+            _mm256_and_si256(_mm256_cmpeq_epi8(firsts, first), _mm256_cmpeq_epi8(lasts, last)));
+        const char *found = check_candidates(haystack + i, mask, needle, needle_length);
+        if (found)
+            return found;
+    }
+    return find_sse2(haystack + i, haystack_length - i, needle, needle_length);
+}
+
+typedef const char *(*SearchFunction)(const char *, int, const char *, int);
+
+/**
+ * @brief The search for needles of two or more bytes, chosen on the first call.
+ */
+static SearchFunction find_block = NULL;
+
+static SearchFunction select_search()
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") ? find_avx2 : find_sse2;
+}
+
+#endif
+
+const char *find_substring(const char *haystack, int haystack_length, const char *needle, int needle_length)
+{
+    if (needle_length == 0)
+        return haystack;
+    if (needle_length > haystack_length)
+        return NULL;
+    if (needle_length == 1)
+        return memchr(haystack, needle[0], haystack_length);
+#ifdef PITH_SEARCH_SIMD
+    if (!find_block)
+        find_block = select_search();
+    return find_block(haystack, haystack_length, needle, needle_length);
+#else
+    return find_scalar(haystack, haystack_length, needle, needle_length);
+#endif
+}
@@ -0,0 +1,30 @@
+/**
+ * @file string_search.h
+ * @brief Header file for the Pith substring search.
+ *
+ * Every string method that looks for a substring (`contains`, `find`, `count`, `split` and
+ * `replace`) goes through `find_substring`. A one-byte needle is found with `memchr`. A longer one
+ * is found by comparing its first and last bytes against a whole block of candidate positions at
+ * once, using AVX2 (32 positions) when the CPU has it and SSE2 (16 positions) otherwise, and only
+ * comparing the rest of the needle where both match. The instruction set is chosen on the first
+ * search. Without SSE2 the search falls back to `memchr` on the first byte.
+ */
+
+#ifndef PITH_STRING_SEARCH_H
+#define PITH_STRING_SEARCH_H
+
+/**
+ * @brief Finds the first occurrence of `needle` in `haystack`.
+ *
+ * Both are given by length, so they may contain NUL bytes.
+ *
+ * @param haystack The characters to search.
+ * @param haystack_length The number of characters to search.
+ * @param needle The characters to look for.
+ * @param needle_length The number of characters to look for.
+ * @return A pointer to the occurrence in `haystack`, or NULL if there is none. An empty needle is
+ *         found at the start.
+ */
+const char *find_substring(const char *haystack, int haystack_length, const char *needle, int needle_length);
+
+#endif //PITH_STRING_SEARCH_H
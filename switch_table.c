@@ -0,0 +1,196 @@
+/**
+ * @file switch_table.c
+ * @brief Implementation of the Pith switch dispatch tables.
+ */
+
+#include "switch_table.h"
+#include "constants.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+/**
+ * @brief Widest span of int labels, per label, that still goes in the dense array.
+ */
+#define DENSE_SPAN_PER_LABEL 4
+
+struct SwitchTable
+{
+    int min; // The int label at index 0 of `dense`
+    int dense_count; // Number of entries of `dense` (0 if the int labels are hashed)
+    int *dense; // Clause of each int from `min` on, 0 where no label has that value
+    Value *keys; // Hashed labels, VAL_VOID in empty slots
+    int *clauses; // Clause of each hashed label
+    int capacity; // Number of hash slots, always a power of two (0 if nothing is hashed)
+};
+
+static void *allocate(size_t size)
+{
+    void *memory = calloc(1, size);
+    if (!memory)
+    {
+        fprintf(stderr, "Fatal: Memory allocation failed for switch table.\n");
+        exit(1);
+    }
+    return memory;
+}
+
+/**
+ * @brief Reads the value of a case label, if it is a literal the table can hold.
+ */
+static int label_value(ASTNode *label, Value *value)
+{
+    if (!label)
+        return 0;
+    if (label->type == AST_INT_LITERAL || label->type == AST_STRING_LITERAL)
+    {
+        *value = LITERAL_VALUE(label);
+        return 1;
+    }
+    if (label->type == AST_UNARY_OP && label->op == OPER_NEGATE && label->children_count == 1 &&
+        label->children[0] && label->children[0]->type == AST_INT_LITERAL)
+    {
+        *value = LITERAL_VALUE(label->children[0]);
+        value->int_val = (int) (0u - (unsigned) value->int_val);
+        return 1;
+    }
+    return 0;
+}
+
+static unsigned long hash_label(Value value)
+{
+    return value.type == VAL_STRING ? value.string->hash : (unsigned) value.int_val * 2654435761u;
+}
+
+static int same_label(Value a, Value b)
+{
+    return a.type == b.type && (a.type == VAL_INT ? a.int_val == b.int_val : a.string == b.string);
+}
+
+/**
+ * @brief Adds a label to the hash table, unless an earlier clause already has it.
+ */
+static void add_hashed(SwitchTable *table, Value label, int clause)
+{
+    int mask = table->capacity - 1;
+    for (int i = (int) (hash_label(label) & mask);; i = (i + 1) & mask)
+    {
+        if (table->keys[i].type == VAL_VOID)
+        {
+            table->keys[i] = label;
+            table->clauses[i] = clause;
+            return;
+        }
+        if (same_label(table->keys[i], label))
+            return;
+    }
+}
+
+static SwitchTable *build_switch_table(ASTNode *node)
+{
+    Value *labels = allocate((node->children_count + 1) * sizeof(Value));
+    int int_count = 0;
+    int min = 0;
+    int max = 0;
+
+    for (int i = 1; i < node->children_count; i++)
+    {
+        ASTNode *clause = node->children[i];
+        labels[i].type = VAL_VOID;
+        if (!clause || clause->type != AST_CASE)
+            continue;
+        if (clause->children_count < 1 || !label_value(clause->children[0], &labels[i]))
+        {
+            free(labels);
+            return NULL;
+        }
+        if (labels[i].type == VAL_INT)
+        {
+            if (int_count == 0 || labels[i].int_val < min)
+                min = labels[i].int_val;
+            if (int_count == 0 || labels[i].int_val > max)
+                max = labels[i].int_val;
+            int_count++;
+        }
+    }
+
+    SwitchTable *table = allocate(sizeof(SwitchTable));
+    long long span = (long long) max - min + 1;
+    int dense = int_count > 0 && span <= (long long) int_count * DENSE_SPAN_PER_LABEL;
+    if (dense)
+    {
+        table->min = min;
+        table->dense_count = (int) span;
+        table->dense = allocate(span * sizeof(int));
+    }
+
+    int hashed_count = 0;
+    for (int i = 1; i < node->children_count; i++)
+    {
+        if (labels[i].type == VAL_STRING || (labels[i].type == VAL_INT && !dense))
+            hashed_count++;
+    }
+    if (hashed_count > 0)
+    {
+        // At most half full, so probes stay short.
+        table->capacity = 4;
+        while (table->capacity < hashed_count * 2)
+            table->capacity *= 2;
+        table->keys = allocate(table->capacity * sizeof(Value));
+        table->clauses = allocate(table->capacity * sizeof(int));
+        for (int i = 0; i < table->capacity; i++)
+            table->keys[i].type = VAL_VOID;
+    }
+
+    for (int i = 1; i < node->children_count; i++)
+    {
+        if (labels[i].type == VAL_INT && dense)
+        {
+            int *entry = &table->dense[(unsigned) labels[i].int_val - (unsigned) min];
+            if (*entry == 0)
+                *entry = i;
+        }
+        else if (labels[i].type != VAL_VOID)
+        {
+            add_hashed(table, labels[i], i);
+        }
+    }
+    free(labels);
+    return table;
+}
+
+SwitchTable *get_switch_table(ASTNode *node)
+{
+    if (!node->switch_table)
+        node->switch_table = build_switch_table(node);
+    return node->switch_table;
+}
+
+int find_switch_clause(const SwitchTable *table, Value subject)
+{
+    if (subject.type == VAL_INT && table->dense)
+    {
+        unsigned index = (unsigned) subject.int_val - (unsigned) table->min;
+        return index < (unsigned) table->dense_count ? table->dense[index] : 0;
+    }
+    if ((subject.type != VAL_INT && subject.type != VAL_STRING) || table->capacity == 0)
+        return 0;
+
+    int mask = table->capacity - 1;
+    for (int i = (int) (hash_label(subject) & mask);; i = (i + 1) & mask)
+    {
+        if (table->keys[i].type == VAL_VOID)
+            return 0;
+        if (same_label(table->keys[i], subject))
+            return table->clauses[i];
+    }
+}
+
+void free_switch_table(SwitchTable *table)
+{
+    if (!table)
+        return;
+    free(table->dense);
+    free(table->keys);
+    free(table->clauses);
+    free(table);
+}
@@ -0,0 +1,45 @@
+/**
+ * @file switch_table.h
+ * @brief Header file for the Pith switch dispatch tables.
+ *
+ * A switch whose case labels are all int or string literals (an int may be negated) is indexed
+ * once, the first time an engine compiles it, so that finding the clause to run is a lookup
+ * instead of testing every label in turn. Int labels that are close together go in a dense
+ * array indexed by the subject; the other labels go in an open-addressing hash table, where
+ * strings are keyed by their interned object (see ObjString) and hashed with their cached hash.
+ *
+ * A lookup gives the clause the tree-walker's label-by-label test would have matched first, so
+ * fall-through, `break` and the default labels behave as before. A SwitchTable belongs to the
+ * AST_SWITCH node (`ASTNode.switch_table`) and is freed with it.
+ */
+
+#ifndef PITH_SWITCH_TABLE_H
+#define PITH_SWITCH_TABLE_H
+
+#include "value.h"
+#include "parser.h"
+
+typedef struct SwitchTable SwitchTable;
+
+/**
+ * @brief Returns the dispatch table of a switch statement, building it on first use.
+ * @param node The AST_SWITCH node.
+ * @return The table, or NULL if a case label is not an int or string literal.
+ */
+SwitchTable *get_switch_table(ASTNode *node);
+
+/**
+ * @brief Finds the clause a switch subject matches.
+ * @param table The switch's table.
+ * @param subject The value of the switch expression.
+ * @return The index of the matching AST_CASE among the switch node's children, or 0 if no
+ *         label matches (child 0 is the subject expression).
+ */
+int find_switch_clause(const SwitchTable *table, Value subject);
+
+/**
+ * @brief Frees a switch's table (called by `free_ast`).
+ */
+void free_switch_table(SwitchTable *table);
+
+#endif //PITH_SWITCH_TABLE_H
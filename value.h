@@ -18,6 +18,7 @@ typedef struct Env Env;
 typedef struct StructDef StructDef;
 typedef struct StructInstance StructInstance;
 typedef struct List List;
+typedef struct ObjString ObjString;
 typedef struct MapEntry MapEntry;
 typedef struct HashMap HashMap;
 typedef struct Module Module;
@@ -25,6 +26,7 @@ typedef struct Func Func;
 typedef struct PithClass PithClass;
 typedef struct PithInstance PithInstance;
 typedef struct BoundMethod BoundMethod;
+typedef struct StringBuilder StringBuilder;
 
 /**
  * @brief Function pointer type for native built-in functions.
@@ -54,8 +56,10 @@ typedef enum
     VAL_CLASS, // Class definition
     VAL_INSTANCE, // Instance of a class
     VAL_BOUND_METHOD, // Method bound to an instance
+    VAL_STRING_BUILDER, // Mutable buffer for building a string
     VAL_BREAK, // Internal: Break signal
-    VAL_CONTINUE // Internal: Continue signal
+    VAL_CONTINUE, // Internal: Continue signal
+    VAL_TAIL_CALL // Internal: A call in tail position is waiting to run (see call_function)
 } ValueType;
 
 // --- Garbage Collection Types ---
@@ -74,7 +78,10 @@ typedef enum
     OBJ_BOUND_METHOD,
     OBJ_STRUCT_DEF,
     OBJ_STRUCT_INSTANCE,
-    OBJ_ENV
+    OBJ_ENV,
+    OBJ_STRING,
+    OBJ_STRING_BUILDER,
+    OBJ_STACK_ENV // A frame on the frame stack rather than the heap (see call_function)
 } ObjType;
 
 /**
@@ -102,7 +109,7 @@ struct Value
     {
         int int_val;
         float float_val;
-        char *str_val;
+        ObjString *string;
         NativeFn native_fn;
         Func *func;
         Module *module;
@@ -113,11 +120,45 @@ struct Value
         PithClass *pith_class;
         PithInstance *instance;
         BoundMethod *bound_method;
+        StringBuilder *builder;
     };
 };
 
 // --- Heap Allocated Objects (GC Managed) ---
 
+/**
+ * @brief An immutable string.
+ *
+ * Strings are never modified after creation, so values share them by reference. Every string
+ * is interned: two strings with the same characters are the same object.
+ *
+ * A string made from part of another one (see copy_substring) may be a view: its characters
+ * are a range of its parent's, which it keeps alive, rather than a copy. A view's characters
+ * are not NUL-terminated, so code that needs a C string goes through string_chars.
+ */
+struct ObjString
+{
+    ObjHeader obj;
+    int length; // Number of characters, excluding the terminator
+    unsigned long hash; // Cached hash of the characters (see hash_string)
+    char *chars; // The characters: stored right after the struct, in the parent, or in a buffer of their own
+    ObjString *parent; // For a view, the string that owns its characters (never itself a view); NULL otherwise
+};
+
+/**
+ * @brief A mutable buffer for building a string, made by `StringBuilder()`.
+ *
+ * Appends copy their characters to the end of the buffer, which doubles when full, so building
+ * a string of n characters costs O(n). `build` makes one string of the contents so far.
+ */
+struct StringBuilder
+{
+    ObjHeader obj;
+    char *chars; // The contents, not NUL-terminated
+    int length; // Number of characters used
+    int capacity; // Number of characters allocated
+};
+
 /**
  * @brief A user-defined function.
  *
@@ -177,36 +218,48 @@ struct List
 };
 
 /**
- * @brief An entry in a hashmap (part of a linked list for collision handling).
+ * @brief A slot of a hashmap. `key` is NULL if the slot is empty or deleted.
  */
 struct MapEntry
 {
-    char *key;
+    ObjString *key; // Interned, so keys are compared by pointer
     Value value;
-    MapEntry *next;
 };
 
 /**
- * @brief A hashmap, containing buckets of entries.
+ * @brief An open-addressing hashmap.
+ *
+ * Every slot has a control byte that is either empty, a tombstone left by a deletion, or a
+ * 7-bit fragment of the key's hash, so probing (linear, from `hash & (capacity - 1)`) only
+ * compares the keys whose fragment matches. The table grows once live entries and tombstones
+ * fill 3/4 of it.
  */
 struct HashMap
 {
     ObjHeader obj;
-    MapEntry **buckets;
-    int bucket_count;
+    unsigned char *control; // One control byte per slot
+    MapEntry *entries; // Slots, iterated by skipping entries with a NULL key
+    int capacity; // Number of slots, always a power of two
+    int count; // Number of live entries
+    int tombstones; // Number of deleted slots not yet reclaimed
     ValueType key_type;
     ValueType value_type;
 };
 
 /**
  * @brief A class definition.
+ *
+ * The field names form the layout of the class's instances: the field at index `i` of
+ * `fields` is stored in slot `i` of every instance. Inherited fields come first, in the
+ * parent's order.
  */
 struct PithClass
 {
     ObjHeader obj;
+    int id; // Unique for the whole run, so inline caches never mistake a new class for a freed one
     char *name;
     HashMap *methods;
-    char **fields;
+    ObjString **fields; // Interned field names, indexed by slot
     int field_count;
     struct PithClass *parent; // The parent class, for inheritance
 };
@@ -218,9 +271,36 @@ struct PithInstance
 {
     ObjHeader obj;
     PithClass *pith_class;
-    HashMap *fields;
+    Value *fields; // Field values, indexed by the slots of the class's layout
+    int field_count; // Less than the class's if fields were added to the layout after creation
 };
 
+#define FIELD_CACHE_SIZE 4
+
+/**
+ * @brief What one `object.name` site resolved to for receivers of one class.
+ */
+typedef struct
+{
+    int class_id; // The receiver's class (see PithClass.id)
+    int slot; // The field's slot, or -1 if the name is a method
+    int field_count; // For a method: the class's field count when cached, as a field of the same name would shadow it
+    Value method; // For a method: the unbound method
+} FieldCacheEntry;
+
+/**
+ * @brief A polymorphic inline cache for one `object.name` site, keyed on the receiver's class.
+ *
+ * Slots never move and methods never change once a class is defined, so an entry stays
+ * valid as long as its class lives. Sites that see more than FIELD_CACHE_SIZE classes only
+ * cache the first ones.
+ */
+typedef struct FieldCache
+{
+    FieldCacheEntry entries[FIELD_CACHE_SIZE];
+    int count;
+} FieldCache;
+
 /**
  * @brief A method bound to a specific instance.
  *
@@ -234,16 +314,18 @@ struct BoundMethod
 };
 
 /**
- * @brief Environment (Scope) for variable storage.
+ * @brief Environment (frame) for variable storage.
  *
- * Implemented as a linked list of variable bindings.
+ * One frame exists per function call, module and program run. Variables are stored in
+ * numbered slots assigned by the resolver (see resolver.h); `enclosing` links to the frame the
+ * running function was defined in.
  */
 struct Env
 {
     ObjHeader obj;
-    char *name;
-    Value val;
-    struct Env *next;
+    struct Env *enclosing; // Frame of the enclosing function, module or program
+    int slot_count;
+    Value slots[]; // One slot per variable declared in the body
 };
 
 /**
@@ -0,0 +1,545 @@
+/**
+ * @file vm.c
+ * @brief Implementation of the Pith stack-based virtual machine.
+ *
+ * This file implements a switch-dispatched interpreter loop over the bytecode produced by
+ * compiler.c. Values live on a single value stack; each Pith call gets a CallFrame that records
+ * its chunk, instruction pointer and frame of variable slots (see resolver.h).
+ *
+ * Operands stay on the value stack while runtime helpers run so that a collection triggered by
+ * an allocation inside a helper still sees them (see `vm_mark_roots`).
+ */
+
+#include "vm.h"
+#include "compiler.h"
+#include "constants.h"
+#include "switch_table.h"
+#include "interpreter.h"
+#include "gc.h"
+#include "debug.h"
+#include "common.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Deepest call nesting the VM runs. Each VM call still recurses on the C stack, through
+// call_function and run: about 1 KB per call in an unoptimised build, so a debug build runs out
+// of a default 8 MB stack at around 7800 nested calls. The cap leaves that build half the stack;
+// smaller stacks are covered by the C stack guard in call_function.
+#define VM_FRAMES_MAX 4096
+#define VM_STACK_MAX (VM_FRAMES_MAX * 16)
+
+/**
+ * @brief The execution state of one running chunk (the script or a function call).
+ */
+typedef struct
+{
+    Chunk *chunk;
+    uint8_t *ip;
+    Env *env; // Variable slots of the running code
+    Value *stack_base; // Value stack height when the frame was entered
+} CallFrame;
+
+static Value stack[VM_STACK_MAX];
+static Value *stack_top = stack;
+
+static CallFrame frames[VM_FRAMES_MAX];
+static int frame_count = 0;
+
+// Operators of the binary opcodes, indexed from OP_ADD (see eval_binary_op).
+static const Operator binary_operators[] = {
+    OPER_ADD, OPER_SUBTRACT, OPER_MULTIPLY, OPER_DIVIDE, OPER_MODULO, OPER_POWER, OPER_LESS,
+    OPER_GREATER, OPER_LESS_EQUAL, OPER_GREATER_EQUAL, OPER_EQUAL, OPER_NOT_EQUAL, OPER_AND, OPER_OR
+};
+
+static void push(Value v)
+{
+    if (stack_top - stack >= VM_STACK_MAX)
+    {
+        fprintf(stderr, "Fatal: VM value stack overflow.\n");
+        exit(1);
+    }
+    *stack_top++ = v;
+}
+
+static Value pop()
+{
+    return *--stack_top;
+}
+
+static Value peek(int distance)
+{
+    return stack_top[-1 - distance];
+}
+
+/**
+ * @brief Executes the frame on top of the frame stack until it returns.
+ * @return The value returned by the chunk.
+ */
+static Value run(CallFrame *frame)
+{
+#define READ_BYTE() (*frame->ip++)
+#define READ_U16() (frame->ip += 2, (uint16_t) ((frame->ip[-2] << 8) | frame->ip[-1]))
+#define READ_CONSTANT() (frame->chunk->constants[READ_U16()])
+#define READ_NODE() (frame->chunk->nodes[READ_U16()])
+#define CURRENT_LINE() (frame->chunk->lines[frame->ip - frame->chunk->code - 1])
+
+    for (;;)
+    {
+#ifdef DEBUG_TRACE_VM
+        printf("          ");
+        for (Value *slot = frame->stack_base; slot < stack_top; slot++)
+        {
+            printf("[ ");
+            print_value(*slot);
+            printf(" ]");
+        }
+        printf("\n");
+        disassemble_instruction(frame->chunk, (int) (frame->ip - frame->chunk->code));
+#endif
+        uint8_t instruction = READ_BYTE();
+        switch (instruction)
+        {
+            case OP_CONSTANT:
+                push(READ_CONSTANT());
+                break;
+            case OP_POP:
+                pop();
+                break;
+            case OP_GET_LOCAL:
+                push(frame->env->slots[READ_U16()]);
+                break;
+            case OP_SET_LOCAL:
+                frame->env->slots[READ_U16()] = pop();
+                break;
+            case OP_GET_ENCLOSING:
+            {
+                Env *env = frame->env;
+                for (int depth = READ_BYTE(); depth > 0; depth--)
+                    env = env->enclosing;
+                push(env->slots[READ_U16()]);
+                break;
+            }
+            case OP_SET_ENCLOSING:
+            {
+                Env *env = frame->env;
+                for (int depth = READ_BYTE(); depth > 0; depth--)
+                    env = env->enclosing;
+                env->slots[READ_U16()] = pop();
+                break;
+            }
+            case OP_GET_GLOBAL:
+            {
+                int slot = READ_U16();
+                push(global_get(slot, CURRENT_LINE()));
+                break;
+            }
+            case OP_SET_GLOBAL:
+            {
+                int slot = READ_U16();
+                global_assign(slot, peek(0), CURRENT_LINE());
+                pop();
+                break;
+            }
+            case OP_DEFINE_GLOBAL:
+                global_define(READ_U16(), peek(0));
+                pop();
+                break;
+            case OP_GET_FIELD:
+            {
+                ASTNode *node = READ_NODE();
+                Value result = get_field_cached(peek(0), MEMBER_NAME(node), node->cache, CURRENT_LINE());
+                stack_top[-1] = result;
+                break;
+            }
+            case OP_SET_FIELD:
+            {
+                ASTNode *node = READ_NODE();
+                set_field_cached(peek(0), MEMBER_NAME(node), peek(1), node->cache, CURRENT_LINE());
+                stack_top -= 2;
+                break;
+            }
+            case OP_GET_INDEX:
+            {
+                Value result = get_index(peek(1), peek(0), CURRENT_LINE());
+                stack_top -= 2;
+                push(result);
+                break;
+            }
+            case OP_SET_INDEX:
+                set_index(peek(1), peek(0), peek(2), CURRENT_LINE());
+                stack_top -= 3;
+                break;
+            case OP_ADD:
+            case OP_SUBTRACT:
+            case OP_MULTIPLY:
+            case OP_LESS:
+            case OP_GREATER:
+            case OP_LESS_EQUAL:
+            case OP_GREATER_EQUAL:
+            case OP_EQUAL:
+            case OP_NOT_EQUAL:
+            {
+                Value right = peek(0);
+                Value left = peek(1);
+                Value result;
+                if (left.type == VAL_INT && right.type == VAL_INT)
+                {
+                    // Fast path for the most common case; matches eval_binary_op exactly.
+                    switch (instruction)
+                    {
+                        case OP_ADD:
+                            result.type = VAL_INT;
+                            result.int_val = left.int_val + right.int_val;
+                            break;
+                        case OP_SUBTRACT:
+                            result.type = VAL_INT;
+                            result.int_val = left.int_val - right.int_val;
+                            break;
+                        case OP_MULTIPLY:
+                            result.type = VAL_INT;
+                            result.int_val = left.int_val * right.int_val;
+                            break;
+                        case OP_LESS:
+                            result.type = VAL_BOOL;
+                            result.int_val = left.int_val < right.int_val;
+                            break;
+                        case OP_GREATER:
+                            result.type = VAL_BOOL;
+                            result.int_val = left.int_val > right.int_val;
+                            break;
+                        case OP_LESS_EQUAL:
+                            result.type = VAL_BOOL;
+                            result.int_val = left.int_val <= right.int_val;
+                            break;
+                        case OP_GREATER_EQUAL:
+                            result.type = VAL_BOOL;
+                            result.int_val = left.int_val >= right.int_val;
+                            break;
+                        case OP_EQUAL:
+                            result.type = VAL_BOOL;
+                            result.int_val = left.int_val == right.int_val;
+                            break;
+                        default:
+                            result.type = VAL_BOOL;
+                            result.int_val = left.int_val != right.int_val;
+                            break;
+                    }
+                }
+                else
+                {
+                    result = eval_binary_op(binary_operators[instruction - OP_ADD], left, right);
+                }
+                stack_top -= 2;
+                push(result);
+                break;
+            }
+            case OP_DIVIDE:
+            case OP_MODULO:
+            case OP_POWER:
+            case OP_AND:
+            case OP_OR:
+            {
+                Value result = eval_binary_op(binary_operators[instruction - OP_ADD], peek(1), peek(0));
+                stack_top -= 2;
+                push(result);
+                break;
+            }
+            case OP_CONCAT:
+            {
+                // The operands stay on the stack, rooted, until the result is made.
+                int count = READ_BYTE();
+                Value result = concat_values(count, stack_top - count);
+                stack_top -= count;
+                push(result);
+                break;
+            }
+            case OP_NEGATE:
+                stack_top[-1] = eval_unary_op(OPER_NEGATE, peek(0), CURRENT_LINE());
+                break;
+            case OP_NOT:
+                stack_top[-1] = eval_unary_op(OPER_NOT, peek(0), CURRENT_LINE());
+                break;
+            case OP_BUILD_LIST:
+            {
+                int count = READ_U16();
+                List *list = (List *) allocate_obj(sizeof(List), OBJ_LIST);
+                list->count = count;
+                list->capacity = count;
+                list->is_fixed = 0;
+                list->element_type = VAL_VOID;
+                list->items = malloc((count > 0 ? count : 1) * sizeof(Value));
+                memcpy(list->items, stack_top - count, count * sizeof(Value));
+                stack_top -= count;
+                Value list_val;
+                list_val.type = VAL_LIST;
+                list_val.list = list;
+                push(list_val);
+                break;
+            }
+            case OP_BUILD_MAP:
+            {
+                int pairs = READ_U16();
+                int line = CURRENT_LINE();
+                HashMap *map = hashmap_create(VAL_STRING, VAL_VOID);
+                gc_push_root((ObjHeader *) map);
+                Value *entries = stack_top - pairs * 2;
+                for (int i = 0; i < pairs; i++)
+                {
+                    Value key = entries[i * 2];
+                    if (key.type != VAL_STRING)
+                        report_error(line, "Hashmap keys must be strings.");
+                    hashmap_set(map, key.string, entries[i * 2 + 1], line);
+                }
+                gc_pop_root();
+                stack_top = entries;
+                Value map_val;
+                map_val.type = VAL_HASHMAP;
+                map_val.hashmap = map;
+                push(map_val);
+                break;
+            }
+            case OP_CALL:
+            {
+                int arg_count = READ_BYTE();
+                Value *args = stack_top - arg_count;
+                Value result = call_value(args[-1], arg_count, args, CURRENT_LINE());
+                stack_top = args - 1;
+                push(result);
+                break;
+            }
+            case OP_INVOKE:
+            {
+                ASTNode *node = READ_NODE();
+                int arg_count = READ_BYTE();
+                Value *args = stack_top - arg_count - 1; // The receiver, then the arguments
+                Value result = call_method(MEMBER_NAME(node), node->cache, arg_count, args, CURRENT_LINE());
+                stack_top = args;
+                push(result);
+                break;
+            }
+            case OP_TAIL_CALL:
+            {
+                // A call to a user-defined function comes back as VAL_TAIL_CALL and is made by
+                // call_function once this frame has been left.
+                int arg_count = READ_BYTE();
+                Value *args = stack_top - arg_count;
+                Value result = tail_call_value(args[-1], arg_count, args, CURRENT_LINE());
+                stack_top = frame->stack_base;
+                return result;
+            }
+            case OP_TAIL_INVOKE:
+            {
+                ASTNode *node = READ_NODE();
+                int arg_count = READ_BYTE();
+                Value *args = stack_top - arg_count - 1;
+                Value result = tail_call_method(MEMBER_NAME(node), node->cache, arg_count, args, CURRENT_LINE());
+                stack_top = frame->stack_base;
+                return result;
+            }
+            case OP_NEW:
+            {
+                int arg_count = READ_BYTE();
+                Value *args = stack_top - arg_count;
+                if (args[-1].type != VAL_CLASS)
+                {
+                    report_error(CURRENT_LINE(), "Cannot instantiate non-class type.");
+                }
+                Value result = instantiate_class(args[-1].pith_class, arg_count, args, CURRENT_LINE());
+                stack_top = args - 1;
+                push(result);
+                break;
+            }
+            case OP_PRINT:
+            {
+                int count = READ_BYTE();
+                Value *values = stack_top - count;
+                for (int i = 0; i < count; i++)
+                {
+                    print_value(values[i]);
+                    if (i < count - 1)
+                        printf(" ");
+                }
+                printf("\n");
+                fflush(stdout);
+                stack_top = values;
+                break;
+            }
+            case OP_JUMP:
+            {
+                uint16_t offset = READ_U16();
+                frame->ip += offset;
+                break;
+            }
+            case OP_JUMP_IF_FALSE:
+            {
+                uint16_t offset = READ_U16();
+                // Truthiness follows the tree-walker, which tests the integer payload.
+                if (!pop().int_val)
+                    frame->ip += offset;
+                break;
+            }
+            case OP_AND_JUMP:
+            {
+                uint16_t offset = READ_U16();
+                if (peek(0).type == VAL_BOOL && !peek(0).int_val)
+                    frame->ip += offset;
+                break;
+            }
+            case OP_OR_JUMP:
+            {
+                uint16_t offset = READ_U16();
+                if (peek(0).type == VAL_BOOL && peek(0).int_val)
+                    frame->ip += offset;
+                break;
+            }
+            case OP_LOOP:
+            {
+                uint16_t offset = READ_U16();
+                frame->ip -= offset;
+                break;
+            }
+            case OP_FOREACH_NEXT:
+            {
+                uint16_t offset = READ_U16();
+                Value collection = peek(1);
+                if (collection.type != VAL_LIST)
+                {
+                    report_error(CURRENT_LINE(), "foreach loop can only iterate over a list or array.");
+                }
+                int index = stack_top[-1].int_val;
+                if (index >= collection.list->count)
+                {
+                    frame->ip += offset;
+                    break;
+                }
+                stack_top[-1].int_val = index + 1;
+                push(collection.list->items[index]);
+                break;
+            }
+            case OP_ENTER_FRAME:
+            {
+                frame->env = env_new(READ_U16(), frame->env);
+                break;
+            }
+            case OP_LEAVE_FRAME:
+            {
+                frame->env = frame->env->enclosing;
+                break;
+            }
+            case OP_SWITCH_MATCH:
+            {
+                Value case_val = peek(0);
+                Value subject = peek(1);
+                Value result;
+                result.type = VAL_BOOL;
+                result.int_val = subject.type == case_val.type &&
+                                 ((subject.type == VAL_INT && subject.int_val == case_val.int_val) ||
+                                  (subject.type == VAL_STRING && subject.string == case_val.string));
+                stack_top[-1] = result;
+                break;
+            }
+            case OP_SWITCH_TABLE:
+            {
+                ASTNode *node = READ_NODE();
+                int clause = find_switch_clause(node->switch_table, peek(0));
+                uint8_t *offsets = frame->ip;
+                frame->ip += 2 * node->children_count;
+                frame->ip += (offsets[2 * clause] << 8) | offsets[2 * clause + 1];
+                break;
+            }
+            case OP_DECLARE_LIST:
+            {
+                ASTNode *decl = READ_NODE();
+                apply_declared_list_type(decl, peek(0));
+                break;
+            }
+            case OP_EXEC_STMT:
+            {
+                ASTNode *node = READ_NODE();
+                exec(node, frame->env);
+                break;
+            }
+            case OP_RETURN:
+            {
+                Value result = pop();
+                stack_top = frame->stack_base;
+                return result;
+            }
+            default:
+                fprintf(stderr, "Fatal: Unknown opcode %d.\n", instruction);
+                exit(1);
+        }
+    }
+
+#undef READ_BYTE
+#undef READ_U16
+#undef READ_CONSTANT
+#undef READ_NODE
+#undef CURRENT_LINE
+}
+
+/**
+ * @brief Returns the line of the call the innermost VM frame is making.
+ */
+static int calling_line()
+{
+    if (frame_count == 0)
+        return get_exec_error_line();
+    CallFrame *caller = &frames[frame_count - 1];
+    return caller->chunk->lines[caller->ip - caller->chunk->code - 1];
+}
+
+/**
+ * @brief Pushes a frame for a chunk, runs it, and pops it again.
+ */
+static Value run_chunk(Chunk *chunk, Env *env)
+{
+    if (frame_count >= VM_FRAMES_MAX)
+    {
+        report_error(calling_line(), "Stack overflow: calls are nested more than %d deep.", VM_FRAMES_MAX);
+    }
+    CallFrame *frame = &frames[frame_count++];
+    frame->chunk = chunk;
+    frame->ip = chunk->code;
+    frame->env = env;
+    frame->stack_base = stack_top;
+
+    Value result = run(frame);
+    frame_count--;
+    return result;
+}
+
+void vm_run_program(ASTNode *root, Env *env)
+{
+    Chunk *chunk = compile_program(root);
+    run_chunk(chunk, env);
+    free_chunk(chunk);
+}
+
+Value vm_run_function(Func *func, Env *env)
+{
+    if (!func->body->chunk)
+    {
+        func->body->chunk = compile_function(func->body);
+    }
+    return run_chunk(func->body->chunk, env);
+}
+
+void vm_mark_roots()
+{
+    for (Value *slot = stack; slot < stack_top; slot++)
+    {
+        mark_value(*slot);
+    }
+    for (int i = 0; i < frame_count; i++)
+    {
+        mark_object((ObjHeader *) frames[i].env);
+    }
+}
+
+void vm_reset()
+{
+    stack_top = stack;
+    frame_count = 0;
+}
@@ -0,0 +1,44 @@
+/**
+ * @file vm.h
+ * @brief Header file for the Pith stack-based virtual machine.
+ *
+ * The VM executes bytecode produced by the compiler (see compiler.h). It shares the value
+ * representation, environments and runtime helpers of the tree-walking interpreter, so it is
+ * selected per run with the `--vm` flag and both engines produce identical results.
+ */
+
+#ifndef PITH_VM_H
+#define PITH_VM_H
+
+#include "value.h"
+#include "parser.h"
+
+/**
+ * @brief Compiles and runs a whole program.
+ * @param root The AST_PROGRAM node, annotated by the resolver.
+ * @param env The program's frame.
+ */
+void vm_run_program(ASTNode *root, Env *env);
+
+/**
+ * @brief Runs the body of a user-defined function.
+ *
+ * The function body is compiled on first use and cached on its AST node.
+ *
+ * @param func The function to run.
+ * @param env The frame holding the parameters, linked to the function's defining frame.
+ * @return The function's return value.
+ */
+Value vm_run_function(Func *func, Env *env);
+
+/**
+ * @brief Marks every value and frame held by the VM (called by the GC).
+ */
+void vm_mark_roots();
+
+/**
+ * @brief Discards all VM state after an error has been recovered from (used by the REPL).
+ */
+void vm_reset();
+
+#endif //PITH_VM_H